@@ -0,0 +1,122 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef HIQP_BATCH_EVALUATOR_H
+#define HIQP_BATCH_EVALUATOR_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <hiqp/task.h>
+#include <hiqp/hiqp_solver.h>
+#include <hiqp/hiqp_time_point.h>
+#include <hiqp/kinematics_cache.h>
+#include <hiqp/robot_state.h>
+#include <hiqp/task_manager.h>
+#include <hiqp/worker_pool.h>
+
+#include <Eigen/Dense>
+
+namespace hiqp {
+
+  /*! \brief Computes the velocity controls of the tasks of a TaskManager for
+   *         a batch of robot states, e.g. to roll out trajectories in a
+   *         planner. The states are spread over the calling thread and the
+   *         worker threads. Each thread has a lane with its own instances of
+   *         the active tasks, its own solver, configured like the one of the
+   *         task manager, and its own kinematics cache. The instances of the
+   *         tasks share the primitives with the task manager, which are read
+   *         by the lanes, so the resources of the task manager are locked
+   *         during evaluate(), see TaskManager::lockResources(). The control
+   *         loop does not wait for the batch, but applies the primitive
+   *         parameters published meanwhile after it. The instances of the
+   *         tasks are created when a lane is first used and again whenever
+   *         the tasks or primitives of the task manager change. The task
+   *         dynamics are initialized with the robot state passed to
+   *         evaluate() at that time.
+   *  \author Marcus A Johansson */
+  class BatchEvaluator {
+  public:
+    BatchEvaluator(TaskManager& task_manager);
+    ~BatchEvaluator() noexcept {}
+
+    /*! \brief Sets the number of threads that evaluate states in addition to the calling thread
+     *  \param pin_threads : see WorkerPool::setNumThreads() */
+    void setNumThreads(unsigned int n_threads, bool pin_threads);
+
+    /*! \brief Computes the controls for each of N robot states
+     *  \param robot_state : the kdl tree, joint handles and sampling time of the states
+     *  \param q : the joint positions, one row per state
+     *  \param dq : the joint velocities, one row per state
+     *  \param t : the time point of each state
+     *  \param controls : resized to N x the number of controls, the controls of state i are written to row i
+     *  \return 0 on success,
+     *          -1 if the sizes of the arguments do not match,
+     *          -2 if some states could not be solved, their rows are set to zero */
+    int evaluate(RobotStatePtr robot_state,
+                 const Eigen::MatrixXd& q,
+                 const Eigen::MatrixXd& dq,
+                 const std::vector<HiQPTimePoint>& t,
+                 Eigen::MatrixXd& controls);
+
+  private:
+    BatchEvaluator(const BatchEvaluator& other) = delete;
+    BatchEvaluator(BatchEvaluator&& other) = delete;
+    BatchEvaluator& operator=(const BatchEvaluator& other) = delete;
+    BatchEvaluator& operator=(BatchEvaluator&& other) noexcept = delete;
+
+    /// \brief The state of the batch owned by one thread
+    struct Lane {
+      Lane() : task_set_version_(0) {}
+      std::shared_ptr<RobotState>            robot_state_;
+      RobotStatePtr                          robot_state_ptr_; // the same state, as passed to the tasks
+      std::vector< std::shared_ptr<Task> >   tasks_;
+      unsigned long                          task_set_version_;
+      std::shared_ptr<HiQPSolver>            solver_;
+      std::string                            solver_name_; // the backend solver_ was created from
+      std::vector<double>                    controls_;
+    };
+
+    /// \brief Evaluates states from the batch with lane l until there are none left
+    void runLane(unsigned int l);
+
+    /// \brief Creates the robot state, tasks and solver of a lane as needed, the resources of the task manager must be locked
+    void prepareLane(Lane& lane);
+
+    /// \brief Computes the controls of state i of the batch with lane, returns whether it was solved
+    bool evaluateState(Lane& lane, unsigned int i);
+
+    TaskManager&                   task_manager_;
+    WorkerPool                     worker_pool_;
+    WorkerPool::Job                lane_job_; // calls runLane()
+    std::vector<Lane>              lanes_;
+
+    // The batch of the current call to evaluate()
+    RobotStatePtr                      robot_state_;
+    const Eigen::MatrixXd*             q_;
+    const Eigen::MatrixXd*             dq_;
+    const std::vector<HiQPTimePoint>*  t_;
+    Eigen::MatrixXd*                   controls_;
+    std::atomic<unsigned int>          next_state_;
+    std::atomic<unsigned int>          n_failed_;
+  };
+
+} // namespace hiqp
+
+#endif // include guard
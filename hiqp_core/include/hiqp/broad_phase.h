@@ -0,0 +1,92 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef HIQP_BROAD_PHASE_H
+#define HIQP_BROAD_PHASE_H
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <hiqp/robot_state.h>
+#include <hiqp/geometric_primitives/aabb_tree.h>
+#include <hiqp/geometric_primitives/geometric_primitive.h>
+
+#include <Eigen/Geometry>
+
+namespace hiqp {
+
+  using geometric_primitives::GeometricPrimitive;
+
+  /*! \brief Finds the pairs of primitives that are further apart than a margin. The world-frame bounds of the primitives (GeometricPrimitive::getBounds()) are kept in an AABBTree that is refitted from the kinematics cache in every call to update(), and each pair is looked up among the tree proxies near its first primitive. Pairs with an unbounded primitive are never separated. The primitives are referenced by raw pointers, they must outlive the pairs until the next clear().
+   *  \author Marcus A Johansson */
+  class BroadPhase {
+  public:
+    BroadPhase();
+    ~BroadPhase() noexcept {}
+
+    /// \brief Removes all pairs and primitives
+    void clear();
+
+    /// \brief Adds a pair of primitives, \return the index of the pair
+    unsigned int addPair(GeometricPrimitive* first, GeometricPrimitive* second);
+
+    inline unsigned int getNumPairs() const { return pairs_.size(); }
+
+    /*! \brief Computes the bounds of the primitives from the poses in the kinematics cache, and finds the pairs whose bounds are further apart than margin
+     *  \return 0 on success, -1 if the pose of a primitive could not be computed, in which case no pair is separated */
+    int update(RobotStatePtr robot_state, double margin);
+
+    /// \brief Returns whether the bounds of the primitives of the pair were further apart than the margin in the last update()
+    inline bool isSeparated(unsigned int pair) const { return pairs_[pair].separated_; }
+
+  private:
+    BroadPhase(const BroadPhase& other) = delete;
+    BroadPhase(BroadPhase&& other) = delete;
+    BroadPhase& operator=(const BroadPhase& other) = delete;
+    BroadPhase& operator=(BroadPhase&& other) noexcept = delete;
+
+    struct Proxy {
+      Proxy(GeometricPrimitive* primitive) : primitive_(primitive), tree_proxy_(-1) {}
+      GeometricPrimitive*   primitive_;
+      int                   tree_proxy_; // -1 if the primitive is unbounded
+      Eigen::AlignedBox3d   bounds_; // world frame, without margin
+      std::vector< std::pair<unsigned int, unsigned int> > partners_; // sorted (second proxy, pair) of the pairs this proxy is first in
+    };
+
+    struct Pair {
+      Pair(unsigned int first, unsigned int second) : first_(first), second_(second), separated_(false) {}
+      unsigned int   first_;
+      unsigned int   second_;
+      bool           separated_;
+    };
+
+    /// \brief Returns the index of the proxy of the primitive, adds one if there is none
+    unsigned int getProxy(GeometricPrimitive* primitive);
+
+    std::vector<Proxy>                                     proxies_;
+    std::unordered_map<GeometricPrimitive*, unsigned int>  proxy_indices_;
+    std::vector<Pair>                                      pairs_;
+    bool                                                   partners_sorted_;
+
+    geometric_primitives::AABBTree                         tree_;
+    std::vector<int>                                       query_results_;
+  };
+
+} // namespace hiqp
+
+#endif // include guard
@@ -0,0 +1,108 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef HIQP_AABB_TREE_H
+#define HIQP_AABB_TREE_H
+
+#include <vector>
+
+#include <Eigen/Geometry>
+
+namespace hiqp
+{
+namespace geometric_primitives
+{
+
+  /*! \brief A dynamic bounding volume hierarchy of axis-aligned boxes. The
+   *         leaves (proxies) store their boxes enlarged by a fat margin, so
+   *         that moving a proxy only changes the tree once it leaves its fat
+   *         box. Leaves are inserted where they increase the surface area of
+   *         the tree the least, and the tree is kept balanced by rotations.
+   *  \author Marcus A Johansson */
+  class AABBTree {
+  public:
+    AABBTree();
+    ~AABBTree() noexcept {}
+
+    /// \brief Sets the margin the boxes of proxies created or moved afterwards are enlarged by
+    inline void setFatMargin(double margin) { fat_margin_ = margin; }
+
+    /// \brief Removes all proxies
+    void clear();
+
+    /*! \brief Adds a box to the tree
+     *  \param user_data : returned by getUserData()
+     *  \return the id of the proxy */
+    int createProxy(const Eigen::AlignedBox3d& bounds, int user_data);
+
+    void destroyProxy(int proxy);
+
+    /*! \brief Changes the box of the proxy
+     *  \return true if the proxy was reinserted, false if the box still fits the fat box of the proxy */
+    bool moveProxy(int proxy, const Eigen::AlignedBox3d& bounds);
+
+    inline int getUserData(int proxy) const { return nodes_[proxy].user_data_; }
+
+    inline const Eigen::AlignedBox3d& getFatBounds(int proxy) const { return nodes_[proxy].bounds_; }
+
+    /// \brief Appends the proxies whose fat boxes intersect bounds to proxies
+    void query(const Eigen::AlignedBox3d& bounds, std::vector<int>& proxies);
+
+    inline unsigned int getNumProxies() const { return n_proxies_; }
+
+    /// \brief Returns the height of the tree, zero if it is empty or has one proxy
+    inline int getHeight() const { return (root_ < 0 ? 0 : nodes_[root_].height_); }
+
+  private:
+    AABBTree(const AABBTree& other) = delete;
+    AABBTree(AABBTree&& other) = delete;
+    AABBTree& operator=(const AABBTree& other) = delete;
+    AABBTree& operator=(AABBTree&& other) noexcept = delete;
+
+    struct Node {
+      bool isLeaf() const { return child1_ < 0; }
+
+      Eigen::AlignedBox3d   bounds_;
+      int                   parent_; // the next free node if the node is free
+      int                   child1_; // -1 for leaves
+      int                   child2_;
+      int                   height_; // 0 for leaves, -1 for free nodes
+      int                   user_data_;
+    };
+
+    int allocateNode();
+    void freeNode(int node);
+
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+
+    /// \brief Rotates the subtree of the node if it is imbalanced, returns the new root of the subtree
+    int balance(int node);
+
+    std::vector<Node>      nodes_;
+    int                    root_;
+    int                    free_list_;
+    unsigned int           n_proxies_;
+    double                 fat_margin_;
+    std::vector<int>       stack_; // used by query()
+  };
+
+} // namespace geometric_primitives
+
+} // namespace hiqp
+
+#endif // include guard
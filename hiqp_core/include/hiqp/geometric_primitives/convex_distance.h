@@ -0,0 +1,142 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HIQP_CONVEX_DISTANCE_H
+#define HIQP_CONVEX_DISTANCE_H
+
+#include <vector>
+
+#include <hiqp/geometric_primitives/geometric_primitive.h>
+
+#include <kdl/frames.hpp>
+#include <Eigen/Dense>
+
+namespace hiqp
+{
+namespace geometric_primitives
+{
+
+  /*! \brief Computes the signed distance between two convex primitives from
+   *         their support mappings, see GeometricPrimitive::getSupport().
+   *         Separated primitives are handled by GJK, which searches for the
+   *         point of the Minkowski difference closest to the origin, and
+   *         overlapping ones by EPA, which expands the final GJK simplex to
+   *         find the penetration depth. The directions the final simplex was
+   *         built from are kept, and the next computation starts from them,
+   *         so that a pair that moves a little between calls, e.g. between
+   *         two control cycles, converges in a few iterations.
+   *  \author Marcus A Johansson */
+  class ConvexDistance {
+  public:
+    ConvexDistance();
+    ~ConvexDistance() noexcept {}
+
+    /*! \brief Computes the distance between the primitives at the poses,
+     *         warm started from the simplex of the previous call
+     *  \return 0 on success, -1 if a primitive has no support mapping */
+    int compute(GeometricPrimitive& first, const KDL::Frame& first_pose,
+                GeometricPrimitive& second, const KDL::Frame& second_pose);
+
+    /// \brief Forgets the cached simplex and normal, the next call to compute() starts from scratch
+    inline void reset() { n_cached_directions_ = 0; has_normal_ = false; }
+
+    /// \brief Returns the distance between the primitives, minus the penetration depth if they overlap
+    inline double getDistance() const { return distance_; }
+
+    /// \brief Returns the point of the first primitive closest to (deepest into) the second one, in world coordinates
+    inline const Eigen::Vector3d& getFirstPoint() const { return first_point_; }
+
+    /// \brief Returns the point of the second primitive closest to (deepest into) the first one, in world coordinates
+    inline const Eigen::Vector3d& getSecondPoint() const { return second_point_; }
+
+    /*! \brief Returns the unit direction from the first to the second
+     *         primitive, moving the second primitive along it increases the
+     *         distance at unit rate. While the primitives only touch, it is
+     *         the normal of the previous call, or on the first call the
+     *         direction between the witness points or the frame origins */
+    inline const Eigen::Vector3d& getNormal() const { return normal_; }
+
+    /// \brief Returns the number of GJK and EPA iterations of the last call to compute()
+    inline unsigned int getNumIterations() const { return n_iterations_; }
+
+  private:
+    ConvexDistance(const ConvexDistance& other) = delete;
+    ConvexDistance(ConvexDistance&& other) = delete;
+    ConvexDistance& operator=(const ConvexDistance& other) = delete;
+    ConvexDistance& operator=(ConvexDistance&& other) noexcept = delete;
+
+    /// \brief A vertex of the Minkowski difference, w = a - b, and the direction it supports
+    struct Vertex {
+      Eigen::Vector3d   w_;
+      Eigen::Vector3d   a_;
+      Eigen::Vector3d   b_;
+      Eigen::Vector3d   direction_;
+    };
+
+    struct Face {
+      int               vertices_[3];
+      Eigen::Vector3d   normal_; // outward unit normal, zero for degenerate faces
+      double            distance_; // from the origin along the normal
+    };
+
+    void support(const Eigen::Vector3d& direction, Vertex& vertex);
+
+    /// \brief Reduces the simplex to the smallest subset closest to the origin and returns the closest point
+    Eigen::Vector3d reduceSimplex();
+
+    bool isInSimplex(const Eigen::Vector3d& w) const;
+
+    /// \brief Sets the witness points from the barycentric coordinates of the simplex
+    void setWitnessPoints();
+
+    /// \brief Grows the simplex to a tetrahedron enclosing the origin, returns false if the primitives only touch
+    bool blowUpSimplex();
+
+    /// \brief Runs EPA from the tetrahedron in the simplex
+    void penetrate();
+
+    void addFace(int v0, int v1, int v2);
+    void addHorizonEdge(int v0, int v1);
+
+    GeometricPrimitive*            first_;
+    GeometricPrimitive*            second_;
+    KDL::Frame                     first_pose_;
+    KDL::Frame                     second_pose_;
+
+    Vertex                         simplex_[4];
+    double                         lambdas_[4]; // barycentric coordinates of the closest point
+    unsigned int                   n_simplex_;
+
+    Eigen::Vector3d                cached_directions_[4];
+    unsigned int                   n_cached_directions_;
+
+    std::vector<Vertex>            polytope_; // used by penetrate()
+    std::vector<Face>              faces_;
+    std::vector<std::pair<int, int> > horizon_;
+
+    double                         distance_;
+    Eigen::Vector3d                first_point_;
+    Eigen::Vector3d                second_point_;
+    Eigen::Vector3d                normal_;
+    bool                           has_normal_; // normal_ was computed by GJK or EPA
+    unsigned int                   n_iterations_;
+  };
+
+} // namespace geometric_primitives
+
+} // namespace hiqp
+
+#endif // include guard
@@ -22,6 +22,8 @@
 
 #include <kdl/frames.hpp>
 
+#include <cmath>
+
 #include <Eigen/Dense>
 
 namespace hiqp
@@ -112,6 +114,29 @@ namespace geometric_primitives
       return 0;
     }
 
+    bool getBounds(const KDL::Frame& pose, Eigen::AlignedBox3d& bounds) {
+      KDL::Vector c = pose * kdl_c_;
+      KDL::Rotation R = pose.M * rotation_kdl_;
+      Eigen::Vector3d half_extents;
+      for (int i = 0; i < 3; ++i)
+        half_extents(i) = 0.5 * (std::abs(R(i, 0)) * kdl_dim_(0) + 
+                                 std::abs(R(i, 1)) * kdl_dim_(1) + 
+                                 std::abs(R(i, 2)) * kdl_dim_(2));
+      bounds = Eigen::AlignedBox3d(Eigen::Vector3d(c.x(), c.y(), c.z()) - half_extents, 
+                                   Eigen::Vector3d(c.x(), c.y(), c.z()) + half_extents);
+      return true;
+    }
+
+    bool getSupport(const KDL::Vector& direction, KDL::Vector& support) {
+      // The corner furthest in the direction, in the axes of the box
+      KDL::Vector d = rotation_kdl_.Inverse(direction);
+      KDL::Vector corner;
+      for (int i = 0; i < 3; ++i)
+        corner(i) = (d(i) < 0 ? -0.5 : 0.5) * kdl_dim_(i);
+      support = kdl_c_ + rotation_kdl_ * corner;
+      return true;
+    }
+
     inline const KDL::Vector&     getCenterKDL() { return kdl_c_; }
 
     inline const Eigen::Vector3d& getCenterEigen() { return eigen_c_; }
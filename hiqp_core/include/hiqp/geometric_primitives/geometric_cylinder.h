@@ -79,6 +79,25 @@ namespace geometric_primitives
       return 0;
     }
 
+    // getBounds() is not implemented as the tasks on cylinders project onto 
+    // the infinite coaxial line, even for finite cylinders
+
+    bool getSupport(const KDL::Vector& direction, KDL::Vector& support) {
+      if (isInfinite())
+        return false;
+
+      // The end of the axis furthest in the direction, and the rim of its disc
+      double along = KDL::dot(direction, kdl_v_);
+      KDL::Vector radial = direction - kdl_v_ * along;
+      double radial_norm = radial.Norm();
+      support = kdl_p_;
+      if (along > 0)
+        support += kdl_v_ * h_;
+      if (radial_norm > 0)
+        support += radial * (radius_ / radial_norm);
+      return true;
+    }
+
     inline const KDL::Vector&     getDirectionKDL() { return kdl_v_; }
 
     inline const Eigen::Vector3d& getDirectionEigen() { return eigen_v_; }
@@ -91,6 +91,17 @@ namespace geometric_primitives
       return 0;
     }
 
+    bool getBounds(const KDL::Frame& pose, Eigen::AlignedBox3d& bounds) {
+      KDL::Vector c = pose * kdl_c_;
+      bounds = Eigen::AlignedBox3d(Eigen::Vector3d(c.x(), c.y(), c.z()));
+      return true;
+    }
+
+    bool getSupport(const KDL::Vector& direction, KDL::Vector& support) {
+      support = kdl_c_;
+      return true;
+    }
+
     inline const KDL::Vector& getCenterKDL() { return kdl_c_; }
     inline const Eigen::Vector3d& getCenterEigen() { return eigen_c_; }
     inline const Eigen::Quaternion<double>& getQuaternionEigen() { return q_; }
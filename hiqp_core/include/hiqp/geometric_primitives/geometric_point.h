@@ -60,6 +60,17 @@ namespace geometric_primitives
       return 0;
     }
 
+    bool getBounds(const KDL::Frame& pose, Eigen::AlignedBox3d& bounds) {
+      KDL::Vector p = pose * kdl_p_;
+      bounds = Eigen::AlignedBox3d(Eigen::Vector3d(p.x(), p.y(), p.z()));
+      return true;
+    }
+
+    bool getSupport(const KDL::Vector& direction, KDL::Vector& support) {
+      support = kdl_p_;
+      return true;
+    }
+
     inline const KDL::Vector&       getPointKDL()   { return kdl_p_; }
 
     inline const Eigen::Vector3d&   getPointEigen() { return eigen_p_; }
@@ -21,6 +21,10 @@
 #include <vector>
 #include <atomic>
 
+#include <kdl/frames.hpp>
+
+#include <Eigen/Geometry>
+
 namespace hiqp
 {
 namespace geometric_primitives
@@ -37,7 +41,9 @@ namespace geometric_primitives
                        const std::string& frame_id,
                        bool visible,
                        const std::vector<double>& color)
-     : name_(name), frame_id_(frame_id), visible_(visible), visual_id_(-1) {
+     : name_(name), frame_id_(frame_id), visible_(visible), visual_id_(-1),
+       published_sequence_(0), n_published_parameters_(0), update_queued_(false), applied_sequence_(0) {
+      applied_parameters_.reserve(MAX_PUBLISHED_PARAMETERS);
       r_ = color.at(0);
       g_ = color.at(1);
       b_ = color.at(2);
@@ -49,6 +55,80 @@ namespace geometric_primitives
     /*! \brief Must be specified by the inheriting class. */
     virtual int init(const std::vector<double>& parameters) = 0;
 
+    /*! \brief Computes the axis-aligned bounds of the primitive in the world
+     *         frame, used to skip tasks on primitives that are far apart,
+     *         see BroadPhase.
+     *  \param pose : the pose of the primitive's frame in the world frame
+     *  \return false if the primitive is unbounded, which is the default */
+    virtual bool getBounds(const KDL::Frame& pose, Eigen::AlignedBox3d& bounds) { return false; }
+
+    /*! \brief Computes the point of the primitive that is furthest in a
+     *         direction, used for distances between arbitrary convex
+     *         primitives, see ConvexDistance.
+     *  \param direction : in the frame of the primitive, need not be normalized
+     *  \param support : set to the point, in the frame of the primitive
+     *  \return false if the primitive is not a bounded convex shape, which is the default */
+    virtual bool getSupport(const KDL::Vector& direction, KDL::Vector& support) { return false; }
+
+    /*! \brief Publishes new parameters for the primitive without blocking,
+     *         e.g. from a ROS callback while the control loop reads the
+     *         primitive. The parameters are written to a seqlock and passed
+     *         to init() by the next call to applyPublishedParameters() in the
+     *         thread that reads the primitive. Concurrent writers only wait
+     *         for each other.
+     *  \return 0 on success, -1 if there are too many parameters */
+    int publishParameters(const std::vector<double>& parameters) {
+      const unsigned int n = parameters.size();
+      if (n > MAX_PUBLISHED_PARAMETERS)
+        return -1;
+
+      // The sequence is odd while a writer is writing
+      unsigned long sequence = published_sequence_.load(std::memory_order_relaxed);
+      do {
+        while (sequence & 1)
+          sequence = published_sequence_.load(std::memory_order_relaxed);
+      } while (!published_sequence_.compare_exchange_weak(sequence, sequence + 1,
+                                                          std::memory_order_acquire,
+                                                          std::memory_order_relaxed));
+      std::atomic_thread_fence(std::memory_order_release);
+
+      for (unsigned int i = 0; i < n; ++i)
+        published_parameters_[i].store(parameters[i], std::memory_order_relaxed);
+      n_published_parameters_.store(n, std::memory_order_relaxed);
+
+      published_sequence_.store(sequence + 2, std::memory_order_release);
+      return 0;
+    }
+
+    /*! \brief Initializes the primitive with the parameters last published with
+     *         publishParameters(), if there are new ones. Never blocks: if a
+     *         writer is publishing at the same time, the primitive is left as
+     *         it is and the parameters are applied in a later call.
+     *  \return true if new parameters were applied */
+    bool applyPublishedParameters() {
+      unsigned long sequence = published_sequence_.load(std::memory_order_acquire);
+      if (sequence == applied_sequence_ || (sequence & 1))
+        return false;
+
+      unsigned int n = n_published_parameters_.load(std::memory_order_relaxed);
+      applied_parameters_.resize(n);
+      for (unsigned int i = 0; i < n; ++i)
+        applied_parameters_[i] = published_parameters_[i].load(std::memory_order_relaxed);
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (published_sequence_.load(std::memory_order_relaxed) != sequence)
+        return false;
+
+      applied_sequence_ = sequence;
+      init(applied_parameters_);
+      return true;
+    }
+
+    /*! \brief Marks the primitive as queued for applyPublishedParameters(),
+     *         used by the GeometricPrimitiveMap to queue each primitive once.
+     *  \return whether it was queued before */
+    inline bool setUpdateQueued(bool queued) { return update_queued_.exchange(queued); }
+
     inline int            setVisualId(int visual_id) { visual_id_ = visual_id; }
     inline int            getVisualId() { return visual_id_; }
 
@@ -69,6 +149,15 @@ namespace geometric_primitives
     double       					               r_, g_, b_, a_;
 
   private:
+    static const unsigned int MAX_PUBLISHED_PARAMETERS = 16;
+
+    std::atomic<unsigned long>           published_sequence_; // seqlock of the published parameters
+    std::atomic<unsigned int>            n_published_parameters_;
+    std::atomic<double>                  published_parameters_[MAX_PUBLISHED_PARAMETERS];
+    std::atomic<bool>                    update_queued_;
+    unsigned long                        applied_sequence_; // only accessed by the reading thread
+    std::vector<double>                  applied_parameters_;
+
     GeometricPrimitive(const GeometricPrimitive& other) = delete;
     GeometricPrimitive(GeometricPrimitive&& other) = delete;
     GeometricPrimitive& operator=(const GeometricPrimitive& other) = delete;
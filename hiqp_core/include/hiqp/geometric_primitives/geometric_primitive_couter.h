@@ -41,6 +41,8 @@ namespace geometric_primitives {
     void visit(std::shared_ptr<GeometricCylinder> cylinder) { print(cylinder); std::cout << "cylinder\n"; }
     void visit(std::shared_ptr<GeometricSphere> sphere) { print(sphere); std::cout << "sphere\n"; }
     void visit(std::shared_ptr<GeometricFrame> frame) { print(frame); std::cout << "frame\n"; }
+    void visit(std::shared_ptr<GeometricCapsule> capsule) { print(capsule); std::cout << "capsule\n"; }
+    void visit(std::shared_ptr<GeometricSDF> sdf) { print(sdf); std::cout << "sdf\n"; }
 
 
   private:
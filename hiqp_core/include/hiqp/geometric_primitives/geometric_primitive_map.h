@@ -17,8 +17,13 @@
 #ifndef HIQP_GEOMETRIC_PRIMITIVE_MAP_H
 #define HIQP_GEOMETRIC_PRIMITIVE_MAP_H
 
-#include <map>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
 
 #include <hiqp/geometric_primitives/geometric_point.h>
 #include <hiqp/geometric_primitives/geometric_line.h>
@@ -27,18 +32,43 @@
 #include <hiqp/geometric_primitives/geometric_cylinder.h>
 #include <hiqp/geometric_primitives/geometric_sphere.h>
 #include <hiqp/geometric_primitives/geometric_frame.h>
+#include <hiqp/geometric_primitives/geometric_capsule.h>
+#include <hiqp/geometric_primitives/geometric_sdf.h>
 #include <hiqp/geometric_primitives/geometric_primitive_visitor.h>
+#include <hiqp/utilities.h>
 
 namespace hiqp
 {
 namespace geometric_primitives
 {
 
-  /*! \brief A common map data structure for all geometric primitive types.
+  /*! \brief Refers to a primitive in a GeometricPrimitiveMap without its name.
+   *         A handle is resolved in constant time, and once the primitive is
+   *         removed it is recognized as stale even if its slot is reused.
+   *  \author Marcus A Johansson */
+  struct GeometricPrimitiveHandle {
+    GeometricPrimitiveHandle() : type_(-1), slot_(0), generation_(0) {}
+    GeometricPrimitiveHandle(int type, unsigned int slot, unsigned int generation)
+    : type_(type), slot_(slot), generation_(generation) {}
+
+    /// \brief Returns whether the handle was obtained for a primitive, it might have been removed since
+    inline bool isValid() const { return type_ >= 0; }
+
+    int            type_; // index of the type of the primitive in the map, -1 if invalid
+    unsigned int   slot_;
+    unsigned int   generation_;
+  };
+
+  /*! \brief A common map data structure for all geometric primitive types. The
+   *         primitives of each type are kept densely packed in a slot map, so
+   *         that they are iterated over contiguously and removed in constant
+   *         time, and are referred to by handles that stay valid while the
+   *         primitive exists. Names are resolved to handles through a single
+   *         hashed index.
    *  \author Marcus A Johansson */  
   class GeometricPrimitiveMap {
   public:
-    GeometricPrimitiveMap() {}
+    GeometricPrimitiveMap();
     ~GeometricPrimitiveMap() noexcept {}
 
     int setGeometricPrimitive(const std::string& name,
@@ -52,13 +82,55 @@ namespace geometric_primitives
 
     int clear();
 
+    /// \brief Returns the handle of the primitive with the name, an invalid handle if there is no such primitive
+    GeometricPrimitiveHandle getHandle(const std::string& name) const;
+
+    /// \brief Returns the primitive with the handle, nullptr if it was removed or is of another type
+    template<typename PrimitiveType>
+    std::shared_ptr<PrimitiveType> getGeometricPrimitive(const GeometricPrimitiveHandle& handle);
+
     template<typename PrimitiveType>
-    std::shared_ptr<PrimitiveType> getGeometricPrimitive(const std::string& name);
+    std::shared_ptr<PrimitiveType> getGeometricPrimitive(const std::string& name)
+      { return getGeometricPrimitive<PrimitiveType>(getHandle(name)); }
+
+    /// \brief Returns the primitive with the name regardless of its type, nullptr if there is no such primitive
+    std::shared_ptr<GeometricPrimitive> getAnyGeometricPrimitive(const std::string& name);
+
+    template<typename PrimitiveType>
+    void updateGeometricPrimitive(const GeometricPrimitiveHandle& handle,
+                                  const std::vector<double>& parameters);
 
     template<typename PrimitiveType>
     void updateGeometricPrimitive(const std::string& name, 
                                   const std::vector<double>& parameters);
 
+    /*! \brief Publishes new parameters for a primitive, e.g. from a ROS
+     *         callback while the control loop reads the primitive, see
+     *         GeometricPrimitive::publishParameters(). They take effect in the
+     *         next call to applyPublishedParameters(). Never waits for the
+     *         control loop, only for primitives being added or removed, since
+     *         the name and the handle are resolved under structure_mutex_.
+     *  \return 0 on success, -1 if there is no such primitive of the type,
+     *          -2 if there are too many parameters */
+    template<typename PrimitiveType>
+    int publishGeometricPrimitive(const GeometricPrimitiveHandle& handle,
+                                  const std::vector<double>& parameters);
+
+    template<typename PrimitiveType>
+    int publishGeometricPrimitive(const std::string& name,
+                                  const std::vector<double>& parameters);
+
+    /*! \brief Initializes the primitives that got parameters published since
+     *         the last call with them. Meant to be called once per control
+     *         cycle by the thread that reads the primitives, before they are
+     *         read and while no primitives are added or removed. Only the
+     *         queued primitives are visited unless the queue overflowed.
+     *  \return the number of primitives that were updated */
+    unsigned int applyPublishedParameters();
+
+    /// \brief Returns the number of primitives of all types
+    inline unsigned int getNumPrimitives() const { return name_index_.size(); }
+
     void addDependencyToPrimitive(const std::string& name, const std::string& id);
     void removeDependency(const std::string& id);
     void acceptVisitor(GeometricPrimitiveVisitor& visitor, const std::string& primitive_name = "");
@@ -69,32 +141,250 @@ namespace geometric_primitives
     GeometricPrimitiveMap& operator=(const GeometricPrimitiveMap& other) = delete;
     GeometricPrimitiveMap& operator=(GeometricPrimitiveMap&& other) noexcept = delete;
 
-    std::string getDependenciesAsString(std::string name);
+    /*! \brief The primitives of one type, densely packed. A slot refers to a
+     *         primitive for as long as it is stored, erase() moves the last
+     *         primitive into the place of the erased one and bumps the
+     *         generation of the slot, which invalidates its handles. */
+    template<typename PrimitiveType>
+    class SlotMap {
+    public:
+      /// \brief Stores the primitive and returns its slot, the current generation of the slot is written to generation
+      unsigned int insert(const std::shared_ptr<PrimitiveType>& primitive, unsigned int& generation);
+
+      void erase(unsigned int slot);
+
+      /// \brief Returns the primitive in the slot, nullptr if the generation is not the current one
+      inline std::shared_ptr<PrimitiveType> get(unsigned int slot, unsigned int generation) const {
+        if (slot >= slot_generations_.size() || slot_generations_[slot] != generation)
+          return nullptr;
+        return primitives_[slot_indices_[slot]];
+      }
+
+      /// \brief Like get() without copying the shared pointer
+      inline PrimitiveType* find(unsigned int slot, unsigned int generation) const {
+        if (slot >= slot_generations_.size() || slot_generations_[slot] != generation)
+          return nullptr;
+        return primitives_[slot_indices_[slot]].get();
+      }
+
+      inline const std::vector< std::shared_ptr<PrimitiveType> >& getPrimitives() const { return primitives_; }
+
+    private:
+      std::vector< std::shared_ptr<PrimitiveType> >   primitives_; // densely packed
+      std::vector<unsigned int>                       primitive_slots_; // slot of each of primitives_
+      std::vector<unsigned int>                       slot_indices_; // index into primitives_ of each slot
+      std::vector<unsigned int>                       slot_generations_;
+      std::vector<unsigned int>                       free_slots_;
+    };
+
+    /*! \brief A bounded lock-free queue of handles that any number of threads
+     *         push to and one thread pops from. */
+    class HandleQueue {
+    public:
+      /// \param capacity : must be a power of two
+      HandleQueue(unsigned int capacity);
+
+      /// \brief Returns false if the queue is full
+      bool push(const GeometricPrimitiveHandle& handle);
+
+      /// \brief Returns false if the queue is empty, must only be called by one thread
+      bool pop(GeometricPrimitiveHandle& handle);
+
+    private:
+      struct Cell {
+        std::atomic<unsigned long>    sequence_; // the position the cell can be pushed to, plus one once pushed
+        GeometricPrimitiveHandle      handle_;
+      };
+
+      std::unique_ptr<Cell[]>       cells_;
+      unsigned long                 mask_;
+      std::atomic<unsigned long>    push_position_;
+      unsigned long                 pop_position_;
+    };
 
-    typedef std::map< std::string, std::vector< std::string> >          DependencyMap;
-    typedef std::map< std::string, std::shared_ptr<GeometricPoint> >    PointMap;
-    typedef std::map< std::string, std::shared_ptr<GeometricLine> >     LineMap;
-    typedef std::map< std::string, std::shared_ptr<GeometricPlane> >    PlaneMap;
-    typedef std::map< std::string, std::shared_ptr<GeometricBox> >      BoxMap;
-    typedef std::map< std::string, std::shared_ptr<GeometricCylinder> > CylinderMap;
-    typedef std::map< std::string, std::shared_ptr<GeometricSphere> >   SphereMap;
-    typedef std::map< std::string, std::shared_ptr<GeometricFrame> >    FrameMap;
+    /// \brief The index of the slot map of each primitive type in slot_maps_
+    template<typename PrimitiveType>
+    struct PrimitiveTypeIndex;
+
+    typedef std::tuple< SlotMap<GeometricPoint>,
+                        SlotMap<GeometricLine>,
+                        SlotMap<GeometricPlane>,
+                        SlotMap<GeometricBox>,
+                        SlotMap<GeometricCylinder>,
+                        SlotMap<GeometricSphere>,
+                        SlotMap<GeometricFrame>,
+                        SlotMap<GeometricCapsule>,
+                        SlotMap<GeometricSDF> >  SlotMaps;
+
+    template<typename PrimitiveType>
+    inline SlotMap<PrimitiveType>& getSlotMap()
+      { return std::get< PrimitiveTypeIndex<PrimitiveType>::value >(slot_maps_); }
+
+    /// \brief A primitive along with the names of the tasks that depend on it
+    struct PrimitiveEntry {
+      GeometricPrimitiveHandle    handle_;
+      std::vector<std::string>    dependencies_;
+    };
+
+    typedef std::unordered_map<std::string, PrimitiveEntry>  NameIndex;
+
+    /// \brief Creates, initializes and stores a primitive of the type
+    template<typename PrimitiveType>
+    int addGeometricPrimitive(const std::string& name,
+                              const std::string& frame_id,
+                              bool visible,
+                              const std::vector<double>& color,
+                              const std::vector<double>& parameters);
+
+    /// \brief Publishes the parameters to the primitive with the handle, structure_mutex_ must be held
+    template<typename PrimitiveType>
+    int publishToPrimitive(const GeometricPrimitiveHandle& handle,
+                           const std::vector<double>& parameters);
+
+    /// \brief Erases the primitive of the entry from the slot map of its type
+    void erasePrimitive(const PrimitiveEntry& entry);
 
-    DependencyMap   dependency_map_;
-    PointMap        point_map_;
-    LineMap         line_map_;
-    PlaneMap        plane_map_;
-    BoxMap          box_map_;
-    CylinderMap     cylinder_map_;
-    SphereMap       sphere_map_;
-    FrameMap        frame_map_;
+    /// \brief Returns the primitive with the handle regardless of its type, nullptr if it was removed
+    GeometricPrimitive* findPrimitive(const GeometricPrimitiveHandle& handle);
 
-    std::vector<std::string> all_primitive_names_;
+    std::string getDependenciesAsString(const PrimitiveEntry& entry);
 
+    SlotMaps        slot_maps_;
+    NameIndex       name_index_;
+    std::mutex      structure_mutex_; // held while primitives are added or removed, and by publishGeometricPrimitive()
+
+    HandleQueue          update_queue_; // primitives with published parameters
+    std::atomic<bool>    update_queue_overflow_; // some primitives could not be queued
   };
 
+  template<> struct GeometricPrimitiveMap::PrimitiveTypeIndex<GeometricPoint>    { static const int value = 0; };
+  template<> struct GeometricPrimitiveMap::PrimitiveTypeIndex<GeometricLine>     { static const int value = 1; };
+  template<> struct GeometricPrimitiveMap::PrimitiveTypeIndex<GeometricPlane>    { static const int value = 2; };
+  template<> struct GeometricPrimitiveMap::PrimitiveTypeIndex<GeometricBox>      { static const int value = 3; };
+  template<> struct GeometricPrimitiveMap::PrimitiveTypeIndex<GeometricCylinder> { static const int value = 4; };
+  template<> struct GeometricPrimitiveMap::PrimitiveTypeIndex<GeometricSphere>   { static const int value = 5; };
+  template<> struct GeometricPrimitiveMap::PrimitiveTypeIndex<GeometricFrame>    { static const int value = 6; };
+  template<> struct GeometricPrimitiveMap::PrimitiveTypeIndex<GeometricCapsule>  { static const int value = 7; };
+  template<> struct GeometricPrimitiveMap::PrimitiveTypeIndex<GeometricSDF>      { static const int value = 8; };
+
+  template<typename PrimitiveType>
+  unsigned int GeometricPrimitiveMap::SlotMap<PrimitiveType>::insert(const std::shared_ptr<PrimitiveType>& primitive,
+                                                                     unsigned int& generation) {
+    unsigned int slot;
+    if (free_slots_.empty()) {
+      slot = slot_indices_.size();
+      slot_indices_.push_back(0);
+      slot_generations_.push_back(0);
+    } else {
+      slot = free_slots_.back();
+      free_slots_.pop_back();
+    }
+    slot_indices_[slot] = primitives_.size();
+    primitives_.push_back(primitive);
+    primitive_slots_.push_back(slot);
+    generation = slot_generations_[slot];
+    return slot;
+  }
+
+  template<typename PrimitiveType>
+  void GeometricPrimitiveMap::SlotMap<PrimitiveType>::erase(unsigned int slot) {
+    unsigned int index = slot_indices_[slot];
+    unsigned int last_slot = primitive_slots_.back();
+
+    primitives_[index] = std::move(primitives_.back());
+    primitive_slots_[index] = last_slot;
+    slot_indices_[last_slot] = index;
+    primitives_.pop_back();
+    primitive_slots_.pop_back();
+
+    ++slot_generations_[slot];
+    free_slots_.push_back(slot);
+  }
+
+  template<typename PrimitiveType>
+  std::shared_ptr<PrimitiveType> GeometricPrimitiveMap::getGeometricPrimitive(const GeometricPrimitiveHandle& handle) {
+    if (handle.type_ != PrimitiveTypeIndex<PrimitiveType>::value)
+      return nullptr;
+    return getSlotMap<PrimitiveType>().get(handle.slot_, handle.generation_);
+  }
+
+  template<typename PrimitiveType>
+  void GeometricPrimitiveMap::updateGeometricPrimitive(const GeometricPrimitiveHandle& handle,
+                                                       const std::vector<double>& parameters) {
+    std::shared_ptr<PrimitiveType> primitive = getGeometricPrimitive<PrimitiveType>(handle);
+    if (!primitive) {
+      printHiqpWarning("Couldn't update geometric primitive. The primitive was not found!");
+      return;
+    }
+    primitive->init(parameters);
+  }
+
+  template<typename PrimitiveType>
+  void GeometricPrimitiveMap::updateGeometricPrimitive(const std::string& name,
+                                                       const std::vector<double>& parameters) {
+    std::shared_ptr<PrimitiveType> primitive = getGeometricPrimitive<PrimitiveType>(name);
+    if (!primitive) {
+      printHiqpWarning("Couldn't update geometric primitive with name '" + 
+        name + "'. No primitive of that type was found!");
+      return;
+    }
+    primitive->init(parameters);
+  }
+
+  template<typename PrimitiveType>
+  int GeometricPrimitiveMap::publishGeometricPrimitive(const GeometricPrimitiveHandle& handle,
+                                                       const std::vector<double>& parameters) {
+    std::lock_guard<std::mutex> lock(structure_mutex_);
+    return publishToPrimitive<PrimitiveType>(handle, parameters);
+  }
+
+  template<typename PrimitiveType>
+  int GeometricPrimitiveMap::publishGeometricPrimitive(const std::string& name,
+                                                       const std::vector<double>& parameters) {
+    std::lock_guard<std::mutex> lock(structure_mutex_);
+    return publishToPrimitive<PrimitiveType>(getHandle(name), parameters);
+  }
+
+  template<typename PrimitiveType>
+  int GeometricPrimitiveMap::publishToPrimitive(const GeometricPrimitiveHandle& handle,
+                                                const std::vector<double>& parameters) {
+    std::shared_ptr<PrimitiveType> primitive = getGeometricPrimitive<PrimitiveType>(handle);
+    if (!primitive) {
+      printHiqpWarning("Couldn't publish parameters of geometric primitive. The primitive was not found!");
+      return -1;
+    }
+    if (primitive->publishParameters(parameters) != 0) {
+      printHiqpWarning("Couldn't publish parameters of geometric primitive '" + 
+        primitive->getName() + "'. Too many parameters!");
+      return -2;
+    }
+
+    // A primitive is queued once until its parameters are applied
+    if (!primitive->setUpdateQueued(true) && !update_queue_.push(handle))
+      update_queue_overflow_.store(true);
+    return 0;
+  }
+
+  template<typename PrimitiveType>
+  int GeometricPrimitiveMap::addGeometricPrimitive(const std::string& name,
+                                                   const std::string& frame_id,
+                                                   bool visible,
+                                                   const std::vector<double>& color,
+                                                   const std::vector<double>& parameters) {
+    auto primitive = std::make_shared<PrimitiveType>(name, frame_id, visible, color);
+    if (primitive->init(parameters) != 0)
+      return -3;
+
+    unsigned int generation = 0;
+    unsigned int slot = getSlotMap<PrimitiveType>().insert(primitive, generation);
+    PrimitiveEntry& entry = name_index_[name];
+    entry.handle_ = GeometricPrimitiveHandle(PrimitiveTypeIndex<PrimitiveType>::value, slot, generation);
+    entry.dependencies_.clear();
+    return 0;
+  }
+
 } // namespace geometric_primitives
 
 } // namespace hiqp
 
-#endif // include guard
\ No newline at end of file
+#endif // include guard
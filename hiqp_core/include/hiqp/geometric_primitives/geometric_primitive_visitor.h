@@ -26,6 +26,8 @@
 #include <hiqp/geometric_primitives/geometric_cylinder.h>
 #include <hiqp/geometric_primitives/geometric_sphere.h>
 #include <hiqp/geometric_primitives/geometric_frame.h>
+#include <hiqp/geometric_primitives/geometric_capsule.h>
+#include <hiqp/geometric_primitives/geometric_sdf.h>
 
 namespace hiqp {
 
@@ -45,6 +47,8 @@ namespace geometric_primitives {
     virtual void visit(std::shared_ptr<GeometricCylinder> cylinder) = 0;
     virtual void visit(std::shared_ptr<GeometricSphere> sphere) = 0;
     virtual void visit(std::shared_ptr<GeometricFrame> frame) = 0;
+    virtual void visit(std::shared_ptr<GeometricCapsule> capsule) = 0;
+    virtual void visit(std::shared_ptr<GeometricSDF> sdf) = 0;
 
   private:
     GeometricPrimitiveVisitor(const GeometricPrimitiveVisitor& other) = delete;
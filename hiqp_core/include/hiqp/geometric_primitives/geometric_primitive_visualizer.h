@@ -45,6 +45,8 @@ namespace geometric_primitives {
     void visit(std::shared_ptr<GeometricCylinder> cylinder) { visit__(cylinder); }
     void visit(std::shared_ptr<GeometricSphere> sphere) { visit__(sphere); }
     void visit(std::shared_ptr<GeometricFrame> frame);
+    void visit(std::shared_ptr<GeometricCapsule> capsule);
+    void visit(std::shared_ptr<GeometricSDF> sdf) { visit__(sdf); }
 
     /// \brief Effectively removes all visited geometric primitives.
     void removeAllVisitedPrimitives() {
@@ -102,10 +104,35 @@ namespace geometric_primitives {
     }
   }
 
+  template <>
+  void GeometricPrimitiveVisualizer::visit__<GeometricCapsule>(std::shared_ptr<GeometricCapsule> primitive) {
+    int id = primitive->getVisualId();
+    switch (action_) {
+    case 0:
+      if (id < 0) primitive->setVisualId(visualizer_->add(primitive));
+      else        visualizer_->update(id, primitive);
+      break;
+    case 1:
+      if (id >= 0) {
+        // the capsule primitive consists of three successive visual markers
+        visited_visual_ids_.push_back(id);
+        visited_visual_ids_.push_back(id+1);
+        visited_visual_ids_.push_back(id+2);
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
   void GeometricPrimitiveVisualizer::visit(std::shared_ptr<GeometricFrame> frame) {
     visit__(frame);
   }
 
+  void GeometricPrimitiveVisualizer::visit(std::shared_ptr<GeometricCapsule> capsule) {
+    visit__(capsule);
+  }
+
 } // namespace geometric_primitives
 
 } // namespace hiqp
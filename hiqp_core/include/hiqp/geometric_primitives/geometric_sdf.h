@@ -0,0 +1,123 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef HIQP_GEOMETRIC_SDF_H
+#define HIQP_GEOMETRIC_SDF_H
+
+#include <cmath>
+
+#include <hiqp/geometric_primitives/geometric_primitive.h>
+#include <hiqp/geometric_primitives/sdf_grid.h>
+#include <hiqp/utilities.h>
+
+#include <kdl/frames.hpp>
+
+#include <Eigen/Dense>
+
+namespace hiqp
+{
+namespace geometric_primitives
+{
+
+  /*! \brief A signed distance field of dense obstacle geometry, e.g. fixtures
+   *         that would take many boxes to approximate. The field is loaded
+   *         from the grid file "<name>.sdf" in the directory set with
+   *         SDFGrid::setDirectory(), see SDFGrid for the file format.
+   *         Parameters: [x, y, z]
+   *  \author Marcus A Johansson */
+  class GeometricSDF : public GeometricPrimitive {
+  public:
+    GeometricSDF(const std::string& name,
+                 const std::string& frame_id,
+                 bool visible,
+                 const std::vector<double>& color)
+     : GeometricPrimitive(name, frame_id, visible, color) {}
+
+    ~GeometricSDF() noexcept = default;
+
+    /*! \brief Parses a set of parameters and initializes the field. The grid
+     *         file is only loaded by the first call, later calls only move
+     *         the grid.
+     *  \param parameters : Should be of size 3.<ol>
+     *                      <li>Indices 0-2 (required) defines the position of the grid in the frame.</li>
+     *                      </ol>
+     * \return 0 on success, -1 if the wrong number of parameters was sent,
+     *         -2 if the grid file could not be loaded */
+    int init(const std::vector<double>& parameters) {
+      int size = parameters.size();
+      if (size != 3) {
+        printHiqpWarning("GeometricSDF requires 3 parameters, got " 
+          + std::to_string(size) + "! Initialization failed!");
+        return -1;
+      }
+
+      if (!grid_.isLoaded() && grid_.load(SDFGrid::getDirectory() + "/" + name_ + ".sdf") != 0) {
+        printHiqpWarning("GeometricSDF '" + name_ + "' couldn't load its grid! Initialization failed!");
+        return -2;
+      }
+
+      kdl_p_(0) = parameters.at(0);
+      kdl_p_(1) = parameters.at(1);
+      kdl_p_(2) = parameters.at(2);
+
+      eigen_p_ << kdl_p_(0), kdl_p_(1), kdl_p_(2);
+      return 0;
+    }
+
+    bool getBounds(const KDL::Frame& pose, Eigen::AlignedBox3d& bounds) {
+      Eigen::Vector3d c = grid_.getBounds().center() + eigen_p_;
+      Eigen::Vector3d e = 0.5 * grid_.getBounds().sizes();
+      KDL::Vector center = pose * KDL::Vector(c(0), c(1), c(2));
+      Eigen::Vector3d half;
+      for (int i = 0; i < 3; ++i)
+        half(i) = std::abs(pose.M(i, 0)) * e(0) + std::abs(pose.M(i, 1)) * e(1) + std::abs(pose.M(i, 2)) * e(2);
+      Eigen::Vector3d w(center.x(), center.y(), center.z());
+      bounds = Eigen::AlignedBox3d(w - half, w + half);
+      return true;
+    }
+
+    /*! \brief Returns the signed distance at p and writes its gradient to gradient, see SDFGrid::getDistance()
+     *  \param p : in the frame of the primitive */
+    inline double getDistance(const Eigen::Vector3d& p, Eigen::Vector3d& gradient) const
+      { return grid_.getDistance(p - eigen_p_, gradient); }
+
+    inline const SDFGrid&         getGrid() { return grid_; }
+
+    inline const KDL::Vector&     getOffsetKDL() { return kdl_p_; }
+    inline const Eigen::Vector3d& getOffsetEigen() { return eigen_p_; }
+
+    inline double getX()      { return kdl_p_(0); }
+    inline double getY()      { return kdl_p_(1); }
+    inline double getZ()      { return kdl_p_(2); }
+
+  protected:
+    SDFGrid          grid_;
+    KDL::Vector      kdl_p_; // the position of the grid
+    Eigen::Vector3d  eigen_p_;
+
+  private:
+    GeometricSDF(const GeometricSDF& other) = delete;
+    GeometricSDF(GeometricSDF&& other) = delete;
+    GeometricSDF& operator=(const GeometricSDF& other) = delete;
+    GeometricSDF& operator=(GeometricSDF&& other) noexcept = delete;
+  };
+
+} // namespace geometric_primitives
+
+} // namespace hiqp
+
+#endif // include guard
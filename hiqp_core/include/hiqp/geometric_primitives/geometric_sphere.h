@@ -64,6 +64,22 @@ namespace geometric_primitives
       return 0;
     }
 
+    bool getBounds(const KDL::Frame& pose, Eigen::AlignedBox3d& bounds) {
+      KDL::Vector c = pose * kdl_p_;
+      Eigen::Vector3d r = Eigen::Vector3d::Constant(radius_);
+      bounds = Eigen::AlignedBox3d(Eigen::Vector3d(c.x(), c.y(), c.z()) - r, 
+                                   Eigen::Vector3d(c.x(), c.y(), c.z()) + r);
+      return true;
+    }
+
+    bool getSupport(const KDL::Vector& direction, KDL::Vector& support) {
+      double norm = direction.Norm();
+      support = kdl_p_;
+      if (norm > 0)
+        support += direction * (radius_ / norm);
+      return true;
+    }
+
     inline const KDL::Vector&     getCenterKDL() { return kdl_p_; }
     inline const Eigen::Vector3d& getCenterEigen() { return eigen_p_; }
 
@@ -0,0 +1,98 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef HIQP_SDF_GRID_H
+#define HIQP_SDF_GRID_H
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+namespace hiqp
+{
+namespace geometric_primitives
+{
+
+  /*! \brief A signed distance field sampled on a regular grid, memory-mapped
+   *         read-only from a binary file. The file starts with a 56 byte
+   *         header in native byte order: the characters "HIQPSDF1", the
+   *         number of samples along x, y and z (uint32 each, at least 2),
+   *         4 bytes of padding, the position of the first sample (3 doubles)
+   *         and the distance between neighbouring samples (a double). The
+   *         header is followed by the distances as floats, with x varying
+   *         fastest and z slowest. Distances are negative inside obstacles.
+   *  \author Marcus A Johansson */
+  class SDFGrid {
+  public:
+    SDFGrid();
+    ~SDFGrid() noexcept;
+
+    /*! \brief Maps the grid file
+     *  \return 0 on success, -1 if the file could not be opened or mapped, -2 if its header or size is invalid */
+    int load(const std::string& path);
+
+    inline bool isLoaded() const { return distances_ != nullptr; }
+
+    /*! \brief Returns the signed distance at p, interpolated trilinearly
+     *         between the samples, and writes its gradient to gradient.
+     *         Outside the grid the distance is that of the closest point on
+     *         the grid plus the distance to it.
+     *  \param p : in the frame of the grid */
+    double getDistance(const Eigen::Vector3d& p, Eigen::Vector3d& gradient) const;
+
+    /// \brief Returns the box spanned by the samples, in the frame of the grid
+    inline const Eigen::AlignedBox3d& getBounds() const { return bounds_; }
+
+    inline double getVoxelSize() const { return voxel_size_; }
+
+    /// \brief Returns the positions of the samples within one voxel inside the surface, e.g. for visualization
+    inline const std::vector<Eigen::Vector3d>& getSurfaceSamples() const { return surface_samples_; }
+
+    /// \brief Sets the directory the grid files of SDF primitives are looked up in, see GeometricSDF
+    static void setDirectory(const std::string& directory);
+
+    static std::string getDirectory();
+
+  private:
+    SDFGrid(const SDFGrid& other) = delete;
+    SDFGrid(SDFGrid&& other) = delete;
+    SDFGrid& operator=(const SDFGrid& other) = delete;
+    SDFGrid& operator=(SDFGrid&& other) noexcept = delete;
+
+    void unload();
+
+    inline double sample(unsigned int i, unsigned int j, unsigned int k) const
+      { return distances_[(k * ny_ + j) * nx_ + i]; }
+
+    void*                 mapping_;
+    std::size_t           mapping_size_;
+    const float*          distances_; // points into mapping_
+
+    unsigned int          nx_, ny_, nz_;
+    Eigen::Vector3d       origin_;
+    double                voxel_size_;
+    Eigen::AlignedBox3d   bounds_;
+    std::vector<Eigen::Vector3d> surface_samples_; // found once by load()
+  };
+
+} // namespace geometric_primitives
+
+} // namespace hiqp
+
+#endif // include guard
@@ -0,0 +1,45 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef HIQP_SEGMENT_DISTANCE_H
+#define HIQP_SEGMENT_DISTANCE_H
+
+#include <kdl/frames.hpp>
+
+namespace hiqp
+{
+namespace geometric_primitives
+{
+
+  /*! \brief Computes the closest points c1 = p1 + s d1 and c2 = p2 + t d2 of
+   *         two line segments, with s in [s1_min, s1_max] and t in
+   *         [s2_min, s2_max]. Infinite bounds make a segment a line, equal
+   *         bounds or a zero direction make it a point.
+   *  \return the squared distance between c1 and c2 */
+  double closestSegmentPoints
+  (
+    const KDL::Vector& p1, const KDL::Vector& d1, double s1_min, double s1_max,
+    const KDL::Vector& p2, const KDL::Vector& d2, double s2_min, double s2_max,
+    KDL::Vector& c1,
+    KDL::Vector& c2
+  );
+
+} // namespace geometric_primitives
+
+} // namespace hiqp
+
+#endif // include guard
@@ -19,13 +19,19 @@
 
 #include <map>
 #include <vector>
+#include <chrono>
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <cmath>
 #include <Eigen/Dense>
+#include <Eigen/SparseCore>
 
 namespace hiqp
 {
 
+  class WorkerPool;
+
   /*! \brief A stage is a compound set of tasks with the same priority level.
    *  \author Marcus A Johansson */
   struct HiQPStage {
@@ -33,92 +39,388 @@ namespace hiqp
     Eigen::VectorXd e_dot_star_;
     Eigen::MatrixXd J_;
     std::vector<int> constraint_signs_;
+    std::vector<int> bound_cols_; // column of the only nonzero of each row of J, -1 if the row has more nonzeros
+
+    /*! \brief J_ in compressed row storage, only built with HiQPSolver::setSparseStages(). The
+     *         nonzeros are the column supports of the tasks, explicit zeros included, so the
+     *         pattern only changes with the set of tasks. */
+    Eigen::SparseMatrix<double, Eigen::RowMajor> J_sparse_;
+    std::vector<int> support_outer_; // pattern of the appended rows, see J_sparse_
+    std::vector<int> support_inner_;
+
+    /*! \brief Whether the equality rows were compressed, see HiQPSolver::setRowCompression(),
+     *         the rows are then kept as appended in the *_original_ members */
+    bool compressed_;
+    Eigen::VectorXd e_dot_star_original_;
+    Eigen::MatrixXd J_original_;
+    std::vector<int> constraint_signs_original_;
+    std::vector<int> support_outer_original_;
+    std::vector<int> support_inner_original_;
+    Eigen::ColPivHouseholderQR<Eigen::MatrixXd> eq_qr_; // of the equality rows
+    Eigen::MatrixXd J_eq_;
+    Eigen::VectorXd e_dot_star_eq_;
   };
 
   /*! \brief The base class for a solver for controls from a set of stages. Keeps an internal set of stages that tasks can be appended to.
    *  \author Marcus A Johansson */
   class HiQPSolver {
   public:
-    HiQPSolver() {}
+    HiQPSolver() 
+    : null_space_fast_path_(false), cycle_budget_(0), n_guaranteed_stages_(1), n_solved_stages_(0),
+      worker_pool_(nullptr), sparse_stages_(false), row_compression_(false),
+      guaranteed_by_priority_level_(false), guaranteed_priority_level_(0) {}
     ~HiQPSolver() noexcept {}
 
+    /// \brief Called once the number of solution dimensions is known, solvers can preallocate their storage here
+    virtual void init(unsigned int n_solution_dims) {}
+
     virtual bool solve(std::vector<double>& solution) = 0;
 
+    /*! \brief Enables solving the leading stages that contain only equality
+     *         rows in closed form, see solveEqualityStages(). */
+    void setNullSpaceFastPath(bool enabled) { null_space_fast_path_ = enabled; }
+
+    /*! \brief Enables keeping the stages in compressed row storage as well,
+     *         using the column supports passed to appendStage(). Backends
+     *         that support it then only receive the nonzeros of the stages.
+     *         Jacobian entries outside the column support are ignored. */
+    void setSparseStages(bool enabled) { sparse_stages_ = enabled; }
+
+    /*! \brief Enables compressing linearly dependent equality rows in
+     *         finalizeStages(). The equality rows J*dq = de* of a stage that
+     *         are not of full row rank, judging from a rank-revealing QR
+     *         J = Q*R, are replaced by the rank many rows Q1'*J*dq = Q1'*de*.
+     *         These have the same least squares residual, so the slacks of
+     *         the stage cost the same and the solution does not change, but
+     *         the backends get fewer and well-conditioned rows. A
+     *         dependent but inconsistent highest stage is solved in the least
+     *         squares sense instead of failing. The slacks of the rows as
+     *         they were appended are available from getStageSlacks(). Note
+     *         that the compressed rows can act on joints that no single
+     *         appended row couples, which the DecoupledSolver then solves
+     *         together. */
+    void setRowCompression(bool enabled) { row_compression_ = enabled; }
+
+    /*! \brief Limits the time solve() may spend. The stages are solved in
+     *         priority order and a stage is only started if it is expected
+     *         to finish within the budget, judging from how long its priority
+     *         level took in the last cycle it was solved. The first
+     *         n_guaranteed_stages stages are always solved. If solve() stops
+     *         early, or a stage after the guaranteed ones fails, the solution
+     *         of the last solved stage is returned, or solve() fails if no
+     *         stage was solved.
+     *  \param budget : the time budget in seconds, zero or less disables the budget */
+    void setCycleBudget(double budget, unsigned int n_guaranteed_stages) {
+      cycle_budget_ = budget;
+      n_guaranteed_stages_ = n_guaranteed_stages;
+      guaranteed_by_priority_level_ = false;
+    }
+
+    /*! \brief Guarantees the stages of setCycleBudget() by priority level
+     *         rather than by position: finalizeStages() counts the stages with
+     *         a priority level up to max_priority_level as the guaranteed ones.
+     *         A guaranteed level that got no rows in a cycle thus does not
+     *         make a lower level guaranteed. Lasts until the next call to
+     *         setCycleBudget(). */
+    void setGuaranteedPriorityLevel(std::size_t max_priority_level) {
+      guaranteed_priority_level_ = max_priority_level;
+      guaranteed_by_priority_level_ = true;
+    }
+
+    /*! \brief Sets a pool of threads that backends which solve parts of the
+     *         problem in parallel can use during solve(). The pool is not
+     *         owned and must outlive the solver, nullptr solves serially. */
+    void setWorkerPool(WorkerPool* worker_pool) { worker_pool_ = worker_pool; }
+
+    /// \brief Returns the number of stages the solution of the last solve() satisfies in priority order
+    unsigned int getNumSolvedStages() const { return n_solved_stages_; }
+
+    /// \brief Returns the seconds the stage of the priority level took in the last cycle it was solved, or 0 if it never was
+    double getLevelDuration(std::size_t priority_level) const {
+      std::map<std::size_t, double>::const_iterator it = level_durations_.find(priority_level);
+      return (it == level_durations_.end() ? 0.0 : it->second);
+    }
+
+    /// \brief Returns the number of stages after the last finalizeStages()
+    unsigned int getNumStages() const { return stages_map_.size(); }
+
+    /*! \brief Empties all stages while keeping their storage. The stages are
+     *         refilled with appendStage() and must be completed with
+     *         finalizeStages() before solving. */
     int clearStages() {
-      stages_map_.clear();
+      for (auto&& kv : stages_map_) {
+        HiQPStage& stage = kv.second;
+        if (stage.compressed_) {
+          // Refill the storage the rows were appended to in the last cycle
+          stage.J_.swap(stage.J_original_);
+          stage.e_dot_star_.swap(stage.e_dot_star_original_);
+          stage.constraint_signs_.swap(stage.constraint_signs_original_);
+          stage.compressed_ = false;
+        }
+        kv.second.nRows = 0;
+        kv.second.support_outer_.assign(1, 0);
+        kv.second.support_inner_.clear();
+      }
       return 0;
     }
 
-    /*! \brief Appends the internal set of stages with a task. If a stage with the priority is not currently present in the stages map, it is created, otherwise the task is appended to that existing stage. */
+    /*! \brief Appends the internal set of stages with a task. If a stage with the priority is not currently present in the stages map, it is created, otherwise the task is appended to that existing stage. The rows are written into the storage of the stage, which only grows if the stage got more rows than in the last cycle.
+     *  \param column_support : the sorted columns J can have nonzeros in, empty if any, see setSparseStages() */
     int appendStage(std::size_t priority_level, 
                     const Eigen::VectorXd& e_dot_star,
                     const Eigen::MatrixXd& J,
-                    const std::vector<int>& constraint_signs) {
+                    const std::vector<int>& constraint_signs,
+                    const std::vector<int>& column_support = std::vector<int>()) {
       StageMap::iterator it = stages_map_.find(priority_level);
 
       if (it == stages_map_.end()) {
+        it = stages_map_.emplace(priority_level, HiQPStage()).first;
+        it->second.nRows = 0;
+        it->second.support_outer_.assign(1, 0);
+        it->second.compressed_ = false;
+      }
+
+      HiQPStage& stage = it->second;
+      int rows = e_dot_star.rows();
+      int n_rows = stage.nRows + rows;
+
+      if (stage.J_.rows() < n_rows || stage.J_.cols() != J.cols()) {
+        stage.e_dot_star_.conservativeResize(n_rows);
+        stage.J_.conservativeResize(n_rows, J.cols());
+      }
+
+      stage.e_dot_star_.segment(stage.nRows, rows) = e_dot_star;
+      stage.J_.middleRows(stage.nRows, rows) = J;
+      stage.constraint_signs_.resize(stage.nRows);
+      stage.constraint_signs_.insert(stage.constraint_signs_.end(),
+                                     constraint_signs.begin(),
+                                     constraint_signs.end());
+      stage.nRows = n_rows;
 
-        HiQPStage stage;
-        stage.e_dot_star_ = e_dot_star;
-        stage.J_ = J;
-        stage.constraint_signs_ = constraint_signs;
-        stage.nRows = e_dot_star.rows();
-        stages_map_.emplace(priority_level, stage);
-       // DEBUG =============================================
-        /* std::cerr<<std::setprecision(2)<<"append new stage: "<<std::endl; */
-        /* std::cerr<<"J_t: "<<std::endl<<stage.J_<<std::endl; */
-        /* std::cerr<<"signs: "; */
-        /* for (unsigned int k=0;k<stage.constraint_signs_.size();k++) */
-        /*   std::cerr<<stage.constraint_signs_[k]<<" "; */
-
-        /* std::cerr<<std::endl<<"de*: "<<stage.e_dot_star_.transpose()<<std::endl; */      
- 	// DEBUG END ==========================================
-      } else {
-        int rows = it->second.e_dot_star_.rows() + e_dot_star.rows();
-        // DEBUG =============================================
-        /* std::cerr<<std::setprecision(2)<<"HiQPSolver::appendStage - before appending existing stage: "<<std::endl; */
-        /* std::cerr<<"J_t: "<<std::endl<<it->second.J_<<std::endl; */
-        /* std::cerr<<"signs: "; */
-        /* for (unsigned int k=0;k<it->second.constraint_signs_.size();k++) */
-        /*  std::cerr<<it->second.constraint_signs_[k]<<" "; */
-
-        /* std::cerr<<std::endl<<"de*: "<<it->second.e_dot_star_.transpose()<<std::endl;  */
-	// DEBUG END ==========================================
-
-        Eigen::VectorXd edotstar__(rows);
-        edotstar__ << it->second.e_dot_star_, e_dot_star;
-        it->second.e_dot_star_.resize(rows);
-        it->second.e_dot_star_ = edotstar__;
-        Eigen::MatrixXd J__(rows, it->second.J_.cols());
-        J__ << it->second.J_, J;
-        it->second.J_ = J__;
-        it->second.constraint_signs_.insert(it->second.constraint_signs_.end(),
-                                            constraint_signs.begin(),
-                                            constraint_signs.end() );
-        it->second.nRows += e_dot_star.rows();
-        // DEBUG =============================================
-        /* std::cerr<<std::setprecision(2)<<"HiQPSolver::appendStage - after appending existing stage: "<<std::endl; */
-        /* std::cerr<<"J_t: "<<std::endl<<it->second.J_<<std::endl; */
-        /* std::cerr<<"signs: "; */
-        /* for (unsigned int k=0;k<it->second.constraint_signs_.size();k++) */
-        /*  std::cerr<<it->second.constraint_signs_[k]<<" "; */
-
-        /* std::cerr<<std::endl<<"de*: "<<it->second.e_dot_star_.transpose()<<std::endl;  */
-	// DEBUG END ==========================================
+      if (sparse_stages_) {
+        for (int i = 0; i < rows; ++i) {
+          if (column_support.empty()) {
+            for (int j = 0; j < J.cols(); ++j)
+              stage.support_inner_.push_back(j);
+          } else {
+            stage.support_inner_.insert(stage.support_inner_.end(),
+                                        column_support.begin(),
+                                        column_support.end());
+          }
+          stage.support_outer_.push_back(stage.support_inner_.size());
+        }
       }
 
       return 0;
     }
 
+    /*! \brief Completes the stages after all tasks have been appended. Stages
+     *         that got no rows are removed and the storage of the others is
+     *         trimmed to their rows. Nothing is allocated as long as the
+     *         stages have the same sizes as in the last cycle. */
+    int finalizeStages() {
+      if (guaranteed_by_priority_level_) {
+        n_guaranteed_stages_ = 0;
+        for (auto&& kv : stages_map_) {
+          if (kv.first <= guaranteed_priority_level_ && kv.second.nRows > 0)
+            ++n_guaranteed_stages_;
+        }
+      }
+
+      StageMap::iterator it = stages_map_.begin();
+      while (it != stages_map_.end()) {
+        HiQPStage& stage = it->second;
+        if (stage.nRows == 0) {
+          it = stages_map_.erase(it);
+          continue;
+        }
+        if (stage.J_.rows() != stage.nRows) {
+          stage.e_dot_star_.conservativeResize(stage.nRows);
+          stage.J_.conservativeResize(stage.nRows, Eigen::NoChange);
+        }
+        stage.constraint_signs_.resize(stage.nRows);
+
+        if (row_compression_)
+          compressStage(stage, sparse_stages_);
+
+        if (sparse_stages_) {
+          finalizeSparseStage(stage);
+          ++it;
+          continue;
+        }
+
+        // Rows acting on a single variable can be expressed as bounds by the backends
+        stage.bound_cols_.resize(stage.nRows);
+        for (int i = 0; i < stage.nRows; ++i) {
+          int col = -1;
+          for (int j = 0; j < stage.J_.cols(); ++j) {
+            if (stage.J_(i, j) == 0.0)
+              continue;
+            if (col != -1) {
+              col = -1;
+              break;
+            }
+            col = j;
+          }
+          stage.bound_cols_[i] = col;
+        }
+        ++it;
+      }
+      return 0;
+    }
+
+    /// \brief Returns whether the stages are kept in compressed row storage, see setSparseStages()
+    bool getSparseStages() const { return sparse_stages_; }
+
+    /*! \brief Computes the slacks of the rows of a stage with the priority
+     *         level as they were appended, even if they were compressed, i.e.
+     *         the smallest w with J*dq - w (<=,=,>=) de* for each row of each
+     *         task in the order of appendStage().
+     *  \return 0 on success, -1 if there is no stage with the priority level */
+    int getStageSlacks(std::size_t priority_level,
+                       const std::vector<double>& solution,
+                       Eigen::VectorXd& slacks) const;
+
   protected:
     typedef std::map<std::size_t, HiQPStage> StageMap;
     StageMap    stages_map_; 
 
+    /*! \brief Writes the rows of the stage into J_sparse_, whose pattern is
+     *         only rebuilt if the column supports of the rows changed, and
+     *         finds the bound columns among the nonzeros only. */
+    static void finalizeSparseStage(HiQPStage& stage);
+
+    /*! \brief Replaces linearly dependent equality rows of the stage with
+     *         as many rows as their rank, see setRowCompression(). The
+     *         compressed rows come first, followed by the inequality rows.
+     *         If sparse, the compressed rows get the union of the column
+     *         supports of the equality rows. */
+    static void compressStage(HiQPStage& stage, bool sparse);
+
+    /*! \brief If the null space fast path is enabled, solves the leading
+     *         stages that contain only equality rows with a null space
+     *         projection cascade instead of QPs. The highest stage is solved
+     *         exactly with a minimum norm solution, the following stages by
+     *         damped least squares in the null space of the stages above.
+     *         The solution of the stages above is first made orthogonal to
+     *         that null space, so that the damping of each stage acts on the
+     *         norm of the whole solution as in the QP a backend would solve.
+     *  \return the number of leading stages that were solved, the solution
+     *          is written to solution and the slacks of their rows are stacked
+     *          in eq_stage_slacks_. Backends should hand off to their QPs at
+     *          the returned stage. */
+    unsigned int solveEqualityStages(std::vector<double>& solution);
+
+    /*! \brief Returns the rank of a decomposed matrix as the number of its
+     *         pivots that are larger than tol. Eigen's threshold is relative
+     *         to the largest pivot, so a matrix of rounding errors, like the
+     *         rows of a stage projected onto the null space of stages above
+     *         that already fixed them, would count as full rank. The tolerance
+     *         should thus be scaled by the norm of the unprojected rows. */
+    static unsigned int absoluteRank(const Eigen::ColPivHouseholderQR<Eigen::MatrixXd>& qr, double tol) {
+      unsigned int rank = 0;
+      for (int i = 0; i < qr.nonzeroPivots(); ++i) {
+        if (std::abs(qr.matrixQR()(i, i)) > tol)
+          ++rank;
+      }
+      return rank;
+    }
+
+    /*! \brief Tightens the bounds lb <= x <= ub of a variable with the row
+     *         coeff*x (sign) b, where sign is -1, 0 or 1 for <=, = and >=. */
+    static void mergeBound(double coeff, double b, int sign, double& lb, double& ub) {
+      double value = b / coeff;
+      if (coeff < 0) sign = -sign;
+      if (sign >= 0) lb = std::max(lb, value);
+      if (sign <= 0) ub = std::min(ub, value);
+    }
+
+    /// \brief Starts the time keeping of a call to solve(), resets the number of solved stages
+    void startCycle() {
+      cycle_start_ = std::chrono::steady_clock::now();
+      stage_start_ = cycle_start_;
+      n_solved_stages_ = 0;
+      // The durations are kept per priority level, since levels can appear
+      // and disappear between cycles and shift the positions of the stages
+      stage_durations_.clear();
+      for (auto&& kv : stages_map_)
+        stage_durations_.push_back(&level_durations_[kv.first]);
+    }
+
+    /// \brief Returns whether stage stage_nr may be started within the cycle budget
+    bool mayStartStage(unsigned int stage_nr) {
+      stage_start_ = std::chrono::steady_clock::now();
+      if (cycle_budget_ <= 0 || stage_nr < n_guaranteed_stages_)
+        return true;
+      return getElapsedTime() + *stage_durations_.at(stage_nr) <= cycle_budget_;
+    }
+
+    /// \brief Marks stage stage_nr as solved and records how long it took
+    void finishStage(unsigned int stage_nr) {
+      *stage_durations_.at(stage_nr) = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - stage_start_).count();
+      n_solved_stages_ = stage_nr + 1;
+    }
+
+    /// \brief Returns the seconds passed since startCycle()
+    double getElapsedTime() const {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - cycle_start_).count();
+    }
+
+    /// \brief Returns the seconds left of the cycle budget, or a negative number if there is no budget
+    double getRemainingTime() const {
+      if (cycle_budget_ <= 0)
+        return -1;
+      return std::max(0.0, cycle_budget_ - getElapsedTime());
+    }
+
+    /*! \brief Returns the result of solve() when stage stage_nr could not be solved or started: 
+     *         the solution of the stages before it is kept if stage_nr is not a guaranteed stage */
+    bool acceptPartialSolution(unsigned int stage_nr) const {
+      return stage_nr >= n_guaranteed_stages_ && n_solved_stages_ > 0;
+    }
+
+    bool               null_space_fast_path_;
+    Eigen::VectorXd    eq_stage_slacks_; // slacks of the rows solved by solveEqualityStages
+    double             cycle_budget_;
+    unsigned int       n_guaranteed_stages_;
+    unsigned int       n_solved_stages_;
+    WorkerPool*        worker_pool_;
+    bool               sparse_stages_;
+    bool               row_compression_;
+    bool               guaranteed_by_priority_level_;
+    std::size_t        guaranteed_priority_level_;
+
   private:
     HiQPSolver(const HiQPSolver& other) = delete;
     HiQPSolver(HiQPSolver&& other) = delete;
     HiQPSolver& operator=(const HiQPSolver& other) = delete;
     HiQPSolver& operator=(HiQPSolver&& other) noexcept = delete;
+
+    /// \brief Workspace of solveEqualityStages() for one stage, kept between cycles to avoid reallocations
+    struct NullSpaceStage {
+      Eigen::ColPivHouseholderQR<Eigen::MatrixXd>             qr_;
+      Eigen::LLT<Eigen::MatrixXd>                             llt_;
+      unsigned int       rank_; // of A
+      Eigen::MatrixXd    N_;    // basis of the null space of the stages above
+      Eigen::MatrixXd    A_;    // stage jacobian projected onto N
+      Eigen::MatrixXd    Q_;
+      Eigen::MatrixXd    B_;
+      Eigen::MatrixXd    H_;
+      Eigen::VectorXd    r_;
+      Eigen::VectorXd    y_;
+      Eigen::VectorXd    z_;
+      Eigen::VectorXd    z0_;   // component of the solution of the stages above in range(N)
+      Eigen::VectorXd    workspace_;
+    };
+
+    std::vector<NullSpaceStage>    ns_stages_;
+    Eigen::VectorXd                ns_dq_;
+
+    std::chrono::steady_clock::time_point    cycle_start_;
+    std::chrono::steady_clock::time_point    stage_start_;
+    std::map<std::size_t, double>            level_durations_; // of each priority level in the last cycle it was solved
+    std::vector<double*>                     stage_durations_; // into level_durations_ for each stage of the current cycle
   };
 
 } // namespace hiqp
@@ -0,0 +1,82 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef HIQP_KINEMATICS_CACHE_H
+#define HIQP_KINEMATICS_CACHE_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include <kdl/tree.hpp>
+#include <kdl/jntarray.hpp>
+#include <kdl/jacobian.hpp>
+
+#include <hiqp/kinematics_engine.h>
+
+namespace hiqp {
+
+  /*! \brief Caches the poses and jacobians of the frames of a KDL tree for one sampling instant. The first request for a pose after a call to invalidate() computes the poses of all frames in one sweep over the tree, and likewise the first request for a jacobian computes the jacobians of all frames. All later requests until the next invalidate() are served from the cache. The cache counts its hits and misses so that its effectiveness can be monitored. Every thread that samples joints or initializes tasks should have a cache of its own (see TaskManager::setTask() and BatchEvaluator), since a getter waits for a sweep another thread started, which would block the control loop behind e.g. a service thread. The getters and invalidate() may still be called concurrently by the worker threads that update the tasks of one control cycle. They serialize on one mutex, held during the sweeps and while a pose or jacobian is copied out, so a getter never sees a sweep in progress.
+   *  \author Marcus A Johansson */
+  class KinematicsCache {
+  public:
+    KinematicsCache(const KDL::Tree& tree);
+    ~KinematicsCache() noexcept {}
+
+    /// \brief Marks all cached poses and jacobians as outdated, call this every time the joint positions are sampled
+    void invalidate();
+
+    /*! \brief Writes the pose of the frame to pose, the poses are computed from q if they are not cached since the last invalidate()
+     *  \return 0 on success, -1 if q has the wrong size, -2 if there is no such frame */
+    int getFramePose(const KDL::JntArray& q, 
+                     const std::string& frame_id, 
+                     KDL::Frame& pose);
+
+    /*! \brief Writes the jacobian of the frame to jacobian, the jacobians are computed from q if they are not cached since the last invalidate()
+     *  \return 0 on success, -1 if q has the wrong size, -2 if there is no such frame */
+    int getFrameJacobian(const KDL::JntArray& q, 
+                         const std::string& frame_id, 
+                         KDL::Jacobian& jacobian);
+
+    inline unsigned long getNumHits() const { return n_hits_.load(); }
+    inline unsigned long getNumMisses() const { return n_misses_.load(); }
+
+    /// \brief Returns the fraction of requests that were served from the cache since the last resetCounters(), or 0 if there were none
+    double getHitRate() const;
+
+    void resetCounters();
+
+  private:
+    KinematicsCache(const KinematicsCache& other) = delete;
+    KinematicsCache(KinematicsCache&& other) = delete;
+    KinematicsCache& operator=(const KinematicsCache& other) = delete;
+    KinematicsCache& operator=(KinematicsCache&& other) noexcept = delete;
+
+    /// \brief Makes sure the poses, and the jacobians if requested, are computed for q, mutex_ must be held
+    int update(const KDL::JntArray& q, bool jacobians);
+
+    KinematicsEngine             engine_;
+    std::mutex                   mutex_; // guards engine_ and the valid flags
+    bool                         poses_valid_;
+    bool                         jacobians_valid_;
+    std::atomic<unsigned long>   n_hits_;
+    std::atomic<unsigned long>   n_misses_;
+  };
+
+} // namespace hiqp
+
+#endif // include guard
@@ -0,0 +1,80 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef HIQP_KINEMATICS_ENGINE_H
+#define HIQP_KINEMATICS_ENGINE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <kdl/tree.hpp>
+#include <kdl/jntarray.hpp>
+#include <kdl/jacobian.hpp>
+
+#include <Eigen/Dense>
+
+namespace hiqp {
+
+  /*! \brief Computes the poses and jacobians of all segments of a KDL tree. The tree is flattened into an array of segments at construction, ordered such that every segment comes after its parent. updatePoses() then computes all segment poses in a single sweep over the array and updateJacobians() all segment jacobians in a second sweep. Neither of them allocates memory. The jacobians are expressed the same way as by KDL::TreeJntToJacSolver, i.e., in the base frame with the origin of the segment as reference point.
+   *  \author Marcus A Johansson */
+  class KinematicsEngine {
+  public:
+    /// \brief The tree is copied, it does not have to outlive the engine
+    KinematicsEngine(const KDL::Tree& tree);
+    ~KinematicsEngine() noexcept {}
+
+    /// \brief Returns the index of the segment with the name, or -1 if there is no such segment
+    int getSegmentIndex(const std::string& segment_name) const;
+
+    inline unsigned int getNumSegments() const { return parents_.size(); }
+    inline unsigned int getNumJoints() const { return n_joints_; }
+
+    /*! \brief Computes the poses of all segments for the joint positions q
+     *  \return 0 on success, -1 if q has the wrong size */
+    int updatePoses(const KDL::JntArray& q);
+
+    /// \brief Computes the jacobians of all segments, must be called after updatePoses()
+    void updateJacobians();
+
+    /// \brief Writes the pose computed by the last updatePoses() of the segment with the index to pose
+    void getPose(int index, KDL::Frame& pose) const;
+
+    /// \brief Writes the jacobian computed by the last updateJacobians() of the segment with the index to jacobian
+    void getJacobian(int index, KDL::Jacobian& jacobian) const;
+
+  private:
+    KinematicsEngine(const KinematicsEngine& other) = delete;
+    KinematicsEngine(KinematicsEngine&& other) = delete;
+    KinematicsEngine& operator=(const KinematicsEngine& other) = delete;
+    KinematicsEngine& operator=(KinematicsEngine&& other) noexcept = delete;
+
+    unsigned int                  n_joints_;
+    std::map<std::string, int>    indices_;
+    std::vector<KDL::Segment>     segments_;
+    std::vector<int>              parents_; // the root segment is its own parent
+    std::vector<int>              q_nrs_; // -1 for segments with fixed joints
+
+    std::vector<Eigen::Matrix3d>  rotations_; // segment poses in the base frame
+    std::vector<Eigen::Vector3d>  positions_;
+    Eigen::MatrixXd               joint_twists_; // unit joint twists in the base frame at the segment origins
+    Eigen::MatrixXd               jacobians_; // the 6 x n_joints_ jacobians of all segments side by side
+  };
+
+} // namespace hiqp
+
+#endif // include guard
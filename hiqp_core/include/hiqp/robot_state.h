@@ -21,6 +21,7 @@
 #include <kdl/tree.hpp>
 #include <kdl/jntarrayvel.hpp>
 #include <hiqp/hiqp_time_point.h>
+#include <hiqp/kinematics_cache.h>
 
 namespace hiqp {
 
@@ -35,7 +36,7 @@ namespace hiqp {
     bool           writable_;
   };
 
-  /*! \brief Holds the state of the robot (sampling time, kdl tree, joint positions and velocities) 
+  /*! \brief Holds the state of the robot (sampling time, kdl tree, joint positions and velocities) and the kinematics cache of the current sampling instant
    *  \author Marcus A Johansson */
   struct RobotState {
     HiQPTimePoint                 sampling_time_point_;
@@ -45,6 +46,9 @@ namespace hiqp {
     KDL::JntArray                 kdl_effort_;
     std::vector<JointHandleInfo>  joint_handle_info_;
 
+    /// \brief Poses and jacobians of the frames of kdl_tree_, must be invalidated whenever the joint positions are sampled
+    std::shared_ptr<KinematicsCache> kinematics_cache_;
+
     /// \brief Returns whether the joint with qnr is writable or not
     inline bool isQNrWritable(unsigned int qnr) const {
       for (auto&& jhi : joint_handle_info_) {
@@ -0,0 +1,78 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef HIQP_SOLVER_REGISTRY_H
+#define HIQP_SOLVER_REGISTRY_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <hiqp/hiqp_solver.h>
+
+namespace hiqp
+{
+
+  /*! \brief Creates HiQPSolver backends by name. The backends compiled into
+   *         hiqp_core ("activeset", "reduced", and "gurobi" if enabled in the
+   *         build) are registered on first use, along with a
+   *         "decoupled_" variant of each, see DecoupledSolver. Further backends can be
+   *         added with registerSolver(). Any number of backends can be
+   *         created side by side, e.g. to run a second one in the shadow of
+   *         the one that computes the controls.
+   *  \author Marcus A Johansson */
+  class SolverRegistry {
+  public:
+    typedef std::function< std::shared_ptr<HiQPSolver>() > Factory;
+
+    /*! \brief Registers a backend under a name
+     *  \return 0 on success, -1 if a backend with the name is already registered */
+    static int registerSolver(const std::string& name, const Factory& factory);
+
+    /// \brief Returns a new instance of the backend with the name, or an empty pointer if there is no such backend
+    static std::shared_ptr<HiQPSolver> createSolver(const std::string& name);
+
+    /// \brief Returns whether a backend is registered under the name
+    static bool hasSolver(const std::string& name);
+
+    /// \brief Returns the names of all registered backends in alphabetical order
+    static std::vector<std::string> getSolverNames();
+
+    /// \brief Returns the name of the backend used when none is specified, gurobi if it was built and activeset otherwise
+    static std::string getDefaultSolverName();
+
+  private:
+    SolverRegistry() = delete;
+    SolverRegistry(const SolverRegistry& other) = delete;
+    SolverRegistry(SolverRegistry&& other) = delete;
+    SolverRegistry& operator=(const SolverRegistry& other) = delete;
+    SolverRegistry& operator=(SolverRegistry&& other) noexcept = delete;
+
+    typedef std::map<std::string, Factory> FactoryMap;
+
+    /// \brief Returns the factories, the built-in backends are added on the first call
+    static FactoryMap& getFactories();
+
+    static std::mutex& getMutex();
+  };
+
+} // namespace hiqp
+
+#endif // include guard
@@ -0,0 +1,452 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HIQP_ACTIVE_SET_QP_H
+#define HIQP_ACTIVE_SET_QP_H
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include <Eigen/Dense>
+
+namespace hiqp
+{
+
+  /*! \brief A dense dual active-set solver (Goldfarb-Idnani) for the strictly convex QP:
+   *         min 0.5 x'diag(h)x
+   *         s.t. CE'x + ce0 = 0
+   *              CI'x + ci0 >= 0
+   *  The columns of CE and CI are the constraint normals. All storage is
+   *  allocated in reserve() and only grows if a problem exceeds the reserved
+   *  sizes, solve() itself never allocates. Every solve starts from the
+   *  unconstrained minimum, the inequalities that were active in the last
+   *  solution are only preferred when choosing the next violated inequality
+   *  to add (hot-start). That saves iterations when the active set changes
+   *  little from one solve to the next, but the working set is not seeded.
+   *  \author Marcus A Johansson */
+  class ActiveSetQP {
+  public:
+    typedef Eigen::Block<Eigen::MatrixXd> MatrixBlock;
+    typedef Eigen::VectorBlock<Eigen::VectorXd> VectorBlock;
+
+    ActiveSetQP()
+    : n_(0), n_eq_(0), n_in_(0), n_active_(0), n_active_eq_(0),
+      feasibility_tol_(1e-9), max_iterations_(0) {}
+
+    ~ActiveSetQP() noexcept {}
+
+    /// \brief Allocates the storage for problems of up to the given sizes
+    void reserve(unsigned int n_vars, unsigned int n_eq, unsigned int n_in);
+
+    /*! \brief Sets the dimensions of the next problem to solve.
+     *  \return true if the dimensions changed, in that case the hot-start
+     *          information is discarded */
+    bool resize(unsigned int n_vars, unsigned int n_eq, unsigned int n_in);
+
+    /*! \brief Solves the problem currently set through the accessors below.
+     *  \return true if an optimal solution was found, false if the problem is
+     *          infeasible or the iteration limit was reached */
+    bool solve();
+
+    inline VectorBlock hessianDiagonal() { return h_.head(n_); }
+    inline MatrixBlock eqNormals() { return CE_.topLeftCorner(n_, n_eq_); }
+    inline VectorBlock eqOffsets() { return ce0_.head(n_eq_); }
+    inline MatrixBlock inNormals() { return CI_.topLeftCorner(n_, n_in_); }
+    inline VectorBlock inOffsets() { return ci0_.head(n_in_); }
+
+    /// \brief The solution of the last successful call to solve()
+    inline VectorBlock solution() { return x_.head(n_); }
+
+    /// \brief Returns true if inequality i is in the active set of the last solution
+    inline bool isActive(unsigned int i) const { return active_hint_[i] != 0; }
+
+    /// \brief Discards the active set of the last solution
+    inline void resetHotStart() { std::fill(active_hint_.begin(), active_hint_.end(), 0); }
+
+    inline unsigned int getNumVariables() const { return n_; }
+    inline unsigned int getNumEqualities() const { return n_eq_; }
+    inline unsigned int getNumInequalities() const { return n_in_; }
+
+  private:
+    ActiveSetQP(const ActiveSetQP& other) = delete;
+    ActiveSetQP& operator=(const ActiveSetQP& other) = delete;
+
+    /// \brief z = J2*d2, the primal step direction
+    void updateZ();
+    /// \brief r = R^-1*d1, the dual step direction
+    void updateR();
+    bool addConstraint();
+    void deleteConstraint(int constraint);
+    /*! \brief Returns the most violated inequality, -1 if none. The ones that
+     *         were active in the last solution are chosen first. */
+    int selectViolated() const;
+    /// \brief Clears the exclusion of the violated excluded inequalities, returns true if there were any
+    bool includeViolatedExcluded();
+
+    unsigned int                n_;            // number of variables
+    unsigned int                n_eq_;         // number of equality constraints
+    unsigned int                n_in_;         // number of inequality constraints
+    unsigned int                n_active_;     // size of the active set
+    unsigned int                n_active_eq_;  // number of equalities in the active set
+
+    double                      feasibility_tol_;
+    unsigned int                max_iterations_;
+    double                      R_norm_;
+
+    // problem data
+    Eigen::VectorXd             h_;
+    Eigen::MatrixXd             CE_;
+    Eigen::VectorXd             ce0_;
+    Eigen::MatrixXd             CI_;
+    Eigen::VectorXd             ci0_;
+
+    // workspace
+    Eigen::VectorXd             x_;
+    Eigen::MatrixXd             J_;            // J = L^-T*Q, Q from the QR of L^-1*N
+    Eigen::MatrixXd             R_;            // upper triangular factor of the active normals
+    Eigen::VectorXd             d_;
+    Eigen::VectorXd             z_;
+    Eigen::VectorXd             r_;
+    Eigen::VectorXd             u_;            // lagrange multipliers of the active set
+    Eigen::VectorXd             s_;            // slacks of the inequalities
+    std::vector<int>            A_;            // active set, equality i is stored as -i-1
+    std::vector<int>            iai_;          // inactive inequalities, -1 if active
+    std::vector<char>           excluded_;     // inequalities excluded due to degeneracy
+    std::vector<char>           active_hint_;  // active set of the last solution
+  };
+
+  inline void ActiveSetQP::reserve(unsigned int n_vars, unsigned int n_eq, unsigned int n_in) {
+    if (n_vars > static_cast<unsigned int>(x_.size())) {
+      h_.resize(n_vars);
+      x_.resize(n_vars);
+      J_.resize(n_vars, n_vars);
+      R_.resize(n_vars, n_vars);
+      d_.resize(n_vars);
+      z_.resize(n_vars);
+      r_.resize(n_vars + 1);
+      u_.resize(n_vars + 1);
+      A_.resize(n_vars + 1);
+    }
+    if (n_vars > static_cast<unsigned int>(CE_.rows()) || n_eq > static_cast<unsigned int>(CE_.cols())) {
+      CE_.resize(std::max<unsigned int>(n_vars, CE_.rows()), std::max<unsigned int>(n_eq, CE_.cols()));
+      ce0_.resize(CE_.cols());
+    }
+    if (n_vars > static_cast<unsigned int>(CI_.rows()) || n_in > static_cast<unsigned int>(CI_.cols())) {
+      CI_.resize(std::max<unsigned int>(n_vars, CI_.rows()), std::max<unsigned int>(n_in, CI_.cols()));
+      ci0_.resize(CI_.cols());
+      s_.resize(CI_.cols());
+      iai_.resize(CI_.cols());
+      excluded_.resize(CI_.cols());
+      active_hint_.resize(CI_.cols(), 0);
+    }
+  }
+
+  inline bool ActiveSetQP::resize(unsigned int n_vars, unsigned int n_eq, unsigned int n_in) {
+    if (n_vars == n_ && n_eq == n_eq_ && n_in == n_in_)
+      return false;
+
+    reserve(n_vars, n_eq, n_in);
+    n_ = n_vars;
+    n_eq_ = n_eq;
+    n_in_ = n_in;
+    max_iterations_ = 10 * (n_ + n_eq_ + n_in_) + 10;
+    resetHotStart();
+    return true;
+  }
+
+  inline bool ActiveSetQP::solve() {
+    const double inf = std::numeric_limits<double>::infinity();
+    const double eps = std::numeric_limits<double>::epsilon();
+    const unsigned int n = n_;
+
+    // Factorize the diagonal hessian, J = L^-T, and start from the
+    // unconstrained minimum x = 0
+    J_.topLeftCorner(n, n).setZero();
+    for (unsigned int i = 0; i < n; ++i)
+      J_(i, i) = 1.0 / std::sqrt(h_(i));
+    x_.head(n).setZero();
+    n_active_ = 0;
+    R_norm_ = 1.0;
+
+    // Add the equality constraints, rows that are linearly dependent on the
+    // already added ones are skipped if they are consistent with them
+    for (unsigned int i = 0; i < n_eq_; ++i) {
+      d_.head(n).noalias() = J_.topLeftCorner(n, n).transpose() * CE_.col(i).head(n);
+      updateZ();
+      updateR();
+
+      double s = CE_.col(i).head(n).dot(x_.head(n)) + ce0_(i);
+      if (d_.segment(n_active_, n - n_active_).norm() <= 1e-10 * d_.head(n).norm()) {
+        if (std::abs(s) > feasibility_tol_ * (1.0 + std::abs(ce0_(i))))
+          return false;
+        continue;
+      }
+
+      double t2 = -s / z_.head(n).dot(CE_.col(i).head(n));
+      x_.head(n) += t2 * z_.head(n);
+      u_.head(n_active_) -= t2 * r_.head(n_active_);
+      u_(n_active_) = t2;
+      A_[n_active_] = -static_cast<int>(i) - 1;
+      if (!addConstraint())
+        return false;
+    }
+    n_active_eq_ = n_active_;
+
+    for (unsigned int i = 0; i < n_in_; ++i) {
+      iai_[i] = i;
+      excluded_[i] = 0;
+    }
+
+    unsigned int iterations = 0;
+    while (true) {
+      // Step 1: compute the slacks and choose a violated constraint
+      for (unsigned int k = n_active_eq_; k < n_active_; ++k)
+        iai_[A_[k]] = -1;
+
+      s_.head(n_in_).noalias() = CI_.topLeftCorner(n, n_in_).transpose() * x_.head(n);
+      s_.head(n_in_) += ci0_.head(n_in_);
+
+      int ip = selectViolated();
+      if (ip < 0) {
+        // The excluded inequalities held when they were excluded, but the
+        // steps after that may have violated them again. Those are put back
+        // into play, if they keep being excluded the iteration limit ends
+        // the solve
+        if (!includeViolatedExcluded())
+          break;
+        continue;
+      }
+
+      u_(n_active_) = 0.0;
+      A_[n_active_] = ip;
+
+      // Step 2: take steps until the chosen constraint is satisfied
+      while (true) {
+        if (++iterations > max_iterations_)
+          return false;
+
+        d_.head(n).noalias() = J_.topLeftCorner(n, n).transpose() * CI_.col(ip).head(n);
+        updateZ();
+        updateR();
+
+        // partial step length, limited by the multipliers of the active inequalities
+        double t1 = inf;
+        int l = -1;
+        for (unsigned int k = n_active_eq_; k < n_active_; ++k) {
+          if (r_(k) > 0.0 && u_(k) / r_(k) < t1) {
+            t1 = u_(k) / r_(k);
+            l = A_[k];
+          }
+        }
+
+        // full step length
+        double t2 = inf;
+        if (z_.head(n).squaredNorm() > eps)
+          t2 = -s_(ip) / z_.head(n).dot(CI_.col(ip).head(n));
+
+        double t = std::min(t1, t2);
+        if (t >= inf)
+          return false; // the problem is infeasible
+
+        if (t2 >= inf) {
+          // step in the dual space only
+          u_.head(n_active_) -= t * r_.head(n_active_);
+          u_(n_active_) += t;
+          iai_[l] = l;
+          deleteConstraint(l);
+          continue;
+        }
+
+        // step in both the primal and the dual space
+        x_.head(n) += t * z_.head(n);
+        u_.head(n_active_) -= t * r_.head(n_active_);
+        u_(n_active_) += t;
+
+        if (t == t2) {
+          if (addConstraint()) {
+            iai_[ip] = -1;
+          } else {
+            // numerically dependent on the active set, exclude it
+            excluded_[ip] = 1;
+            deleteConstraint(ip);
+          }
+          break;
+        }
+
+        iai_[l] = l;
+        deleteConstraint(l);
+        s_(ip) = CI_.col(ip).head(n).dot(x_.head(n)) + ci0_(ip);
+      }
+    }
+
+    // Remember the active set for the next call
+    resetHotStart();
+    for (unsigned int k = n_active_eq_; k < n_active_; ++k)
+      active_hint_[A_[k]] = 1;
+
+    return true;
+  }
+
+  inline void ActiveSetQP::updateZ() {
+    z_.head(n_).noalias() = J_.block(0, n_active_, n_, n_ - n_active_) * d_.segment(n_active_, n_ - n_active_);
+  }
+
+  inline void ActiveSetQP::updateR() {
+    r_.head(n_active_) = R_.topLeftCorner(n_active_, n_active_).triangularView<Eigen::Upper>().solve(d_.head(n_active_));
+  }
+
+  inline bool ActiveSetQP::addConstraint() {
+    const unsigned int n = n_;
+
+    // Givens rotations zeroing d below the active set
+    for (unsigned int j = n - 1; j >= n_active_ + 1 && j < n; --j) {
+      double cc = d_(j - 1);
+      double ss = d_(j);
+      double h = std::hypot(cc, ss);
+      if (h == 0.0)
+        continue;
+
+      d_(j) = 0.0;
+      ss = ss / h;
+      cc = cc / h;
+      if (cc < 0.0) {
+        cc = -cc;
+        ss = -ss;
+        d_(j - 1) = -h;
+      } else {
+        d_(j - 1) = h;
+      }
+
+      double xny = ss / (1.0 + cc);
+      for (unsigned int k = 0; k < n; ++k) {
+        double t1 = J_(k, j - 1);
+        double t2 = J_(k, j);
+        J_(k, j - 1) = t1 * cc + t2 * ss;
+        J_(k, j) = xny * (t1 + J_(k, j - 1)) - t2;
+      }
+    }
+
+    ++n_active_;
+    R_.col(n_active_ - 1).head(n_active_) = d_.head(n_active_);
+
+    if (std::abs(d_(n_active_ - 1)) <= std::numeric_limits<double>::epsilon() * R_norm_)
+      return false;
+
+    R_norm_ = std::max(R_norm_, std::abs(d_(n_active_ - 1)));
+    return true;
+  }
+
+  inline void ActiveSetQP::deleteConstraint(int constraint) {
+    const unsigned int n = n_;
+
+    unsigned int qq = n_active_eq_;
+    for (unsigned int i = n_active_eq_; i < n_active_; ++i) {
+      if (A_[i] == constraint) {
+        qq = i;
+        break;
+      }
+    }
+
+    // remove the constraint from the active set and the factorization
+    for (unsigned int i = qq; i + 1 < n_active_; ++i) {
+      A_[i] = A_[i + 1];
+      u_(i) = u_(i + 1);
+      R_.col(i).head(n) = R_.col(i + 1).head(n);
+    }
+    A_[n_active_ - 1] = A_[n_active_];
+    u_(n_active_ - 1) = u_(n_active_);
+    A_[n_active_] = 0;
+    u_(n_active_) = 0.0;
+    for (unsigned int j = 0; j < n_active_; ++j)
+      R_(j, n_active_ - 1) = 0.0;
+
+    --n_active_;
+    if (n_active_ == 0)
+      return;
+
+    // restore the triangular form of R with Givens rotations
+    for (unsigned int j = qq; j < n_active_; ++j) {
+      double cc = R_(j, j);
+      double ss = R_(j + 1, j);
+      double h = std::hypot(cc, ss);
+      if (h == 0.0)
+        continue;
+
+      cc = cc / h;
+      ss = ss / h;
+      R_(j + 1, j) = 0.0;
+      if (cc < 0.0) {
+        R_(j, j) = -h;
+        cc = -cc;
+        ss = -ss;
+      } else {
+        R_(j, j) = h;
+      }
+
+      double xny = ss / (1.0 + cc);
+      for (unsigned int k = j + 1; k < n_active_; ++k) {
+        double t1 = R_(j, k);
+        double t2 = R_(j + 1, k);
+        R_(j, k) = t1 * cc + t2 * ss;
+        R_(j + 1, k) = xny * (t1 + R_(j, k)) - t2;
+      }
+      for (unsigned int k = 0; k < n; ++k) {
+        double t1 = J_(k, j);
+        double t2 = J_(k, j + 1);
+        J_(k, j) = t1 * cc + t2 * ss;
+        J_(k, j + 1) = xny * (J_(k, j) + t1) - t2;
+      }
+    }
+  }
+
+  inline bool ActiveSetQP::includeViolatedExcluded() {
+    bool included = false;
+    for (unsigned int i = 0; i < n_in_; ++i) {
+      if (excluded_[i] && s_(i) < -feasibility_tol_ * (1.0 + std::abs(ci0_(i)))) {
+        excluded_[i] = 0;
+        included = true;
+      }
+    }
+    return included;
+  }
+
+  inline int ActiveSetQP::selectViolated() const {
+    int ip = -1, ip_hint = -1;
+    double s_min = 0.0, s_min_hint = 0.0;
+
+    for (unsigned int i = 0; i < n_in_; ++i) {
+      if (iai_[i] == -1 || excluded_[i])
+        continue;
+      if (s_(i) >= -feasibility_tol_ * (1.0 + std::abs(ci0_(i))))
+        continue;
+      if (s_(i) < s_min) {
+        s_min = s_(i);
+        ip = i;
+      }
+      if (active_hint_[i] && s_(i) < s_min_hint) {
+        s_min_hint = s_(i);
+        ip_hint = i;
+      }
+    }
+
+    return (ip_hint >= 0 ? ip_hint : ip);
+  }
+
+} // namespace hiqp
+
+#endif // include guard
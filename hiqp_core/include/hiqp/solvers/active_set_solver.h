@@ -0,0 +1,283 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HIQP_ACTIVE_SET_SOLVER_H
+#define HIQP_ACTIVE_SET_SOLVER_H
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <hiqp/hiqp_solver.h>
+#include <hiqp/solvers/active_set_qp.h>
+
+#include <Eigen/Dense>
+
+namespace hiqp
+{
+
+  /*! \brief A header-only solver for a set of stages based on a dense dual
+   *         active-set method, intended for small problems (up to some 50
+   *         joints and 200 task rows) that need to be solved in microseconds.
+   *         It solves the same cascade of QPs as the GurobiSolver:
+   *         min TIKHONOV_FACTOR*dq^2 + w^2
+   *         where J*dq - w (<=,=,>=) de*, and the rows of the previously
+   *         solved stages are kept with their slacks fixed. The highest stage
+   *         is solved without slack variables. Each stage keeps its own QP
+   *         which is hot-started from the active set of the previous call.
+   *         Rows without slack that act on a single joint are merged into
+   *         one lower and upper bound per joint. The cycle budget of
+   *         HiQPSolver is checked before each stage.
+   *  \author Marcus A Johansson */
+  class ActiveSetSolver : public HiQPSolver {
+  public:
+    ActiveSetSolver()
+    : n_solution_dims_(0), tikhonov_factor_(5*1e-5) {}
+
+    ~ActiveSetSolver() noexcept {}
+
+    /// \brief Preallocates the storage of the stage QPs
+    void init(unsigned int n_solution_dims);
+
+    bool solve(std::vector<double>& solution);
+
+  private:
+    ActiveSetSolver(const ActiveSetSolver& other) = delete;
+    ActiveSetSolver(ActiveSetSolver&& other) = delete;
+    ActiveSetSolver& operator=(const ActiveSetSolver& other) = delete;
+    ActiveSetSolver& operator=(ActiveSetSolver&& other) noexcept = delete;
+
+    /*! \brief Writes the row J.row(row)*dq - w(slack_col) (sign) b as the next
+     *         equality or inequality constraint of qp. No slack is used if
+     *         slack_col is negative. */
+    void setConstraint(ActiveSetQP& qp,
+                       unsigned int& i_eq,
+                       unsigned int& i_in,
+                       const Eigen::MatrixXd& J,
+                       unsigned int row,
+                       int slack_col,
+                       double b,
+                       int sign);
+
+    /// \brief Writes the bound dq(col) (sign) b as the next equality or inequality constraint of qp
+    void setBoundConstraint(ActiveSetQP& qp,
+                            unsigned int& i_eq,
+                            unsigned int& i_in,
+                            unsigned int col,
+                            double b,
+                            int sign);
+
+    unsigned int                                n_solution_dims_;
+    double                                      tikhonov_factor_;
+    Eigen::VectorXd                             w_; // slacks of the stages solved so far
+    Eigen::VectorXd                             lb_; // bounds on dq from rows on single variables
+    Eigen::VectorXd                             ub_;
+    std::vector< std::shared_ptr<ActiveSetQP> > stage_qps_; // persistent QP of each stage
+  };
+
+  inline void ActiveSetSolver::init(unsigned int n_solution_dims) {
+    // Reserve for a few stages with twice as many rows as solution dimensions,
+    // larger problems make the storage grow once when they first appear
+    const unsigned int n_reserved_stages = 4;
+    const unsigned int n_reserved_rows = 2 * n_solution_dims;
+
+    n_solution_dims_ = n_solution_dims;
+    w_.resize(n_reserved_stages * n_reserved_rows);
+    lb_.resize(n_solution_dims);
+    ub_.resize(n_solution_dims);
+    while (stage_qps_.size() < n_reserved_stages) {
+      stage_qps_.push_back(std::make_shared<ActiveSetQP>());
+      stage_qps_.back()->reserve(n_solution_dims + n_reserved_rows,
+                                 n_reserved_stages * n_reserved_rows,
+                                 n_reserved_stages * n_reserved_rows);
+    }
+  }
+
+  inline bool ActiveSetSolver::solve(std::vector<double>& solution) {
+    if (stages_map_.empty())
+      return false;
+
+    n_solution_dims_ = solution.size();
+    const unsigned int n = n_solution_dims_;
+
+    unsigned int n_rows = 0;
+    for (auto&& kv : stages_map_)
+      n_rows += kv.second.nRows;
+    if (w_.size() < n_rows)
+      w_.resize(n_rows);
+    while (stage_qps_.size() < stages_map_.size())
+      stage_qps_.push_back(std::make_shared<ActiveSetQP>());
+
+    startCycle();
+
+    // Leading equality-only stages might already be solved in closed form
+    unsigned int n_eq_stages = solveEqualityStages(solution);
+    n_solved_stages_ = n_eq_stages;
+
+    unsigned int stage_nr = 0;
+    unsigned int acc_rows = 0;
+
+    for (StageMap::const_iterator it = stages_map_.begin(); it != stages_map_.end(); ++it, ++stage_nr) {
+      const HiQPStage& stage = it->second;
+
+      if (stage_nr < n_eq_stages) {
+        w_.segment(acc_rows, stage.nRows) = eq_stage_slacks_.segment(acc_rows, stage.nRows);
+        acc_rows += stage.nRows;
+        continue;
+      }
+
+      if (!mayStartStage(stage_nr))
+        return acceptPartialSolution(stage_nr);
+
+      ActiveSetQP& qp = *stage_qps_.at(stage_nr);
+
+      // The highest stage is solved without slack variables
+      unsigned int n_slacks = (stage_nr == 0 ? 0 : stage.nRows);
+
+      // Hard rows acting on a single variable are merged into bounds on it,
+      // these are the rows of the previous stages and of the highest stage
+      lb_.setConstant(n, -std::numeric_limits<double>::infinity());
+      ub_.setConstant(n, std::numeric_limits<double>::infinity());
+
+      unsigned int n_eq = 0, n_in = 0, row_offset = 0;
+      for (StageMap::const_iterator jt = stages_map_.begin(); jt != std::next(it); ++jt) {
+        const HiQPStage& acc_stage = jt->second;
+        bool hard = (jt != it || n_slacks == 0);
+        for (int i = 0; i < acc_stage.nRows; ++i) {
+          int col = (hard ? acc_stage.bound_cols_.at(i) : -1);
+          if (col >= 0)
+            mergeBound(acc_stage.J_(i, col),
+                       acc_stage.e_dot_star_(i) + (jt != it ? w_(row_offset + i) : 0.0),
+                       acc_stage.constraint_signs_.at(i), lb_(col), ub_(col));
+          else if (acc_stage.constraint_signs_.at(i) == 0)
+            ++n_eq;
+          else
+            ++n_in;
+        }
+        row_offset += acc_stage.nRows;
+      }
+      for (unsigned int j = 0; j < n; ++j) {
+        if (lb_(j) == ub_(j)) {
+          ++n_eq;
+        } else {
+          if (std::isfinite(lb_(j))) ++n_in;
+          if (std::isfinite(ub_(j))) ++n_in;
+        }
+      }
+      qp.resize(n + n_slacks, n_eq, n_in);
+
+      qp.hessianDiagonal().head(n).setConstant(tikhonov_factor_);
+      qp.hessianDiagonal().tail(n_slacks).setConstant(1.0);
+
+      unsigned int i_eq = 0, i_in = 0;
+      row_offset = 0;
+      for (StageMap::const_iterator jt = stages_map_.begin(); jt != it; ++jt) {
+        const HiQPStage& prev_stage = jt->second;
+        for (int i = 0; i < prev_stage.nRows; ++i) {
+          if (prev_stage.bound_cols_.at(i) < 0)
+            setConstraint(qp, i_eq, i_in, prev_stage.J_, i, -1,
+                          prev_stage.e_dot_star_(i) + w_(row_offset + i),
+                          prev_stage.constraint_signs_.at(i));
+        }
+        row_offset += prev_stage.nRows;
+      }
+
+      for (int i = 0; i < stage.nRows; ++i) {
+        if (n_slacks == 0 && stage.bound_cols_.at(i) >= 0)
+          continue;
+        setConstraint(qp, i_eq, i_in, stage.J_, i,
+                      (n_slacks > 0 ? n + i : -1),
+                      stage.e_dot_star_(i),
+                      stage.constraint_signs_.at(i));
+      }
+
+      for (unsigned int j = 0; j < n; ++j) {
+        if (lb_(j) == ub_(j)) {
+          setBoundConstraint(qp, i_eq, i_in, j, lb_(j), 0);
+        } else {
+          if (std::isfinite(lb_(j))) setBoundConstraint(qp, i_eq, i_in, j, lb_(j), 1);
+          if (std::isfinite(ub_(j))) setBoundConstraint(qp, i_eq, i_in, j, ub_(j), -1);
+        }
+      }
+
+      if (!qp.solve())
+        return acceptPartialSolution(stage_nr);
+
+      for (unsigned int i = 0; i < n; ++i)
+        solution.at(i) = qp.solution()(i);
+
+      for (int i = 0; i < stage.nRows; ++i)
+        w_(acc_rows + i) = (n_slacks > 0 ? qp.solution()(n + i) : 0.0);
+
+      acc_rows += stage.nRows;
+      finishStage(stage_nr);
+    }
+
+    return true;
+  }
+
+  inline void ActiveSetSolver::setConstraint(ActiveSetQP& qp,
+                                             unsigned int& i_eq,
+                                             unsigned int& i_in,
+                                             const Eigen::MatrixXd& J,
+                                             unsigned int row,
+                                             int slack_col,
+                                             double b,
+                                             int sign) {
+    const unsigned int n = n_solution_dims_;
+    const unsigned int n_vars = qp.getNumVariables();
+
+    // J*dq - w = b      ->  [J -1]*x - b = 0
+    // J*dq - w >= b     ->  [J -1]*x - b >= 0
+    // J*dq - w <= b     -> -[J -1]*x + b >= 0
+    ActiveSetQP::MatrixBlock normals = (sign == 0 ? qp.eqNormals() : qp.inNormals());
+    unsigned int col = (sign == 0 ? i_eq++ : i_in++);
+    double factor = (sign < 0 ? -1.0 : 1.0);
+
+    normals.col(col).head(n) = factor * J.row(row).transpose();
+    normals.col(col).tail(n_vars - n).setZero();
+    if (slack_col >= 0)
+      normals(slack_col, col) = -factor;
+
+    if (sign == 0)
+      qp.eqOffsets()(col) = -b;
+    else
+      qp.inOffsets()(col) = -factor * b;
+  }
+
+  inline void ActiveSetSolver::setBoundConstraint(ActiveSetQP& qp,
+                                                  unsigned int& i_eq,
+                                                  unsigned int& i_in,
+                                                  unsigned int col,
+                                                  double b,
+                                                  int sign) {
+    ActiveSetQP::MatrixBlock normals = (sign == 0 ? qp.eqNormals() : qp.inNormals());
+    unsigned int k = (sign == 0 ? i_eq++ : i_in++);
+    double factor = (sign < 0 ? -1.0 : 1.0);
+
+    normals.col(k).setZero();
+    normals(col, k) = factor;
+
+    if (sign == 0)
+      qp.eqOffsets()(k) = -b;
+    else
+      qp.inOffsets()(k) = -factor * b;
+  }
+
+} // namespace hiqp
+
+#endif // include guard
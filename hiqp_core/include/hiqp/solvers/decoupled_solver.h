@@ -0,0 +1,112 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef HIQP_DECOUPLED_SOLVER_H
+#define HIQP_DECOUPLED_SOLVER_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <hiqp/hiqp_solver.h>
+#include <hiqp/worker_pool.h>
+
+#include <Eigen/Dense>
+
+namespace hiqp
+{
+
+  /*! \brief A solver that splits the stages into independent sub-problems
+   *         and solves them concurrently with instances of another backend.
+   *         Two joints are coupled if a row of any stage acts on both of them
+   *         (has nonzeros in both columns of J), the connected components of
+   *         the joints are found with a union-find over the rows. Every
+   *         component is solved as its own cascade of stages on the worker
+   *         pool, and the solutions are scattered back into the controls.
+   *         Since the QPs of the cascade are separable over the components
+   *         this gives the same solution as solving all joints together.
+   *         Components with no rows in the highest stage are merged into one
+   *         that has such rows, so that every sub-problem keeps the highest
+   *         stage as its slack-free stage. Joints no row acts on are set to
+   *         zero. The components are only recomputed when the number of
+   *         stages or rows changes, or a row acts on joints of different
+   *         components. The cycle budget holds for the whole solve(): each
+   *         component gets what is left of it when it starts, so components
+   *         solved one after another without a worker pool share it.
+   *  \author Marcus A Johansson */
+  class DecoupledSolver : public HiQPSolver {
+  public:
+    typedef std::function< std::shared_ptr<HiQPSolver>() > SolverFactory;
+
+    /// \param factory : creates the backend instances that solve the components
+    DecoupledSolver(const SolverFactory& factory);
+    ~DecoupledSolver() noexcept {}
+
+    void init(unsigned int n_solution_dims);
+
+    bool solve(std::vector<double>& solution);
+
+    /// \brief Returns the number of components the last solve() was split into
+    inline unsigned int getNumComponents() const { return n_components_; }
+
+  private:
+    DecoupledSolver(const DecoupledSolver& other) = delete;
+    DecoupledSolver(DecoupledSolver&& other) = delete;
+    DecoupledSolver& operator=(const DecoupledSolver& other) = delete;
+    DecoupledSolver& operator=(DecoupledSolver&& other) noexcept = delete;
+
+    /// \brief The joints of a component and its part of the rows of every stage
+    struct Component {
+      std::shared_ptr<HiQPSolver>          solver_;
+      std::vector<int>                     cols_; // the joints of the component
+      std::vector<unsigned int>            stage_nrs_; // the stages the component has rows in
+      std::vector< std::vector<int> >      rows_; // of each of stage_nrs_
+      std::vector<Eigen::VectorXd>         e_dot_star_; // of each of stage_nrs_
+      std::vector<Eigen::MatrixXd>         J_;
+      std::vector< std::vector<int> >      constraint_signs_;
+      std::vector<double>                  solution_;
+      int                                  solved_;
+    };
+
+    /// \brief Returns whether the rows of the stages still fit the current components
+    bool componentsValid(unsigned int n_solution_dims) const;
+
+    /// \brief Recomputes the components from the nonzeros of the stage jacobians
+    void computeComponents(unsigned int n_solution_dims);
+
+    /// \brief Gathers the rows of component i into its solver and solves them
+    void solveComponent(unsigned int i);
+
+    int findRoot(int col);
+
+    SolverFactory                      factory_;
+    WorkerPool::Job                    solve_job_; // calls solveComponent()
+    unsigned int                       n_solution_dims_;
+    unsigned int                       n_components_;
+    std::vector<Component>             components_; // the first n_components_ are in use
+
+    std::vector<const HiQPStage*>      stages_; // of the current cycle in priority order
+    std::vector<std::size_t>           priorities_;
+    std::vector<int>                   stage_rows_; // number of rows of each stage when the components were computed
+    std::vector< std::vector<int> >    row_components_; // component of each row of each stage
+    std::vector<int>                   col_components_; // component of each joint, -1 if no row acts on it
+    std::vector<int>                   uf_parents_; // union-find forest over the joints
+  };
+
+} // namespace hiqp
+
+#endif // include guard
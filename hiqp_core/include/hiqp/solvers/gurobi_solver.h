@@ -20,6 +20,9 @@
 #include <hiqp/hiqp_solver.h>
 #include <gurobi_c++.h>
 
+#include <memory>
+#include <vector>
+
 namespace hiqp
 {
   /*! \brief An optimization based solver for a set of stages based on Gurobi.
@@ -32,6 +35,15 @@ namespace hiqp
     /*! \brief Builds and solves the QP:
      *         min 0.5x^2 + 0.5w^2
      *         where J*dq + w = de*
+     *
+     *  With HiQPSolver::setSparseStages() only the nonzeros of the column
+     *  supports of the tasks are added to the models.
+     *
+     *  The Gurobi model of each stage is kept alive between calls. As long as
+     *  the stage layout is unchanged only the constraint coefficients, the
+     *  right-hand-sides and the constraint senses are pushed to the model,
+     *  and the optimization is warm-started from the solution and basis of
+     *  the previous call. A changed layout results in a cold start.
      */
     bool solve(std::vector<double>& solution);
 
@@ -44,15 +56,22 @@ namespace hiqp
     struct HQPConstraints {
       HQPConstraints() : n_acc_stage_dims_(0) {}
 
-      void reset(unsigned int n_solution_dims);
-      void appendConstraints(const HiQPStage& current_stage);
-
-      unsigned int       n_acc_stage_dims_; // number of accumulated dimensions of all the previously solved stages
-      unsigned int       n_stage_dims_; // number of dimensions of the current stage
-      Eigen::VectorXd    w_;
-      Eigen::VectorXd    de_;
-      Eigen::MatrixXd    J_;
-      std::vector<char>  constraint_signs_;
+      /// \brief Prepares the storage for n_rows constraints on n_solution_dims variables, it only grows if the sizes did
+      void reset(unsigned int n_solution_dims, unsigned int n_rows);
+      /// \brief Appends the rows of the stage, only the nonzeros of HiQPStage::J_sparse_ if sparse is set
+      void appendConstraints(const HiQPStage& current_stage, bool sparse);
+      /// \brief Returns the coefficient of column col in row i
+      double getCoeff(unsigned int i, int col) const;
+
+      unsigned int         n_acc_stage_dims_; // number of accumulated dimensions of all the previously solved stages
+      unsigned int         n_stage_dims_; // number of dimensions of the current stage
+      Eigen::VectorXd      w_;
+      Eigen::VectorXd      de_;
+      std::vector<int>     J_outer_; // the jacobians of the rows in compressed row storage
+      std::vector<int>     J_inner_;
+      std::vector<double>  J_values_;
+      std::vector<char>    constraint_signs_;
+      std::vector<int>     bound_cols_; // see HiQPStage::bound_cols_
     };
 
     struct QPProblem {
@@ -62,13 +81,34 @@ namespace hiqp
 
       ~QPProblem();
 
+      /// \brief Returns true if the model was built for the current layout of hqp_constraints_
+      bool fits(unsigned int solution_dims) const;
+
+      /*! \brief Returns the column of dq if row i is a hard row acting on a
+       *         single variable, such rows are added as bounds on dq instead
+       *         of constraints. Returns -1 otherwise. */
+      int getBoundCol(unsigned int i) const;
+
+      /// \brief Gathers the right-hand-sides and senses of the constraints and the bounds on dq
+      void gatherRowData();
+
       void setup();
-      void solve();
+      void update();
+      /*! \brief Solves the model within time_limit seconds
+       *  \return true if an optimal solution was found */
+      bool solve(double time_limit);
       void getSolution(std::vector<double>& solution);
 
+      /// \brief Seeds the model with the solution and basis of the previous call
+      void setWarmStart();
+      /// \brief Stores the solution and basis of the last optimization for the next call
+      void storeWarmStart();
+
       GRBModel               model_;       // Gurobi model (one per each QP problem is used)
       HQPConstraints&        hqp_constraints_;
       unsigned int           solution_dims_;
+      unsigned int           acc_stage_dims_; // layout the model was built for
+      unsigned int           stage_dims_;
 
       GRBVar*                dq_;          // objective variables for joint velocities
       double*                lb_dq_;       // lower bounds for dq
@@ -84,11 +124,30 @@ namespace hiqp
       double*                coeff_w_;     // Coeffs of w in LHS expression
 
       GRBConstr*             constraints_; //
+      unsigned int           n_constrs_;   // number of rows added as constraints
+      unsigned int*          constr_rows_; // row in hqp_constraints_ of each constraint
+      int*                   bound_cols_;  // bound column of each row when the model was built
+      char*                  senses_;      // senses of the constraints
+
+      std::vector<int>       J_outer_;     // pattern of the rows the model was built for
+      std::vector<int>       J_inner_;
+      unsigned int           n_coeffs_;    // number of dq coefficients in the constraints
+      GRBConstr*             coeff_constrs_; // row of each dq coefficient, used with chgCoeffs
+      GRBVar*                coeff_vars_;    // column of each dq coefficient, used with chgCoeffs
+      double*                coeff_vals_;    // values of the dq coefficients in the order of the constraints
+
+      bool                   warm_start_available_;
+      double*                start_dq_;    // primal start values for dq
+      double*                start_w_;     // primal start values for w
+      int*                   vbasis_dq_;   // basis status of dq
+      int*                   vbasis_w_;    // basis status of w
+      int*                   cbasis_;      // basis status of the constraints
     };
 
     GRBEnv             env_;
     unsigned int       n_solution_dims_; // number of solution dimensions
     HQPConstraints     hqp_constraints_;
+    std::vector< std::shared_ptr<QPProblem> > qp_problems_; // persistent model of each stage
   };
 
 } // namespace hiqp
@@ -0,0 +1,118 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef HIQP_REDUCED_SPACE_SOLVER_H
+#define HIQP_REDUCED_SPACE_SOLVER_H
+
+#include <memory>
+#include <vector>
+
+#include <hiqp/hiqp_solver.h>
+#include <hiqp/solvers/active_set_qp.h>
+
+#include <Eigen/Dense>
+
+namespace hiqp
+{
+
+  /*! \brief A solver for a set of stages that shrinks the problem with every
+   *         priority level instead of growing it. It solves the same cascade
+   *         of QPs as the ActiveSetSolver, but once a stage is solved its
+   *         equality rows (with their slacks fixed) are removed from the
+   *         problem by restricting dq to the null space of those rows:
+   *         dq = dq0 + N*z, where the columns of N are an orthonormal basis of
+   *         the null space of the equality rows of all stages solved so far.
+   *         The following stages are solved in the reduced variables z, which
+   *         are fewer with every level that has equality rows, and only the
+   *         inequality rows of the previous stages are carried down. Since dq0
+   *         is kept orthogonal to N, the regularization TIKHONOV_FACTOR*dq^2
+   *         stays diagonal in z, and the solution equals the one of the full
+   *         cascade. The leading equality-only stages are reduced this way
+   *         anyway, so the null space fast path of HiQPSolver is not used.
+   *  \author Marcus A Johansson */
+  class ReducedSpaceSolver : public HiQPSolver {
+  public:
+    ReducedSpaceSolver();
+    ~ReducedSpaceSolver() noexcept {}
+
+    /// \brief Preallocates the null space basis and the storage of the stage QPs
+    void init(unsigned int n_solution_dims);
+
+    bool solve(std::vector<double>& solution);
+
+    /// \brief Returns the number of variables the lowest stage of the last solve() was solved in
+    inline unsigned int getNumReducedVariables() const { return n_reduced_vars_; }
+
+  private:
+    ReducedSpaceSolver(const ReducedSpaceSolver& other) = delete;
+    ReducedSpaceSolver(ReducedSpaceSolver&& other) = delete;
+    ReducedSpaceSolver& operator=(const ReducedSpaceSolver& other) = delete;
+    ReducedSpaceSolver& operator=(ReducedSpaceSolver&& other) noexcept = delete;
+
+    /// \brief Workspace of one stage, kept between cycles to avoid reallocations
+    struct ReducedStage {
+      std::shared_ptr<ActiveSetQP>   qp_; // hot-started from the active set of the previous cycle
+      Eigen::MatrixXd    N_;      // basis of the null space of the equality rows of the stages above
+      Eigen::VectorXd    z0_;
+      Eigen::VectorXd    dq0_;    // the solution of the stages above projected out of the range of N
+      Eigen::MatrixXd    A_;      // stage jacobian times N
+      Eigen::MatrixXd    held_A_; // jacobian of the held rows times N
+      Eigen::MatrixXd    M_;      // equality rows of A
+      Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr_;
+      Eigen::MatrixXd    Q_;
+      Eigen::VectorXd    workspace_;
+    };
+
+    /*! \brief Solves stage stage_nr in the reduced variables of the stage
+     *  \return false if the QP of the stage could not be solved */
+    bool solveStage(const HiQPStage& stage, unsigned int stage_nr);
+
+    /// \brief Sets the slacks of a stage in which dq cannot move anymore
+    void solveFixedStage(const HiQPStage& stage);
+
+    /*! \brief Carries the inequality rows of stage stage_nr down to the
+     *         following stages and restricts the null space of the next stage
+     *         to the one of the equality rows of this stage */
+    void reduceStage(const HiQPStage& stage, unsigned int stage_nr, bool last_stage);
+
+    /// \brief Writes the row A.row(row)*z - w(slack_col) (sign) b as the next equality or inequality constraint of qp, no slack is used if slack_col is negative
+    static void setConstraint(ActiveSetQP& qp,
+                              unsigned int& i_eq,
+                              unsigned int& i_in,
+                              const Eigen::MatrixXd& A,
+                              unsigned int row,
+                              int slack_col,
+                              double b,
+                              int sign);
+
+    double                                      tikhonov_factor_;
+    unsigned int                                n_reduced_vars_;
+    Eigen::VectorXd                             dq_; // solution of the stages solved so far
+    Eigen::VectorXd                             w_; // slacks of the current stage
+
+    Eigen::MatrixXd                             held_J_; // inequality rows of the stages solved so far
+    Eigen::VectorXd                             held_b_; // with their slacks added
+    std::vector<int>                            held_signs_;
+    unsigned int                                n_held_;
+    std::vector<int>                            held_rows_; // the held rows dq can still move along in the current stage
+
+    std::vector<ReducedStage>                   reduced_stages_;
+  };
+
+} // namespace hiqp
+
+#endif // include guard
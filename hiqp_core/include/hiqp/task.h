@@ -55,6 +55,10 @@ namespace hiqp {
     inline bool         getVisible()                       { return visible_; }
     inline void         setMonitored(bool monitored)       { monitored_ = monitored; }
     inline bool         getMonitored()                     { return monitored_; }
+    /// \brief Returns the parameters the task was initialized with, see init()
+    inline const std::vector<std::string>& getDefParams() const { return def_params_; }
+    inline const std::vector<std::string>& getDynParams() const { return dyn_params_; }
+
     inline unsigned int getDimensions()                    { if (def_) return def_->getDimensions(); else return 0; }
 
     /*! \brief Recomputes the task performance value, jacobian and its dynamics. */
@@ -63,24 +67,31 @@ namespace hiqp {
     void monitor() {if (def_) def_->monitor(); if (dyn_) dyn_->monitor();}
 
     /*! \brief Returns the task function performance values as a vector. */
-    Eigen::VectorXd getValue() const      
-      { if (def_) return def_->e_; else return Eigen::VectorXd(); }
+    inline const Eigen::VectorXd& getValue() const      
+      { static const Eigen::VectorXd empty; if (def_) return def_->e_; else return empty; }
 
     /*! \brief Returns the task jacobian as a matrix. */
-    Eigen::MatrixXd getJacobian() const   
-      { if (def_) return def_->J_; else return Eigen::MatrixXd(); }
+    inline const Eigen::MatrixXd& getJacobian() const   
+      { static const Eigen::MatrixXd empty; if (def_) return def_->J_; else return empty; }
 
     /*! \brief Returns the task dynamics as a vector. */
-    Eigen::VectorXd getDynamics() const   
-      { if (dyn_) return dyn_->e_dot_star_; else return Eigen::VectorXd(); }
+    inline const Eigen::VectorXd& getDynamics() const   
+      { static const Eigen::VectorXd empty; if (dyn_) return dyn_->e_dot_star_; else return empty; }
+
+    /*! \brief Returns the sorted columns the task jacobian can have nonzeros in, an empty vector if it can have nonzeros in any column. */
+    inline const std::vector<int>& getColumnSupport() const
+      { static const std::vector<int> empty; if (def_) return def_->column_support_; else return empty; }
+    /// \brief See TaskDefinition::getActivationPrimitives()
+    inline bool getActivationPrimitives(GeometricPrimitive*& first, GeometricPrimitive*& second)
+      { if (def_) return def_->getActivationPrimitives(first, second); else return false; }
 
     /*! \brief Returns the task types (leq/eq/geq task) for each dimension of the task space. Returns a vector or -1, 0 or 1 for leq, eq and geq tasks respectively. */
-    std::vector<int> getTaskTypes() const  
-      { if (def_) return def_->task_types_; else return std::vector<int>(); }
+    inline const std::vector<int>& getTaskTypes() const  
+      { static const std::vector<int> empty; if (def_) return def_->task_types_; else return empty; }
 
     /*! \brief Returns the user-defined custom performance measures defined in the monitor() member function in a child class of TaskDefinition. */
-    Eigen::VectorXd getPerformanceMeasures() const 
-      { if (def_) return def_->performance_measures_; else return Eigen::VectorXd(); }
+    inline const Eigen::VectorXd& getPerformanceMeasures() const 
+      { static const Eigen::VectorXd empty; if (def_) return def_->performance_measures_; else return empty; }
 
   private:
     Task(const Task& other) = delete;
@@ -101,6 +112,8 @@ namespace hiqp {
     std::shared_ptr<Visualizer>              visualizer_;
 
     unsigned int                             n_controls_;
+    std::vector<std::string>                 def_params_;
+    std::vector<std::string>                 dyn_params_;
     std::string                              task_name_;
     unsigned int                             priority_;
     bool                                     active_;
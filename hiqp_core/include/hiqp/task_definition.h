@@ -17,6 +17,7 @@
 #ifndef HIQP_TASK_DEFINITION_H
 #define HIQP_TASK_DEFINITION_H
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <memory>
@@ -24,6 +25,7 @@
 #include <hiqp/geometric_primitives/geometric_primitive_map.h>
 #include <hiqp/visualizer.h>
 #include <hiqp/robot_state.h>
+#include <hiqp/utilities.h>
 
 #include <Eigen/Dense>
 
@@ -31,6 +33,7 @@ namespace hiqp
 {
 
   using geometric_primitives::GeometricPrimitiveMap;
+  using geometric_primitives::GeometricPrimitive;
 
   class Task;
 
@@ -59,12 +62,36 @@ namespace hiqp
     virtual Eigen::VectorXd getFinalValue(RobotStatePtr robot_state)
       { return Eigen::VectorXd::Zero(e_.rows()); }
 
+    /*! \brief Returns the two primitives of a task that only keeps them apart, whose rows may be dropped while the primitives are far from each other, see TaskManager::setActivationMargin()
+     *  \return false if the task has no such primitives (default) */
+    virtual bool getActivationPrimitives(GeometricPrimitive*& first, GeometricPrimitive*& second)
+      { return false; }
+
   protected:
     Eigen::VectorXd                 e_; // the performance value of the task
     Eigen::MatrixXd                 J_; // the task jacobian
     std::vector<int>                task_types_; // -1 leq, 0 eq, 1 geq
     Eigen::VectorXd                 performance_measures_;
     unsigned int                    n_dimensions_;
+    std::vector<int>                column_support_; // sorted columns J_ can have nonzeros in, empty if any
+
+    /*! \brief Sets column_support_ to the joints between the root and the
+     *         links, which are the only columns frame jacobians of the links
+     *         can have nonzeros in. The support is left empty if a link is
+     *         not found. */
+    void setColumnSupportFromLinks(const KDL::Tree& kdl_tree,
+                                   const std::vector<std::string>& link_names) {
+      column_support_.clear();
+      for (auto&& link_name : link_names) {
+        if (kdl_getAncestorQNrs(kdl_tree, link_name, column_support_) != 0) {
+          column_support_.clear();
+          return;
+        }
+      }
+      std::sort(column_support_.begin(), column_support_.end());
+      column_support_.erase(std::unique(column_support_.begin(), column_support_.end()),
+                            column_support_.end());
+    }
 
     inline std::string  getTaskName()                      { return task_name_; }
     inline unsigned int getPriority()                      { return priority_; }
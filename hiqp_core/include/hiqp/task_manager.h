@@ -17,6 +17,7 @@
 #ifndef HIQP_TASK_MANAGER_H
 #define HIQP_TASK_MANAGER_H
 
+#include <atomic>
 #include <vector>
 #include <memory>
 #include <mutex>
@@ -25,6 +26,8 @@
 #include <hiqp/visualizer.h>
 #include <hiqp/hiqp_solver.h>
 #include <hiqp/robot_state.h>
+#include <hiqp/worker_pool.h>
+#include <hiqp/broad_phase.h>
 #include <hiqp/geometric_primitives/geometric_primitive_map.h>
 #include <kdl/tree.hpp>
 #include <kdl/jntarrayvel.hpp>
@@ -47,24 +50,87 @@ namespace hiqp {
     Eigen::VectorXd     pm_;
   };
 
-  /*! \brief The central mediator class in the HiQP framework.
+  /*! \brief The central mediator class in the HiQP framework. The control loop (getVelocityControls(), getTaskMeasures() and renderPrimitives()) never waits for the service calls that add, change or remove tasks. These build and initialize the tasks under resource_mutex_ and then publish the resulting set of tasks as an immutable snapshot through an atomic pointer. Replaced snapshots are deleted by later service calls once the control loop has passed them. Primitive parameters published from other threads (GeometricPrimitiveMap::publishGeometricPrimitive()) are applied at the start of getVelocityControls(). Tasks that keep primitives apart can be left out of the stages while the primitives are far from each other, see setActivationMargin().
    *  \author Marcus A Johansson */  
   class TaskManager {
   public:
     TaskManager(std::shared_ptr<Visualizer> visualizer);
     ~TaskManager() noexcept;
 
-    void init(unsigned int n_controls);
+    /*! \brief Sets the number of controls and creates the solver backend
+     *  \param solver_name : the name of the backend in the SolverRegistry, the default backend is used if empty
+     *  \return 0 on success, -1 if there is no backend with the name, in which case the default backend is used */
+    int init(unsigned int n_controls, const std::string& solver_name = "");
 
-    /*! \brief Generates controls from a particular robot state. */
+    /// \brief Returns the name of the solver backend in the SolverRegistry
+    inline const std::string& getSolverName() const { return solver_name_; }
+
+    inline unsigned int getNumControls() const { return n_controls_; }
+
+    /*! \brief Sets a second backend that solves the same stages as the solver
+     *         in every cycle without its solution being used, for comparing
+     *         the backends on the same workload, see getSolverComparison().
+     *         Must be called after init().
+     *  \param solver_name : the name of the backend in the SolverRegistry, an empty name removes the shadow solver
+     *  \return 0 on success, -1 if there is no backend with the name */
+    int setShadowSolver(const std::string& solver_name);
+
+    /// \brief Enables solving leading equality-only stages in closed form, see HiQPSolver::setNullSpaceFastPath()
+    void setNullSpaceFastPath(bool enabled);
+
+    /// \brief Enables passing the stages to the solver in compressed row storage, see HiQPSolver::setSparseStages()
+    void setSparseStages(bool enabled);
+
+    /// \brief Enables compressing linearly dependent equality rows of the stages, see HiQPSolver::setRowCompression()
+    void setRowCompression(bool enabled);
+
+    /*! \brief Limits the time spent solving each cycle, see HiQPSolver::setCycleBudget(). The guaranteed stages are the n_guaranteed_stages highest priority levels of the active tasks, also in cycles where setActivationMargin() drops all rows of one of these levels. */
+    void setCycleBudget(double budget, unsigned int n_guaranteed_stages);
+
+    /// \brief Applies the settings above to another solver, e.g. to solve the same stages as the control loop elsewhere
+    void configureSolver(HiQPSolver& solver) const;
+
+    /*! \brief Drops the rows of the active tasks that keep two primitives apart (see TaskDefinition::getActivationPrimitives()) while the bounds of the primitives are further apart than margin, see BroadPhase
+     *  \param margin : in meters, a negative margin evaluates all active tasks (default) */
+    inline void setActivationMargin(double margin) { activation_margin_ = margin; }
+
+    /// \brief Returns the number of active tasks whose rows were dropped in the last cycle, see setActivationMargin()
+    inline unsigned int getNumDroppedTasks() const { return n_dropped_tasks_; }
+
+    /// \brief Returns the number of priority levels satisfied by the last controls, and the total number of levels in stages
+    inline unsigned int getNumSolvedStages(unsigned int& n_stages) const 
+      { n_stages = solver_->getNumStages(); return solver_->getNumSolvedStages(); }
+
+    /*! \brief The last cycle of the solver compared with the shadow solver, see setShadowSolver().
+     *  \author Marcus A Johansson */
+    struct SolverComparison {
+      SolverComparison() : solve_time_(0), shadow_solve_time_(0), max_deviation_(0), shadow_solved_(false) {}
+      double    solve_time_; // seconds spent in the solve() of the solver
+      double    shadow_solve_time_; // seconds spent in the solve() of the shadow solver
+      double    max_deviation_; // largest absolute difference of the controls of the two
+      bool      shadow_solved_;
+    };
+
+    /// \brief Returns the comparison of the last cycle, must be called from the control loop thread
+    inline const SolverComparison& getSolverComparison() const { return solver_comparison_; }
+
+    /// \brief Returns whether a shadow solver is set
+    inline bool hasShadowSolver() const { return shadow_solver_ != nullptr; }
+
+    /*! \brief Sets the number of threads that update the tasks (and solve the components of a DecoupledSolver) in parallel with the calling thread, zero works serially (default)
+     *  \param pin_threads : pins each thread to its own cpu core, see WorkerPool::setNumThreads() */
+    void setNumWorkerThreads(unsigned int n_threads, bool pin_threads);
+
+    /*! \brief Generates controls from a particular robot state. Must be called from the control loop thread. */
     bool getVelocityControls(RobotStatePtr robot_state,
                              std::vector<double> &controls);
 
     /*! \brief Retrieves the performance measures for every active task along
-     *         with the task's name and unique identifier. */
+     *         with the task's name and unique identifier. Must be called from
+     *         the control loop thread. */
     void getTaskMeasures(std::vector<TaskMeasure>& data);
 
-    /// \brief Redraws all primitives using the currently set visualizer
+    /// \brief Redraws all primitives using the currently set visualizer, skipped if a service call is modifying the primitives
     void renderPrimitives();
 
     /// \brief Returns a shared pointer to the common geometric primitive map object
@@ -83,6 +149,28 @@ namespace hiqp {
                 const std::vector<std::string>& def_params,
                 const std::vector<std::string>& dyn_params,
                 RobotStatePtr robot_state);
+    /*! \brief Locks the tasks and primitives against the service calls,
+     *         which wait, and against the published primitive parameters,
+     *         which the control loop applies in a later cycle instead. Used
+     *         to read the primitives from other threads, see BatchEvaluator. */
+    inline void lockResources() { resource_mutex_.lock(); }
+
+    inline void unlockResources() { resource_mutex_.unlock(); }
+
+    /*! \brief Creates new instances of the active tasks, initialized with
+     *         robot_state, that can be evaluated independently of the task
+     *         manager, e.g. for batches of robot states, see BatchEvaluator.
+     *         The instances share the primitives with the task manager. The
+     *         resources must be locked by the caller, see lockResources().
+     *  \param version : set to the task set version the instances were created from, see getTaskSetVersion()
+     *  \return 0 on success, -1 if a task could not be initialized, in which case it is left out */
+    int cloneActiveTasks(RobotStatePtr robot_state,
+                         std::vector< std::shared_ptr<Task> >& tasks,
+                         unsigned long& version);
+
+    /// \brief Returns a number that changes whenever tasks or primitives are changed
+    inline unsigned long getTaskSetVersion() const { return task_set_version_.load(); }
+
     int removeTask(std::string task_name);
     int removeAllTasks();
     int listAllTasks();
@@ -115,14 +203,83 @@ namespace hiqp {
 
     typedef std::map< std::string, std::shared_ptr<Task> > TaskMap;
 
+    /// \brief A task along with its flags at the time the snapshot was taken
+    struct TaskSnapshotEntry {
+      TaskSnapshotEntry(const std::shared_ptr<Task>& task, bool active, bool monitored)
+      : task_(task), active_(active), monitored_(monitored) {}
+      std::shared_ptr<Task>   task_;
+      bool                    active_;
+      bool                    monitored_;
+    };
+
+    /// \brief The tasks along with a number that no other snapshot of the task manager has
+    struct TaskSnapshot {
+      TaskSnapshot(unsigned long serial) : serial_(serial) {}
+      std::vector<TaskSnapshotEntry>   entries_;
+      unsigned long                    serial_;
+    };
+
+    /// \brief Sets which entries of the snapshot have rows that may be dropped, and updates broad_phase_ with the current robot state
+    void updateActivation(const TaskSnapshot* snapshot, RobotStatePtr robot_state);
+
+    /// \brief Guarantees the stages of the n_guaranteed_stages_ highest priority levels of the active tasks of the snapshot, whether their rows are dropped or not, see HiQPSolver::setGuaranteedPriorityLevel()
+    void updateGuaranteedLevels(const TaskSnapshot* snapshot);
+
+    /// \brief Solves the stages with the shadow solver and compares its solution with controls
+    void solveShadow(const std::vector<double>& controls);
+
+    /// \brief Publishes the current task map as a new snapshot and deletes the old snapshots the control loop has passed, resource_mutex_ must be held
+    void publishSnapshot();
+
+    /*! \brief Returns a copy of robot_state with a kinematics cache of its own that tasks are initialized with, so that the sweeps of a service call never hold the cache of the control loop, resource_mutex_ must be held */
+    RobotStatePtr prepareServiceRobotState(RobotStatePtr robot_state);
+
+    /*! \brief Returns the current snapshot, which stays valid until the next call to releaseSnapshot().
+     *         The load is sequentially consistent with the increment in releaseSnapshot(), so that
+     *         it cannot be reordered before the release of the previous snapshot, see publishSnapshot() */
+    inline const TaskSnapshot* acquireSnapshot() const 
+      { return snapshot_.load(std::memory_order_seq_cst); }
+
+    /// \brief Marks the end of the use of the snapshot in the control loop
+    inline void releaseSnapshot() 
+      { n_snapshot_releases_.store(n_snapshot_releases_.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst); }
+
     std::shared_ptr<GeometricPrimitiveMap>       geometric_primitive_map_;
     std::shared_ptr<Visualizer>                  visualizer_;
 
     TaskMap                                      task_map_;
 
+    std::atomic<const TaskSnapshot*>             snapshot_; // read by the control loop
+    std::atomic<unsigned long>                   n_snapshot_releases_; // written by the control loop only
+    std::vector< std::pair<const TaskSnapshot*, unsigned long> > retired_snapshots_; // along with n_snapshot_releases_ when retired
+    std::atomic<unsigned long>                   task_set_version_;
+    unsigned long                                n_published_snapshots_;
+
     std::shared_ptr<HiQPSolver>                  solver_;
+    std::string                                  solver_name_;
+    std::shared_ptr<HiQPSolver>                  shadow_solver_;
+    std::vector<double>                          shadow_controls_;
+    SolverComparison                             solver_comparison_;
+    bool                                         null_space_fast_path_;
+    bool                                         sparse_stages_;
+    bool                                         row_compression_;
+    double                                       cycle_budget_;
+    unsigned int                                 n_guaranteed_stages_;
+
+    WorkerPool                                   worker_pool_;
+    WorkerPool::Job                              update_job_; // updates update_tasks_[i]
+    std::vector<Task*>                           update_tasks_; // the active tasks of the current cycle
+    std::vector<int>                             update_results_;
+    RobotStatePtr                                update_robot_state_;
+
+    double                                       activation_margin_;
+    BroadPhase                                   broad_phase_;
+    unsigned long                                broad_phase_serial_; // the snapshot the pairs of broad_phase_ were added from
+    std::vector<int>                             activation_pairs_; // the pair of each snapshot entry, -1 if none
+    unsigned int                                 n_dropped_tasks_;
 
-    std::mutex                                   resource_mutex_;
+    std::mutex                                   resource_mutex_; // guards task_map_ and the primitive map, never waited for by the control loop
+    std::shared_ptr<RobotState>                  service_robot_state_; // guarded by resource_mutex_
 
     unsigned int                                 n_controls_;
   };
@@ -0,0 +1,82 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HIQP_TDEF_CONVEX_DISTANCE_H
+#define HIQP_TDEF_CONVEX_DISTANCE_H
+
+#include <string>
+#include <vector>
+
+#include <hiqp/robot_state.h>
+#include <hiqp/task_definition.h>
+
+#include <hiqp/kinematics_cache.h>
+#include <hiqp/geometric_primitives/convex_distance.h>
+
+namespace hiqp
+{
+namespace tasks
+{
+
+  /*! \brief A task definition on the signed distance between any two convex
+   *         primitives, e.g. box-box or cylinder-box, computed by
+   *         ConvexDistance. Takes the parameters "TDefConvexDist" and
+   *         "<first> <op> <second>", where op is one of <, =, >. The task
+   *         function is negative while the primitives overlap.
+   *  \author Marcus A Johansson */
+  class TDefConvexDistance : public TaskDefinition {
+  public:
+    TDefConvexDistance(std::shared_ptr<GeometricPrimitiveMap> geom_prim_map,
+                       std::shared_ptr<Visualizer> visualizer)
+     : TaskDefinition(geom_prim_map, visualizer) {}
+
+    ~TDefConvexDistance() noexcept {}
+
+    int init(const std::vector<std::string>& parameters,
+             RobotStatePtr robot_state);
+
+    int update(RobotStatePtr robot_state);
+
+    int monitor();
+
+    /// \brief Returns the primitives if the task keeps them apart (">")
+    bool getActivationPrimitives(GeometricPrimitive*& first, GeometricPrimitive*& second);
+
+  private:
+    TDefConvexDistance(const TDefConvexDistance& other) = delete;
+    TDefConvexDistance(TDefConvexDistance&& other) = delete;
+    TDefConvexDistance& operator=(const TDefConvexDistance& other) = delete;
+    TDefConvexDistance& operator=(TDefConvexDistance&& other) noexcept = delete;
+
+    /// \brief This sets jacobian columns corresponding to non-writable joints to 0
+    void maskJacobian(RobotStatePtr robot_state);
+
+    std::shared_ptr<GeometricPrimitive>              primitive_a_;
+    KDL::Frame                                       pose_a_;
+    KDL::Jacobian                                    jacobian_a_;
+
+    std::shared_ptr<GeometricPrimitive>              primitive_b_;
+    KDL::Frame                                       pose_b_;
+    KDL::Jacobian                                    jacobian_b_;
+
+    geometric_primitives::ConvexDistance             distance_; // keeps the simplex between updates
+  };
+
+} // namespace tasks
+
+} // namespace hiqp
+
+#endif // include guard
@@ -23,8 +23,7 @@
 #include <hiqp/robot_state.h>
 #include <hiqp/task_definition.h>
 
-#include <kdl/treefksolverpos_recursive.hpp>
-#include <kdl/treejnttojacsolver.hpp>
+#include <hiqp/kinematics_cache.h>
 
 namespace hiqp
 {
@@ -59,9 +58,6 @@ namespace tasks
     /// \brief This sets jacobian columns corresponding to non-writable joints to 0
     void maskJacobian(RobotStatePtr robot_state);
 
-    std::shared_ptr<KDL::TreeFkSolverPos_recursive>  fk_solver_pos_;
-    std::shared_ptr<KDL::TreeJntToJacSolver>         fk_solver_jac_;
-
     std::shared_ptr<PrimitiveA>  primitive_a_;
     KDL::Frame                   pose_a_;
     KDL::Jacobian                jacobian_a_;
@@ -65,8 +65,10 @@ namespace tasks
     J_.resize(n_task_dimensions, n_joints);
     performance_measures_.resize(0);
 
-    fk_solver_pos_ = std::make_shared<KDL::TreeFkSolverPos_recursive>(robot_state->kdl_tree_);
-    fk_solver_jac_ = std::make_shared<KDL::TreeJntToJacSolver>(robot_state->kdl_tree_);
+    if (robot_state->kinematics_cache_ == nullptr) {
+      printHiqpWarning("In TDefGeometricAlignment::init(), the robot state has no kinematics cache. Unable to create task!");
+      return -5;
+    }
 
     std::shared_ptr<GeometricPrimitiveMap> gpm = this->getGeometricPrimitiveMap();
 
@@ -76,6 +78,9 @@ namespace tasks
     gpm->addDependencyToPrimitive(args.at(0), this->getTaskName());
     gpm->addDependencyToPrimitive(args.at(2), this->getTaskName());
 
+    if (primitive_a_ && primitive_b_)
+      setColumnSupportFromLinks(robot_state->kdl_tree_, {primitive_a_->getFrameId(), primitive_b_->getFrameId()});
+
     int sign = 0;
 
     if (args.at(1).compare("<") == 0 || args.at(1).compare("<=") == 0) {
@@ -97,7 +102,12 @@ namespace tasks
   int TDefGeometricAlignment<PrimitiveA, PrimitiveB>::update(RobotStatePtr robot_state) {
     int retval = 0;
 
-    retval = fk_solver_pos_->JntToCart(robot_state->kdl_jnt_array_vel_.q, pose_a_, primitive_a_->getFrameId());
+    // The cache of the thread that updates the task, see TaskManager::setTask()
+    KinematicsCache* kinematics_cache = robot_state->kinematics_cache_.get();
+    if (kinematics_cache == nullptr)
+      return -5;
+
+    retval = kinematics_cache->getFramePose(robot_state->kdl_jnt_array_vel_.q, primitive_a_->getFrameId(), pose_a_);
     if (retval != 0) {
       std::cerr << "In TDefGeometricAlignment::apply : Can't solve position "
         << "of link '" << primitive_a_->getFrameId() << "'" << " in the "
@@ -106,7 +116,7 @@ namespace tasks
       return -1;
     }
 
-    retval = fk_solver_pos_->JntToCart(robot_state->kdl_jnt_array_vel_.q, pose_b_, primitive_b_->getFrameId());
+    retval = kinematics_cache->getFramePose(robot_state->kdl_jnt_array_vel_.q, primitive_b_->getFrameId(), pose_b_);
     if (retval != 0) {
       std::cerr << "In TDefGeometricAlignment::apply : Can't solve position "
         << "of link '" << primitive_b_->getFrameId() << "'" << " in the "
@@ -115,8 +125,7 @@ namespace tasks
       return -2;
     }
 
-    jacobian_a_.resize(robot_state->kdl_jnt_array_vel_.q.rows());
-    retval = fk_solver_jac_->JntToJac(robot_state->kdl_jnt_array_vel_.q, jacobian_a_, primitive_a_->getFrameId());
+    retval = kinematics_cache->getFrameJacobian(robot_state->kdl_jnt_array_vel_.q, primitive_a_->getFrameId(), jacobian_a_);
     if (retval != 0) {
       std::cerr << "In TDefGeometricAlignment::apply : Can't solve jacobian "
         << "of link '" << primitive_a_->getFrameId() << "'" << " in the "
@@ -125,8 +134,7 @@ namespace tasks
       return -3;
     }
 
-    jacobian_b_.resize(robot_state->kdl_jnt_array_vel_.q.rows());
-    retval = fk_solver_jac_->JntToJac(robot_state->kdl_jnt_array_vel_.q, jacobian_b_, primitive_b_->getFrameId());
+    retval = kinematics_cache->getFrameJacobian(robot_state->kdl_jnt_array_vel_.q, primitive_b_->getFrameId(), jacobian_b_);
     if (retval != 0) {
       std::cerr << "In TDefGeometricAlignment::apply : Can't solve jacobian "
         << "of link '" << primitive_b_->getFrameId() << "'" << " in the "
@@ -23,8 +23,8 @@
 #include <hiqp/robot_state.h>
 #include <hiqp/task_definition.h>
 
-#include <kdl/treefksolverpos_recursive.hpp>
-#include <kdl/treejnttojacsolver.hpp>
+#include <hiqp/kinematics_cache.h>
+#include <hiqp/geometric_primitives/segment_distance.h>
 
 namespace hiqp
 {
@@ -47,6 +47,9 @@ namespace tasks
 
     int monitor();
 
+    /// \brief Returns the primitives if the task keeps them apart (">")
+    bool getActivationPrimitives(GeometricPrimitive*& first, GeometricPrimitive*& second);
+
   private:
     TDefGeometricProjection(const TDefGeometricProjection& other) = delete;
     TDefGeometricProjection(TDefGeometricProjection&& other) = delete;
@@ -69,8 +72,19 @@ namespace tasks
       int q_nr
     );
 
-    std::shared_ptr<KDL::TreeFkSolverPos_recursive>  fk_solver_pos_;
-    std::shared_ptr<KDL::TreeJntToJacSolver>         fk_solver_jac_;
+    /*! \brief Sets the task function to the squared distance between the 
+     *         closest points p1 and p2 of two segments minus radius^2, used
+     *         for the projections onto capsules. NOTE! p1 must be related to
+     *         pose_a_ and p2 to pose_b_ !
+     */
+    void setSegmentDistance(const KDL::Vector& p1, const KDL::Vector& p2, double radius);
+
+    /*! \brief Sets the task function to the signed distance of the field at
+     *         the point pose_a_.p + p__ minus radius, used for the projections
+     *         onto signed distance fields. NOTE! The field must be related to
+     *         pose_b_ !
+     */
+    void setFieldDistance(geometric_primitives::GeometricSDF& sdf, const KDL::Vector& p__, double radius);
 
     std::shared_ptr<PrimitiveA>                      primitive_a_;
     KDL::Frame                                       pose_a_;
@@ -65,8 +65,10 @@ namespace tasks
     J_.resize(1, n_joints);
     performance_measures_.resize(0);
 
-    fk_solver_pos_ = std::make_shared<KDL::TreeFkSolverPos_recursive>(robot_state->kdl_tree_);
-    fk_solver_jac_ = std::make_shared<KDL::TreeJntToJacSolver>(robot_state->kdl_tree_);
+    if (robot_state->kinematics_cache_ == nullptr) {
+      printHiqpWarning("In TDefGeometricProjection::init(), the robot state has no kinematics cache. Unable to create task!");
+      return -5;
+    }
 
     std::shared_ptr<GeometricPrimitiveMap> gpm = this->getGeometricPrimitiveMap();
 
@@ -87,6 +89,10 @@ namespace tasks
     gpm->addDependencyToPrimitive(args.at(0), this->getTaskName());
     gpm->addDependencyToPrimitive(args.at(2), this->getTaskName());
 
+    // The frames of the primitives never change, hence neither do the columns
+    // the jacobian can have nonzeros in
+    setColumnSupportFromLinks(robot_state->kdl_tree_, {primitive_a_->getFrameId(), primitive_b_->getFrameId()});
+
     int sign = 0;
 
     if (args.at(1).compare("<") == 0 || args.at(1).compare("<=") == 0) {
@@ -112,41 +118,40 @@ namespace tasks
   int TDefGeometricProjection<PrimitiveA, PrimitiveB>::update(RobotStatePtr robot_state) {
     int retval = 0;
 
-    retval = fk_solver_pos_->JntToCart(robot_state->kdl_jnt_array_vel_.q, pose_a_, primitive_a_->getFrameId());
+    // The cache of the thread that updates the task, see TaskManager::setTask()
+    KinematicsCache* kinematics_cache = robot_state->kinematics_cache_.get();
+    if (kinematics_cache == nullptr)
+      return -5;
+
+    retval = kinematics_cache->getFramePose(robot_state->kdl_jnt_array_vel_.q, primitive_a_->getFrameId(), pose_a_);
     if (retval != 0) {
-      std::cerr << "In TDefGeometricProjection::apply : Can't solve position "
-        << "of link '" << primitive_a_->getFrameId() << "'" << " in the "
-        << "KDL tree! KDL::TreeFkSolverPos_recursive::JntToCart return "
-        << "error code '" << retval << "'\n";
+      printHiqpWarning("In TDefGeometricProjection::update(), can't get the pose of link '"
+        + primitive_a_->getFrameId() + "'! KinematicsCache::getFramePose returned error code '"
+        + std::to_string(retval) + "'");
       return -1;
     }
 
-    retval = fk_solver_pos_->JntToCart(robot_state->kdl_jnt_array_vel_.q, pose_b_, primitive_b_->getFrameId());
+    retval = kinematics_cache->getFramePose(robot_state->kdl_jnt_array_vel_.q, primitive_b_->getFrameId(), pose_b_);
     if (retval != 0) {
-      std::cerr << "In TDefGeometricProjection::apply : Can't solve position "
-        << "of link '" << primitive_b_->getFrameId() << "'" << " in the "
-        << "KDL tree! KDL::TreeFkSolverPos_recursive::JntToCart return "
-        << "error code '" << retval << "'\n";
+      printHiqpWarning("In TDefGeometricProjection::update(), can't get the pose of link '"
+        + primitive_b_->getFrameId() + "'! KinematicsCache::getFramePose returned error code '"
+        + std::to_string(retval) + "'");
       return -2;
     }
 
-    jacobian_a_.resize(robot_state->kdl_jnt_array_vel_.q.rows());
-    retval = fk_solver_jac_->JntToJac(robot_state->kdl_jnt_array_vel_.q, jacobian_a_, primitive_a_->getFrameId());
+    retval = kinematics_cache->getFrameJacobian(robot_state->kdl_jnt_array_vel_.q, primitive_a_->getFrameId(), jacobian_a_);
     if (retval != 0) {
-      std::cerr << "In TDefGeometricProjection::apply : Can't solve jacobian "
-        << "of link '" << primitive_a_->getFrameId() << "'" << " in the "
-        << "KDL tree! KDL::TreeJntToJacSolver return error code "
-        << "'" << retval << "'\n";
+      printHiqpWarning("In TDefGeometricProjection::update(), can't get the jacobian of link '"
+        + primitive_a_->getFrameId() + "'! KinematicsCache::getFrameJacobian returned error code '"
+        + std::to_string(retval) + "'");
       return -3;
     }
 
-    jacobian_b_.resize(robot_state->kdl_jnt_array_vel_.q.rows());
-    retval = fk_solver_jac_->JntToJac(robot_state->kdl_jnt_array_vel_.q, jacobian_b_, primitive_b_->getFrameId());
+    retval = kinematics_cache->getFrameJacobian(robot_state->kdl_jnt_array_vel_.q, primitive_b_->getFrameId(), jacobian_b_);
     if (retval != 0) {
-      std::cerr << "In TDefGeometricProjection::apply : Can't solve jacobian "
-        << "of link '" << primitive_b_->getFrameId() << "'" << " in the "
-        << "KDL tree! KDL::TreeJntToJacSolver return error code "
-        << "'" << retval << "'\n";
+      printHiqpWarning("In TDefGeometricProjection::update(), can't get the jacobian of link '"
+        + primitive_b_->getFrameId() + "'! KinematicsCache::getFrameJacobian returned error code '"
+        + std::to_string(retval) + "'");
       return -4;
     }
 
@@ -160,6 +165,23 @@ namespace tasks
     return 0;
   }
 
+  template<typename PrimitiveA, typename PrimitiveB>
+  bool TDefGeometricProjection<PrimitiveA, PrimitiveB>::getActivationPrimitives
+  (
+    GeometricPrimitive*& first, 
+    GeometricPrimitive*& second
+  )
+  {
+    // The task function grows with the distance between the primitives, so a 
+    // task that keeps them apart is satisfied while they are far from each other
+    if (task_types_.size() != 1 || task_types_[0] != 1)
+      return false;
+
+    first = primitive_a_.get();
+    second = primitive_b_.get();
+    return true;
+  }
+
   template<typename PrimitiveA, typename PrimitiveB>
   KDL::Vector TDefGeometricProjection<PrimitiveA, PrimitiveB>::getVelocityJacobianForTwoPoints(
     const KDL::Vector& p1, 
@@ -174,6 +196,51 @@ namespace tasks
     return ( Jb.vel+Jp2 - (Ja.vel+Jp1) );
   }
 
+  template<typename PrimitiveA, typename PrimitiveB>
+  void TDefGeometricProjection<PrimitiveA, PrimitiveB>::setFieldDistance
+  (
+    geometric_primitives::GeometricSDF& sdf,
+    const KDL::Vector& p__,
+    double radius
+  )
+  {
+    KDL::Vector p = pose_a_.p + p__;
+    KDL::Vector x = pose_b_.M.Inverse(p - pose_b_.p); // the point in the frame of the field
+
+    Eigen::Vector3d gradient;
+    e_(0) = sdf.getDistance(Eigen::Vector3d(x.x(), x.y(), x.z()), gradient) - radius;
+    KDL::Vector g = pose_b_.M * KDL::Vector(gradient(0), gradient(1), gradient(2));
+
+    // The task jacobian is J = g^T (Jp - Jx), where g is the gradient of the 
+    // field and x is the point p fixed in the frame of the field
+    for (int q_nr = 0; q_nr < jacobian_a_.columns(); ++q_nr) {
+      KDL::Vector Jxp = getVelocityJacobianForTwoPoints(p__, p - pose_b_.p, q_nr);
+      J_(0, q_nr) = - dot(g, Jxp);
+    }
+  }
+
+  template<typename PrimitiveA, typename PrimitiveB>
+  void TDefGeometricProjection<PrimitiveA, PrimitiveB>::setSegmentDistance
+  (
+    const KDL::Vector& p1,
+    const KDL::Vector& p2,
+    double radius
+  )
+  {
+    KDL::Vector p1__ = p1 - pose_a_.p;
+    KDL::Vector p2__ = p2 - pose_b_.p;
+
+    KDL::Vector d = p2 - p1;
+    e_(0) = KDL::dot(d, d) - radius*radius;
+
+    // The task jacobian is J = 2 (p2-p1)^T (Jp2 - Jp1), the closest points
+    // sliding along the segments do not change the distance to first order
+    for (int q_nr = 0; q_nr < jacobian_a_.columns(); ++q_nr) {
+      KDL::Vector Jp2p1 = getVelocityJacobianForTwoPoints(p1__, p2__, q_nr);
+      J_(0, q_nr) = 2 * KDL::dot(d, Jp2p1);
+    }
+  }
+
   template<typename PrimitiveA, typename PrimitiveB>
   void TDefGeometricProjection<PrimitiveA, PrimitiveB>::maskJacobian(RobotStatePtr robot_state) {
     for (unsigned int c=0; c<robot_state->getNumJoints(); ++c) {
@@ -47,6 +47,12 @@ namespace hiqp
   int kdl_getQNrFromLinkName(const KDL::Tree& kdl_tree, 
                              const std::string& link_name);
 
+  /*! \brief Appends the q_nrs of the joints between the root of the tree and the link to qnrs, these are the columns the jacobian of the link can have nonzeros in
+   *  \return 0 on success, -1 if the link was not found */
+  int kdl_getAncestorQNrs(const KDL::Tree& kdl_tree,
+                          const std::string& link_name,
+                          std::vector<int>& qnrs);
+
   int kdl_JntToJac(const KDL::Tree& tree,
                    const KDL::JntArrayVel& qqdot, 
                    KDL::Jacobian& jac, 
@@ -26,6 +26,8 @@
 #include <hiqp/geometric_primitives/geometric_cylinder.h>
 #include <hiqp/geometric_primitives/geometric_sphere.h>
 #include <hiqp/geometric_primitives/geometric_frame.h>
+#include <hiqp/geometric_primitives/geometric_capsule.h>
+#include <hiqp/geometric_primitives/geometric_sdf.h>
 
 namespace hiqp
 {
@@ -36,6 +38,8 @@ namespace hiqp
 	using geometric_primitives::GeometricCylinder;
 	using geometric_primitives::GeometricSphere;
 	using geometric_primitives::GeometricFrame;
+	using geometric_primitives::GeometricCapsule;
+	using geometric_primitives::GeometricSDF;
 
 	/*! \brief An interface for visualizing geometric primitives. Derive from this class to implement your own visualizer and provide it to TaskManager to get visualization of HiQP.
 	 *  \author Marcus A Johansson */
@@ -51,6 +55,8 @@ namespace hiqp
 		virtual int add(std::shared_ptr<GeometricCylinder> cylinder) = 0;
 		virtual int add(std::shared_ptr<GeometricSphere> sphere) = 0;
 		virtual int add(std::shared_ptr<GeometricFrame> frame) = 0;
+		virtual int add(std::shared_ptr<GeometricCapsule> capsule) = 0;
+		virtual int add(std::shared_ptr<GeometricSDF> sdf) = 0;
 
 		virtual void update(int id, std::shared_ptr<GeometricPoint> point) = 0;
 		virtual void update(int id, std::shared_ptr<GeometricLine> line) = 0;
@@ -59,6 +65,8 @@ namespace hiqp
 		virtual void update(int id, std::shared_ptr<GeometricCylinder> cylinder) = 0;
 		virtual void update(int id, std::shared_ptr<GeometricSphere> sphere) = 0;
 		virtual void update(int id, std::shared_ptr<GeometricFrame> frame) = 0;
+		virtual void update(int id, std::shared_ptr<GeometricCapsule> capsule) = 0;
+		virtual void update(int id, std::shared_ptr<GeometricSDF> sdf) = 0;
 
 		virtual void remove(int id) = 0;
 
@@ -0,0 +1,74 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef HIQP_WORKER_POOL_H
+#define HIQP_WORKER_POOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hiqp {
+
+  /*! \brief A pool of worker threads that runs a job over a range of indices. The indices are handed out through an atomic counter (no locks are taken while the jobs run), so threads that finish early simply take the next index. The calling thread takes part in the work, hence a pool with zero threads runs every job serially in the calling thread. The worker threads can be pinned to one cpu core each.
+   *  \author Marcus A Johansson */
+  class WorkerPool {
+  public:
+    typedef std::function<void(unsigned int)> Job;
+
+    WorkerPool();
+    ~WorkerPool() noexcept;
+
+    /*! \brief Stops the current worker threads and starts n_threads new ones
+     *  \param pin_threads : if true, worker thread i is pinned to cpu core i+1, core 0 is left to the calling thread */
+    void setNumThreads(unsigned int n_threads, bool pin_threads);
+
+    inline unsigned int getNumThreads() const { return threads_.size(); }
+
+    /// \brief Calls job(i) for every i in [0, n_jobs) and returns when all calls are done, not reentrant
+    void run(unsigned int n_jobs, const Job& job);
+
+  private:
+    WorkerPool(const WorkerPool& other) = delete;
+    WorkerPool(WorkerPool&& other) = delete;
+    WorkerPool& operator=(const WorkerPool& other) = delete;
+    WorkerPool& operator=(WorkerPool&& other) noexcept = delete;
+
+    void stopThreads();
+    void workerLoop();
+
+    /// \brief Calls the current job for indices until there are none left
+    void work();
+
+    std::vector<std::thread>       threads_;
+    std::mutex                     mutex_;
+    std::condition_variable        start_cv_;
+    unsigned long                  generation_; // incremented for every run(), guarded by mutex_
+    bool                           stop_;
+
+    const Job*                     job_;
+    std::atomic<uint64_t>          jobs_; // the number of jobs in the upper and the next index in the lower 32 bits
+    std::atomic<unsigned int>      n_done_;
+  };
+
+} // namespace hiqp
+
+#endif // include guard
@@ -0,0 +1,145 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <hiqp/batch_evaluator.h>
+#include <hiqp/solver_registry.h>
+#include <hiqp/utilities.h>
+
+namespace hiqp {
+
+  BatchEvaluator::BatchEvaluator(TaskManager& task_manager)
+  : task_manager_(task_manager), q_(nullptr), dq_(nullptr), t_(nullptr), controls_(nullptr),
+    next_state_(0), n_failed_(0) {
+    lane_job_ = [this](unsigned int l) { runLane(l); };
+  }
+
+  void BatchEvaluator::setNumThreads(unsigned int n_threads, bool pin_threads) {
+    worker_pool_.setNumThreads(n_threads, pin_threads);
+  }
+
+  int BatchEvaluator::evaluate(RobotStatePtr robot_state,
+                               const Eigen::MatrixXd& q,
+                               const Eigen::MatrixXd& dq,
+                               const std::vector<HiQPTimePoint>& t,
+                               Eigen::MatrixXd& controls) {
+    unsigned int n_states = q.rows();
+    unsigned int n_joints = robot_state->getNumJoints();
+    if (q.cols() != n_joints || dq.rows() != n_states || dq.cols() != n_joints || t.size() != n_states) {
+      printHiqpWarning("BatchEvaluator::evaluate: the sizes of the joint positions, velocities and time points do not match!");
+      return -1;
+    }
+
+    controls.resize(n_states, task_manager_.getNumControls());
+    if (lanes_.size() != worker_pool_.getNumThreads() + 1)
+      lanes_.resize(worker_pool_.getNumThreads() + 1);
+
+    robot_state_ = robot_state;
+    q_ = &q;
+    dq_ = &dq;
+    t_ = &t;
+    controls_ = &controls;
+    next_state_ = 0;
+    n_failed_ = 0;
+
+    // The lanes read the primitives of the task manager, and the tasks are
+    // cloned one lane at a time since initializing them adds dependencies
+    // to the primitive map
+    task_manager_.lockResources();
+    for (auto&& lane : lanes_)
+      prepareLane(lane);
+    worker_pool_.run(lanes_.size(), lane_job_);
+    task_manager_.unlockResources();
+
+    robot_state_.reset();
+    q_ = nullptr;
+    dq_ = nullptr;
+    t_ = nullptr;
+    controls_ = nullptr;
+
+    return (n_failed_ > 0 ? -2 : 0);
+  }
+
+  void BatchEvaluator::runLane(unsigned int l) {
+    Lane& lane = lanes_[l];
+    unsigned int n_states = q_->rows();
+    unsigned int i = next_state_.fetch_add(1);
+    while (i < n_states) {
+      if (!evaluateState(lane, i))
+        ++n_failed_;
+      i = next_state_.fetch_add(1);
+    }
+  }
+
+  void BatchEvaluator::prepareLane(Lane& lane) {
+    bool new_state = false;
+    if (!lane.robot_state_ || lane.robot_state_->getNumJoints() != robot_state_->getNumJoints()) {
+      lane.robot_state_ = std::make_shared<RobotState>(*robot_state_);
+      lane.robot_state_->kinematics_cache_ = std::make_shared<KinematicsCache>(lane.robot_state_->kdl_tree_);
+      lane.robot_state_ptr_ = lane.robot_state_;
+      new_state = true;
+    }
+
+    if (!lane.solver_ || lane.solver_name_ != task_manager_.getSolverName()) {
+      lane.solver_name_ = task_manager_.getSolverName();
+      lane.solver_ = SolverRegistry::createSolver(lane.solver_name_);
+      lane.solver_->init(task_manager_.getNumControls());
+    }
+    task_manager_.configureSolver(*lane.solver_);
+    lane.controls_.resize(task_manager_.getNumControls());
+
+    // The tasks are initialized with the state the batch was started from
+    if (new_state || lane.task_set_version_ != task_manager_.getTaskSetVersion()) {
+      lane.robot_state_->sampling_time_point_ = robot_state_->sampling_time_point_;
+      lane.robot_state_->kdl_jnt_array_vel_ = robot_state_->kdl_jnt_array_vel_;
+      lane.robot_state_->kinematics_cache_->invalidate();
+      task_manager_.cloneActiveTasks(lane.robot_state_ptr_, lane.tasks_, lane.task_set_version_);
+    }
+  }
+
+  bool BatchEvaluator::evaluateState(Lane& lane, unsigned int i) {
+    RobotState& state = *lane.robot_state_;
+    state.kdl_jnt_array_vel_.q.data = q_->row(i).transpose();
+    state.kdl_jnt_array_vel_.qdot.data = dq_->row(i).transpose();
+    state.sampling_time_point_ = (*t_)[i];
+    state.kinematics_cache_->invalidate();
+
+    HiQPSolver& solver = *lane.solver_;
+    solver.clearStages();
+    bool has_rows = false;
+    for (auto&& task : lane.tasks_) {
+      if (task->update(lane.robot_state_ptr_) == 0) {
+        solver.appendStage(task->getPriority(),
+                           task->getDynamics(),
+                           task->getJacobian(),
+                           task->getTaskTypes(),
+                           task->getColumnSupport());
+        has_rows = true;
+      }
+    }
+    solver.finalizeStages();
+
+    if (!has_rows || !solver.solve(lane.controls_)) {
+      controls_->row(i).setZero();
+      return false;
+    }
+
+    for (unsigned int j = 0; j < lane.controls_.size(); ++j)
+      (*controls_)(i, j) = lane.controls_[j];
+    return true;
+  }
+
+} // namespace hiqp
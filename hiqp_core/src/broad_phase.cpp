@@ -0,0 +1,138 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <hiqp/broad_phase.h>
+#include <hiqp/utilities.h>
+
+#include <algorithm>
+
+namespace hiqp {
+
+  BroadPhase::BroadPhase() : partners_sorted_(true) {}
+
+
+
+
+
+  void BroadPhase::clear() {
+    proxies_.clear();
+    proxy_indices_.clear();
+    pairs_.clear();
+    partners_sorted_ = true;
+    tree_.clear();
+  }
+
+
+
+
+
+  unsigned int BroadPhase::getProxy(GeometricPrimitive* primitive) {
+    auto it = proxy_indices_.find(primitive);
+    if (it != proxy_indices_.end())
+      return it->second;
+
+    proxies_.push_back(Proxy(primitive));
+    proxy_indices_.insert(std::make_pair(primitive, proxies_.size() - 1));
+    return proxies_.size() - 1;
+  }
+
+
+
+
+
+  unsigned int BroadPhase::addPair(GeometricPrimitive* first, GeometricPrimitive* second) {
+    unsigned int pair = pairs_.size();
+    pairs_.push_back(Pair(getProxy(first), getProxy(second)));
+    proxies_[pairs_.back().first_].partners_.push_back(std::make_pair(pairs_.back().second_, pair));
+    partners_sorted_ = false;
+    return pair;
+  }
+
+
+
+
+
+  int BroadPhase::update(RobotStatePtr robot_state, double margin) {
+    if (!partners_sorted_) {
+      for (auto&& proxy : proxies_)
+        std::sort(proxy.partners_.begin(), proxy.partners_.end());
+      partners_sorted_ = true;
+    }
+
+    // Refit the tree, proxies only change the tree when they leave their fat bounds
+    KDL::Frame pose;
+    for (unsigned int i = 0; i < proxies_.size(); ++i) {
+      Proxy& proxy = proxies_[i];
+      if (robot_state->kinematics_cache_->getFramePose(robot_state->kdl_jnt_array_vel_.q, 
+                                                       proxy.primitive_->getFrameId(), 
+                                                       pose) != 0) {
+        printHiqpWarning("In BroadPhase::update(), unable to compute the pose of link '" 
+          + proxy.primitive_->getFrameId() + "'!");
+        for (auto&& pair : pairs_)
+          pair.separated_ = false;
+        return -1;
+      }
+
+      if (proxy.primitive_->getBounds(pose, proxy.bounds_)) {
+        if (proxy.tree_proxy_ < 0)
+          proxy.tree_proxy_ = tree_.createProxy(proxy.bounds_, i);
+        else
+          tree_.moveProxy(proxy.tree_proxy_, proxy.bounds_);
+      } else if (proxy.tree_proxy_ >= 0) {
+        tree_.destroyProxy(proxy.tree_proxy_);
+        proxy.tree_proxy_ = -1;
+      }
+    }
+
+    // Every pair is separated unless it is found near its first primitive
+    for (auto&& pair : pairs_) {
+      pair.separated_ = (proxies_[pair.first_].tree_proxy_ >= 0 && 
+                         proxies_[pair.second_].tree_proxy_ >= 0);
+    }
+
+    for (auto&& proxy : proxies_) {
+      if (proxy.partners_.empty() || proxy.tree_proxy_ < 0)
+        continue;
+
+      query_results_.clear();
+      Eigen::AlignedBox3d query_bounds(proxy.bounds_.min().array() - margin, 
+                                       proxy.bounds_.max().array() + margin);
+      tree_.query(query_bounds, query_results_);
+
+      for (int tree_proxy : query_results_) {
+        unsigned int other = tree_.getUserData(tree_proxy);
+        auto range = std::equal_range(proxy.partners_.begin(), proxy.partners_.end(), 
+                                      std::make_pair(other, 0u),
+                                      [](const std::pair<unsigned int, unsigned int>& a, 
+                                         const std::pair<unsigned int, unsigned int>& b) 
+                                        { return a.first < b.first; });
+        if (range.first == range.second)
+          continue;
+
+        // The fat bounds in the tree are larger than the primitives
+        if (proxy.bounds_.exteriorDistance(proxies_[other].bounds_) > margin)
+          continue;
+
+        for (auto it = range.first; it != range.second; ++it)
+          pairs_[it->second].separated_ = false;
+      }
+    }
+
+    return 0;
+  }
+
+} // namespace hiqp
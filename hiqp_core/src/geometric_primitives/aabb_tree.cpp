@@ -0,0 +1,378 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <hiqp/geometric_primitives/aabb_tree.h>
+
+#include <algorithm>
+
+#define DEFAULT_FAT_MARGIN    0.02 // meters
+#define OVERSIZE_FACTOR       4 // fat boxes larger than this many margins are shrunk
+
+namespace hiqp
+{
+namespace geometric_primitives
+{
+
+/// \brief The surface area of the box, the cost of a node in the tree
+inline double surfaceArea(const Eigen::AlignedBox3d& box) {
+  Eigen::Vector3d s = box.sizes();
+  return 2 * (s(0)*s(1) + s(1)*s(2) + s(2)*s(0));
+}
+
+inline Eigen::AlignedBox3d enlarged(const Eigen::AlignedBox3d& box, double margin) {
+  return Eigen::AlignedBox3d(box.min().array() - margin, box.max().array() + margin);
+}
+
+AABBTree::AABBTree()
+: root_(-1), free_list_(-1), n_proxies_(0), fat_margin_(DEFAULT_FAT_MARGIN) {}
+
+
+
+
+
+void AABBTree::clear() {
+  nodes_.clear();
+  root_ = -1;
+  free_list_ = -1;
+  n_proxies_ = 0;
+}
+
+
+
+
+
+int AABBTree::createProxy
+(
+  const Eigen::AlignedBox3d& bounds, 
+  int user_data
+)
+{
+  int leaf = allocateNode();
+  nodes_[leaf].bounds_ = enlarged(bounds, fat_margin_);
+  nodes_[leaf].user_data_ = user_data;
+  nodes_[leaf].height_ = 0;
+  insertLeaf(leaf);
+  ++n_proxies_;
+  return leaf;
+}
+
+
+
+
+
+void AABBTree::destroyProxy(int proxy) {
+  removeLeaf(proxy);
+  freeNode(proxy);
+  --n_proxies_;
+}
+
+
+
+
+
+bool AABBTree::moveProxy
+(
+  int proxy, 
+  const Eigen::AlignedBox3d& bounds
+)
+{
+  const Eigen::AlignedBox3d& fat_bounds = nodes_[proxy].bounds_;
+  if (fat_bounds.contains(bounds) && 
+      enlarged(bounds, OVERSIZE_FACTOR * fat_margin_).contains(fat_bounds))
+    return false;
+
+  removeLeaf(proxy);
+  nodes_[proxy].bounds_ = enlarged(bounds, fat_margin_);
+  insertLeaf(proxy);
+  return true;
+}
+
+
+
+
+
+void AABBTree::query
+(
+  const Eigen::AlignedBox3d& bounds, 
+  std::vector<int>& proxies
+)
+{
+  stack_.clear();
+  if (root_ >= 0)
+    stack_.push_back(root_);
+
+  while (!stack_.empty()) {
+    int node = stack_.back();
+    stack_.pop_back();
+
+    const Node& n = nodes_[node];
+    if (!n.bounds_.intersects(bounds))
+      continue;
+
+    if (n.isLeaf()) {
+      proxies.push_back(node);
+    } else {
+      stack_.push_back(n.child1_);
+      stack_.push_back(n.child2_);
+    }
+  }
+}
+
+
+
+
+
+int AABBTree::allocateNode() {
+  if (free_list_ < 0) {
+    nodes_.push_back(Node());
+    free_list_ = nodes_.size() - 1;
+    nodes_.back().parent_ = -1;
+  }
+
+  int node = free_list_;
+  free_list_ = nodes_[node].parent_;
+  nodes_[node].parent_ = -1;
+  nodes_[node].child1_ = -1;
+  nodes_[node].child2_ = -1;
+  nodes_[node].height_ = 0;
+  nodes_[node].user_data_ = -1;
+  return node;
+}
+
+
+
+
+
+void AABBTree::freeNode(int node) {
+  nodes_[node].parent_ = free_list_;
+  nodes_[node].height_ = -1;
+  free_list_ = node;
+}
+
+
+
+
+
+void AABBTree::insertLeaf(int leaf) {
+  if (root_ < 0) {
+    root_ = leaf;
+    nodes_[root_].parent_ = -1;
+    return;
+  }
+
+  // Find the best sibling by descending where the increase of surface area,
+  // including the enlargement of the ancestors, is the smallest
+  Eigen::AlignedBox3d leaf_bounds = nodes_[leaf].bounds_;
+  int index = root_;
+  while (!nodes_[index].isLeaf()) {
+    int child1 = nodes_[index].child1_;
+    int child2 = nodes_[index].child2_;
+
+    double area = surfaceArea(nodes_[index].bounds_);
+    double combined_area = surfaceArea(nodes_[index].bounds_.merged(leaf_bounds));
+
+    // The cost of making a new parent of this node and the leaf
+    double cost = 2 * combined_area;
+    // The minimum cost of pushing the leaf further down the tree
+    double inheritance_cost = 2 * (combined_area - area);
+
+    double cost1 = surfaceArea(leaf_bounds.merged(nodes_[child1].bounds_)) + inheritance_cost;
+    if (!nodes_[child1].isLeaf())
+      cost1 -= surfaceArea(nodes_[child1].bounds_);
+    double cost2 = surfaceArea(leaf_bounds.merged(nodes_[child2].bounds_)) + inheritance_cost;
+    if (!nodes_[child2].isLeaf())
+      cost2 -= surfaceArea(nodes_[child2].bounds_);
+
+    if (cost < cost1 && cost < cost2)
+      break;
+
+    index = (cost1 < cost2 ? child1 : child2);
+  }
+  int sibling = index;
+
+  // Make a new parent of the sibling and the leaf
+  int new_parent = allocateNode();
+  int old_parent = nodes_[sibling].parent_;
+  nodes_[new_parent].parent_ = old_parent;
+  nodes_[new_parent].bounds_ = leaf_bounds.merged(nodes_[sibling].bounds_);
+  nodes_[new_parent].height_ = nodes_[sibling].height_ + 1;
+  nodes_[new_parent].child1_ = sibling;
+  nodes_[new_parent].child2_ = leaf;
+  nodes_[sibling].parent_ = new_parent;
+  nodes_[leaf].parent_ = new_parent;
+
+  if (old_parent >= 0) {
+    if (nodes_[old_parent].child1_ == sibling)
+      nodes_[old_parent].child1_ = new_parent;
+    else
+      nodes_[old_parent].child2_ = new_parent;
+  } else {
+    root_ = new_parent;
+  }
+
+  // Refit and rebalance the ancestors
+  index = nodes_[leaf].parent_;
+  while (index >= 0) {
+    index = balance(index);
+    Node& n = nodes_[index];
+    n.height_ = 1 + std::max(nodes_[n.child1_].height_, nodes_[n.child2_].height_);
+    n.bounds_ = nodes_[n.child1_].bounds_.merged(nodes_[n.child2_].bounds_);
+    index = n.parent_;
+  }
+}
+
+
+
+
+
+void AABBTree::removeLeaf(int leaf) {
+  if (leaf == root_) {
+    root_ = -1;
+    return;
+  }
+
+  int parent = nodes_[leaf].parent_;
+  int grand_parent = nodes_[parent].parent_;
+  int sibling = (nodes_[parent].child1_ == leaf ? nodes_[parent].child2_ : nodes_[parent].child1_);
+
+  if (grand_parent < 0) {
+    root_ = sibling;
+    nodes_[sibling].parent_ = -1;
+    freeNode(parent);
+    return;
+  }
+
+  // Replace the parent by the sibling and refit the ancestors
+  if (nodes_[grand_parent].child1_ == parent)
+    nodes_[grand_parent].child1_ = sibling;
+  else
+    nodes_[grand_parent].child2_ = sibling;
+  nodes_[sibling].parent_ = grand_parent;
+  freeNode(parent);
+
+  int index = grand_parent;
+  while (index >= 0) {
+    index = balance(index);
+    Node& n = nodes_[index];
+    n.height_ = 1 + std::max(nodes_[n.child1_].height_, nodes_[n.child2_].height_);
+    n.bounds_ = nodes_[n.child1_].bounds_.merged(nodes_[n.child2_].bounds_);
+    index = n.parent_;
+  }
+}
+
+
+
+
+
+int AABBTree::balance(int ia) {
+  Node& a = nodes_[ia];
+  if (a.isLeaf() || a.height_ < 2)
+    return ia;
+
+  int ib = a.child1_;
+  int ic = a.child2_;
+  Node& b = nodes_[ib];
+  Node& c = nodes_[ic];
+
+  int imbalance = c.height_ - b.height_;
+
+  if (imbalance > 1) {
+    // Rotate c up
+    int if_ = c.child1_;
+    int ig = c.child2_;
+    Node& f = nodes_[if_];
+    Node& g = nodes_[ig];
+
+    c.child1_ = ia;
+    c.parent_ = a.parent_;
+    a.parent_ = ic;
+
+    if (c.parent_ >= 0) {
+      if (nodes_[c.parent_].child1_ == ia)
+        nodes_[c.parent_].child1_ = ic;
+      else
+        nodes_[c.parent_].child2_ = ic;
+    } else {
+      root_ = ic;
+    }
+
+    if (f.height_ > g.height_) {
+      c.child2_ = if_;
+      a.child2_ = ig;
+      g.parent_ = ia;
+      a.bounds_ = b.bounds_.merged(g.bounds_);
+      c.bounds_ = a.bounds_.merged(f.bounds_);
+      a.height_ = 1 + std::max(b.height_, g.height_);
+      c.height_ = 1 + std::max(a.height_, f.height_);
+    } else {
+      c.child2_ = ig;
+      a.child2_ = if_;
+      f.parent_ = ia;
+      a.bounds_ = b.bounds_.merged(f.bounds_);
+      c.bounds_ = a.bounds_.merged(g.bounds_);
+      a.height_ = 1 + std::max(b.height_, f.height_);
+      c.height_ = 1 + std::max(a.height_, g.height_);
+    }
+    return ic;
+  }
+
+  if (imbalance < -1) {
+    // Rotate b up
+    int id = b.child1_;
+    int ie = b.child2_;
+    Node& d = nodes_[id];
+    Node& e = nodes_[ie];
+
+    b.child1_ = ia;
+    b.parent_ = a.parent_;
+    a.parent_ = ib;
+
+    if (b.parent_ >= 0) {
+      if (nodes_[b.parent_].child1_ == ia)
+        nodes_[b.parent_].child1_ = ib;
+      else
+        nodes_[b.parent_].child2_ = ib;
+    } else {
+      root_ = ib;
+    }
+
+    if (d.height_ > e.height_) {
+      b.child2_ = id;
+      a.child1_ = ie;
+      e.parent_ = ia;
+      a.bounds_ = c.bounds_.merged(e.bounds_);
+      b.bounds_ = a.bounds_.merged(d.bounds_);
+      a.height_ = 1 + std::max(c.height_, e.height_);
+      b.height_ = 1 + std::max(a.height_, d.height_);
+    } else {
+      b.child2_ = ie;
+      a.child1_ = id;
+      d.parent_ = ia;
+      a.bounds_ = c.bounds_.merged(d.bounds_);
+      b.bounds_ = a.bounds_.merged(e.bounds_);
+      a.height_ = 1 + std::max(c.height_, d.height_);
+      b.height_ = 1 + std::max(a.height_, e.height_);
+    }
+    return ib;
+  }
+
+  return ia;
+}
+
+} // namespace geometric_primitives
+
+} // namespace hiqp
@@ -0,0 +1,428 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <hiqp/geometric_primitives/convex_distance.h>
+
+#include <cmath>
+
+#define GJK_MAX_ITERATIONS      32
+#define GJK_TOLERANCE           1e-6  // [m] on the distance
+#define CONTACT_TOLERANCE       1e-9  // [m] distances below it are treated as contact
+#define DUPLICATE_TOLERANCE     1e-9  // [m] between vertices of the simplex
+#define DEGENERATE_TOLERANCE    1e-12 // relative to the Hadamard bound of the Gram determinant
+#define EPA_MAX_ITERATIONS      64    // curved primitives converge slowly, deep penetrations of them are approximate
+#define EPA_TOLERANCE           1e-6  // [m] on the penetration depth
+
+namespace hiqp
+{
+namespace geometric_primitives
+{
+
+  namespace
+  {
+    /// The subsets of a tetrahedron as bit masks, ordered by their number of vertices
+    const unsigned int SUBSETS[15] = {1, 2, 4, 8, 3, 5, 6, 9, 10, 12, 7, 11, 13, 14, 15};
+
+    inline Eigen::Vector3d toEigen(const KDL::Vector& v) {
+      return Eigen::Vector3d(v.x(), v.y(), v.z());
+    }
+  }
+
+
+
+
+
+  ConvexDistance::ConvexDistance()
+  : first_(nullptr), second_(nullptr), n_simplex_(0), n_cached_directions_(0),
+    distance_(0), first_point_(Eigen::Vector3d::Zero()),
+    second_point_(Eigen::Vector3d::Zero()), normal_(Eigen::Vector3d::UnitX()),
+    has_normal_(false), n_iterations_(0)
+  {}
+
+
+
+
+
+  int ConvexDistance::compute
+  (
+    GeometricPrimitive& first,
+    const KDL::Frame& first_pose,
+    GeometricPrimitive& second,
+    const KDL::Frame& second_pose
+  )
+  {
+    KDL::Vector unused;
+    if (!first.getSupport(KDL::Vector(1, 0, 0), unused) ||
+        !second.getSupport(KDL::Vector(1, 0, 0), unused))
+      return -1;
+
+    first_ = &first;
+    second_ = &second;
+    first_pose_ = first_pose;
+    second_pose_ = second_pose;
+    n_iterations_ = 0;
+
+    // Warm start from the directions the last simplex was built from
+    n_simplex_ = 0;
+    for (unsigned int i = 0; i < n_cached_directions_; ++i) {
+      Vertex vertex;
+      support(cached_directions_[i], vertex);
+      if (!isInSimplex(vertex.w_))
+        simplex_[n_simplex_++] = vertex;
+    }
+    if (n_simplex_ == 0) {
+      Eigen::Vector3d direction = toEigen(second_pose.p - first_pose.p);
+      if (direction.squaredNorm() == 0)
+        direction = Eigen::Vector3d::UnitX();
+      support(direction, simplex_[0]);
+      n_simplex_ = 1;
+    }
+
+    Eigen::Vector3d v = reduceSimplex();
+    double v2 = v.squaredNorm();
+    bool overlapping = false;
+    while (true) {
+      if (n_simplex_ == 4 || v2 <= CONTACT_TOLERANCE*CONTACT_TOLERANCE) {
+        overlapping = true;
+        break;
+      }
+      if (n_iterations_ >= GJK_MAX_ITERATIONS)
+        break;
+      ++n_iterations_;
+
+      Vertex vertex;
+      support(-v, vertex);
+      // No vertex is closer to the origin along v than the simplex, so v is
+      // the closest point within the tolerance
+      if (v2 - v.dot(vertex.w_) <= GJK_TOLERANCE * std::sqrt(v2))
+        break;
+      if (isInSimplex(vertex.w_))
+        break;
+
+      simplex_[n_simplex_++] = vertex;
+      Eigen::Vector3d v_next = reduceSimplex();
+      double v2_next = v_next.squaredNorm();
+      bool progress = (v2_next < v2);
+      v = v_next;
+      v2 = v2_next;
+      if (!progress)
+        break;
+    }
+
+    n_cached_directions_ = n_simplex_;
+    for (unsigned int i = 0; i < n_simplex_; ++i)
+      cached_directions_[i] = simplex_[i].direction_;
+
+    setWitnessPoints();
+    if (!overlapping) {
+      distance_ = std::sqrt(v2);
+      normal_ = -v / distance_;
+      has_normal_ = true;
+      return 0;
+    }
+
+    distance_ = 0;
+    if (blowUpSimplex())
+      penetrate();
+
+    // The primitives only touch if the Minkowski difference is flat, the
+    // normal of the previous call is kept then. Without one, the witness
+    // points or else the frame origins give the direction.
+    if (!has_normal_) {
+      Eigen::Vector3d direction = second_point_ - first_point_;
+      if (direction.squaredNorm() == 0)
+        direction = toEigen(second_pose.p - first_pose.p);
+      normal_ = (direction.squaredNorm() == 0 ? Eigen::Vector3d::UnitX() : direction.normalized());
+    }
+    return 0;
+  }
+
+
+
+
+
+  void ConvexDistance::support
+  (
+    const Eigen::Vector3d& direction,
+    Vertex& vertex
+  )
+  {
+    KDL::Vector d(direction(0), direction(1), direction(2));
+    KDL::Vector a, b;
+    first_->getSupport(first_pose_.M.Inverse(d), a);
+    second_->getSupport(second_pose_.M.Inverse(-d), b);
+    vertex.a_ = toEigen(first_pose_ * a);
+    vertex.b_ = toEigen(second_pose_ * b);
+    vertex.w_ = vertex.a_ - vertex.b_;
+    vertex.direction_ = direction;
+  }
+
+
+
+
+
+  Eigen::Vector3d ConvexDistance::reduceSimplex() {
+    Eigen::Vector3d closest = simplex_[0].w_;
+    double closest_norm = INFINITY;
+    unsigned int closest_indices[4] = {0, 0, 0, 0};
+    double closest_lambdas[4] = {1, 0, 0, 0};
+    unsigned int closest_count = 1;
+
+    for (unsigned int mask : SUBSETS) {
+      if (mask >= (1u << n_simplex_))
+        continue;
+
+      unsigned int indices[4];
+      unsigned int count = 0;
+      for (unsigned int i = 0; i < n_simplex_; ++i)
+        if (mask & (1u << i))
+          indices[count++] = i;
+
+      // The closest point of the affine hull is w0 + E mu, with the normal
+      // equations (E^T E) mu = -E^T w0. The unused block of the Gram matrix
+      // is the identity so that the determinant is the one of the used block
+      const Eigen::Vector3d& w0 = simplex_[indices[0]].w_;
+      Eigen::Matrix3d E = Eigen::Matrix3d::Zero();
+      for (unsigned int j = 1; j < count; ++j)
+        E.col(j-1) = simplex_[indices[j]].w_ - w0;
+      Eigen::Matrix3d G = E.transpose() * E;
+      for (unsigned int j = count-1; j < 3; ++j)
+        G(j, j) = 1;
+      if (G.determinant() <= DEGENERATE_TOLERANCE * G(0,0) * G(1,1) * G(2,2))
+        continue;
+      Eigen::Vector3d mu = G.inverse() * (-E.transpose() * w0);
+
+      double lambdas[4];
+      lambdas[0] = 1;
+      bool interior = true;
+      for (unsigned int j = 1; j < count; ++j) {
+        lambdas[j] = mu(j-1);
+        lambdas[0] -= mu(j-1);
+        interior = interior && (lambdas[j] > 0);
+      }
+      if (!interior || lambdas[0] <= 0)
+        continue;
+
+      Eigen::Vector3d x = w0 + E * mu;
+      double norm = x.squaredNorm();
+      if (norm < closest_norm) {
+        closest = x;
+        closest_norm = norm;
+        closest_count = count;
+        for (unsigned int j = 0; j < count; ++j) {
+          closest_indices[j] = indices[j];
+          closest_lambdas[j] = lambdas[j];
+        }
+      }
+    }
+
+    // The indices are increasing, so the vertices can be compacted in place
+    for (unsigned int j = 0; j < closest_count; ++j) {
+      simplex_[j] = simplex_[closest_indices[j]];
+      lambdas_[j] = closest_lambdas[j];
+    }
+    n_simplex_ = closest_count;
+    return closest;
+  }
+
+
+
+
+
+  bool ConvexDistance::isInSimplex(const Eigen::Vector3d& w) const {
+    for (unsigned int i = 0; i < n_simplex_; ++i)
+      if ((simplex_[i].w_ - w).squaredNorm() <= DUPLICATE_TOLERANCE*DUPLICATE_TOLERANCE)
+        return true;
+    return false;
+  }
+
+
+
+
+
+  void ConvexDistance::setWitnessPoints() {
+    first_point_.setZero();
+    second_point_.setZero();
+    for (unsigned int i = 0; i < n_simplex_; ++i) {
+      first_point_ += lambdas_[i] * simplex_[i].a_;
+      second_point_ += lambdas_[i] * simplex_[i].b_;
+    }
+  }
+
+
+
+
+
+  bool ConvexDistance::blowUpSimplex() {
+    if (n_simplex_ == 1) {
+      for (unsigned int i = 0; i < 6; ++i) {
+        Eigen::Vector3d direction = Eigen::Vector3d::Zero();
+        direction(i/2) = (i % 2 == 0 ? 1 : -1);
+        support(direction, simplex_[1]);
+        if ((simplex_[1].w_ - simplex_[0].w_).norm() > DUPLICATE_TOLERANCE) {
+          n_simplex_ = 2;
+          break;
+        }
+      }
+      if (n_simplex_ == 1)
+        return false;
+    }
+
+    if (n_simplex_ == 2) {
+      Eigen::Vector3d e = simplex_[1].w_ - simplex_[0].w_;
+      int axis = 0;
+      e.cwiseAbs().minCoeff(&axis);
+      Eigen::Vector3d direction = e.cross(Eigen::Vector3d::Unit(axis)).normalized();
+      Eigen::AngleAxisd rotation(M_PI/3, e.normalized());
+      for (unsigned int i = 0; i < 6; ++i) {
+        support(direction, simplex_[2]);
+        if ((simplex_[2].w_ - simplex_[0].w_).cross(e).norm() > DUPLICATE_TOLERANCE * e.norm()) {
+          n_simplex_ = 3;
+          break;
+        }
+        direction = rotation * direction;
+      }
+      if (n_simplex_ == 2)
+        return false;
+    }
+
+    if (n_simplex_ == 3) {
+      Eigen::Vector3d n = (simplex_[1].w_ - simplex_[0].w_).cross(simplex_[2].w_ - simplex_[0].w_).normalized();
+      for (double sign : {1.0, -1.0}) {
+        support(sign * n, simplex_[3]);
+        if (std::abs(n.dot(simplex_[3].w_ - simplex_[0].w_)) > DUPLICATE_TOLERANCE) {
+          n_simplex_ = 4;
+          break;
+        }
+      }
+      if (n_simplex_ == 3)
+        return false;
+    }
+    return true;
+  }
+
+
+
+
+
+  void ConvexDistance::penetrate() {
+    polytope_.assign(simplex_, simplex_ + 4);
+    const Eigen::Vector3d& w0 = polytope_[0].w_;
+    if ((polytope_[1].w_ - w0).cross(polytope_[2].w_ - w0).dot(polytope_[3].w_ - w0) > 0)
+      std::swap(polytope_[1], polytope_[2]);
+
+    faces_.clear();
+    addFace(0, 1, 2);
+    addFace(0, 3, 1);
+    addFace(0, 2, 3);
+    addFace(1, 3, 2);
+
+    unsigned int closest = 0;
+    for (unsigned int iteration = 0; ; ++iteration) {
+      closest = 0;
+      for (unsigned int i = 1; i < faces_.size(); ++i)
+        if (faces_[i].distance_ < faces_[closest].distance_)
+          closest = i;
+      if (iteration >= EPA_MAX_ITERATIONS || faces_[closest].distance_ == INFINITY)
+        break;
+      ++n_iterations_;
+
+      Vertex vertex;
+      support(faces_[closest].normal_, vertex);
+      if (vertex.w_.dot(faces_[closest].normal_) - faces_[closest].distance_ <= EPA_TOLERANCE)
+        break;
+
+      // Remove the faces the vertex sees and close the hole with faces from
+      // the vertex to the edges of the horizon
+      horizon_.clear();
+      for (int i = faces_.size() - 1; i >= 0; --i) {
+        const Face& face = faces_[i];
+        if (face.normal_.dot(vertex.w_ - polytope_[face.vertices_[0]].w_) > 0) {
+          addHorizonEdge(face.vertices_[0], face.vertices_[1]);
+          addHorizonEdge(face.vertices_[1], face.vertices_[2]);
+          addHorizonEdge(face.vertices_[2], face.vertices_[0]);
+          faces_[i] = faces_.back();
+          faces_.pop_back();
+        }
+      }
+      polytope_.push_back(vertex);
+      for (const std::pair<int, int>& edge : horizon_)
+        addFace(edge.first, edge.second, polytope_.size() - 1);
+    }
+
+    const Face& face = faces_[closest];
+    if (face.distance_ == INFINITY)
+      return;
+
+    // The barycentric coordinates of the projection of the origin on the face
+    const Eigen::Vector3d& n = face.normal_;
+    Eigen::Vector3d p = face.distance_ * n;
+    const Vertex& v0 = polytope_[face.vertices_[0]];
+    const Vertex& v1 = polytope_[face.vertices_[1]];
+    const Vertex& v2 = polytope_[face.vertices_[2]];
+    double area = (v1.w_ - v0.w_).cross(v2.w_ - v0.w_).dot(n);
+    double l0 = (v1.w_ - p).cross(v2.w_ - p).dot(n) / area;
+    double l1 = (v2.w_ - p).cross(v0.w_ - p).dot(n) / area;
+    double l2 = 1 - l0 - l1;
+
+    first_point_ = l0 * v0.a_ + l1 * v1.a_ + l2 * v2.a_;
+    second_point_ = l0 * v0.b_ + l1 * v1.b_ + l2 * v2.b_;
+    distance_ = -face.distance_;
+    normal_ = n;
+    has_normal_ = true;
+  }
+
+
+
+
+
+  void ConvexDistance::addFace(int v0, int v1, int v2) {
+    Face face;
+    face.vertices_[0] = v0;
+    face.vertices_[1] = v1;
+    face.vertices_[2] = v2;
+    const Eigen::Vector3d& w0 = polytope_[v0].w_;
+    Eigen::Vector3d n = (polytope_[v1].w_ - w0).cross(polytope_[v2].w_ - w0);
+    double norm = n.norm();
+    if (norm > DEGENERATE_TOLERANCE) {
+      face.normal_ = n / norm;
+      face.distance_ = face.normal_.dot(w0);
+    } else {
+      face.normal_.setZero();
+      face.distance_ = INFINITY;
+    }
+    faces_.push_back(face);
+  }
+
+
+
+
+
+  void ConvexDistance::addHorizonEdge(int v0, int v1) {
+    // An edge shared by two removed faces is inside the hole
+    for (unsigned int i = 0; i < horizon_.size(); ++i) {
+      if (horizon_[i].first == v1 && horizon_[i].second == v0) {
+        horizon_[i] = horizon_.back();
+        horizon_.pop_back();
+        return;
+      }
+    }
+    horizon_.push_back(std::make_pair(v0, v1));
+  }
+
+} // namespace geometric_primitives
+
+} // namespace hiqp
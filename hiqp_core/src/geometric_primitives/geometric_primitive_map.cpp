@@ -17,16 +17,25 @@
 #include <iostream>
 #include <algorithm>
 #include <iterator>
+#include <sstream>
 
 #include <hiqp/geometric_primitives/geometric_primitive_map.h>
 #include <hiqp/utilities.h>
 
+#define UPDATE_QUEUE_CAPACITY  1024 // primitives with published parameters that are tracked individually
+
 namespace hiqp
 {
 namespace geometric_primitives
 {
 
-/// \todo Add a Capsule primitive among the geometric primitives
+GeometricPrimitiveMap::GeometricPrimitiveMap()
+: update_queue_(UPDATE_QUEUE_CAPACITY), update_queue_overflow_(false) {}
+
+
+
+
+
 int GeometricPrimitiveMap::setGeometricPrimitive
 (
   const std::string& name,
@@ -37,99 +46,36 @@ int GeometricPrimitiveMap::setGeometricPrimitive
   const std::vector<double>& parameters
 )
 {
-  if (std::find(all_primitive_names_.begin(), all_primitive_names_.end(), name)
-      != all_primitive_names_.end())
+  std::lock_guard<std::mutex> lock(structure_mutex_);
+  if (name_index_.find(name) != name_index_.end())
   {
     printHiqpWarning("A primitive with name '" + name 
       + "' already exists. No new primitive was added!");
     return -1;
   }
 
-  bool success = false;
-
   if (type.compare("point") == 0)
-  {
-    auto primitive = std::make_shared<GeometricPoint>(name, frame_id, visible, color);
-    if (primitive->init(parameters) == 0)
-    {
-      point_map_.emplace( name, primitive );
-      success = true;
-    }
-  }
+    return addGeometricPrimitive<GeometricPoint>(name, frame_id, visible, color, parameters);
   else if (type.compare("line") == 0)
-  {
-    auto primitive = std::make_shared<GeometricLine>(name, frame_id, visible, color);
-    if (primitive->init(parameters) == 0)
-    {
-      line_map_.emplace( name, primitive );
-      success = true;
-    }
-
-  }
+    return addGeometricPrimitive<GeometricLine>(name, frame_id, visible, color, parameters);
   else if (type.compare("plane") == 0)
-  {
-    auto primitive = std::make_shared<GeometricPlane>(name, frame_id, visible, color);
-    if (primitive->init(parameters) == 0)
-    {
-      plane_map_.emplace( name, primitive );
-      success = true;
-    }
-
-  }
+    return addGeometricPrimitive<GeometricPlane>(name, frame_id, visible, color, parameters);
   else if (type.compare("box") == 0)
-  {
-    auto primitive = std::make_shared<GeometricBox>(name, frame_id, visible, color);
-    if (primitive->init(parameters) == 0)
-    {
-      box_map_.emplace( name, primitive );
-      success = true;
-    }
-  }
+    return addGeometricPrimitive<GeometricBox>(name, frame_id, visible, color, parameters);
   else if (type.compare("cylinder") == 0)
-  {
-    auto primitive = std::make_shared<GeometricCylinder>(name, frame_id, visible, color);
-    if (primitive->init(parameters) == 0)
-    {
-      cylinder_map_.emplace( name, primitive );
-      success = true;
-    }
-  }
+    return addGeometricPrimitive<GeometricCylinder>(name, frame_id, visible, color, parameters);
   else if (type.compare("sphere") == 0)
-  {
-    auto primitive = std::make_shared<GeometricSphere>(name, frame_id, visible, color);
-    if (primitive->init(parameters) == 0)
-    {
-      sphere_map_.emplace( name, primitive );
-      success = true;
-    }
-  }
+    return addGeometricPrimitive<GeometricSphere>(name, frame_id, visible, color, parameters);
   else if (type.compare("frame") == 0)
-  {
-    auto primitive = std::make_shared<GeometricFrame>(name, frame_id, visible, color);
-    if (primitive->init(parameters) == 0)
-    {
-      frame_map_.emplace( name, primitive );
-      success = true;
-    }
-  }
-  else
-  {
-    printHiqpWarning("Couldn't parse geometric type '" + type + 
-      "'. No new primitive was added!");
-    return -2;
-  }
-
-  if (success)
-  {
-    all_primitive_names_.push_back(name);
-    dependency_map_.emplace( name, std::vector<std::string>() );
-  } 
-  else
-  {
-    return -3;
-  }
-
-  return 0;
+    return addGeometricPrimitive<GeometricFrame>(name, frame_id, visible, color, parameters);
+  else if (type.compare("capsule") == 0)
+    return addGeometricPrimitive<GeometricCapsule>(name, frame_id, visible, color, parameters);
+  else if (type.compare("sdf") == 0)
+    return addGeometricPrimitive<GeometricSDF>(name, frame_id, visible, color, parameters);
+
+  printHiqpWarning("Couldn't parse geometric type '" + type + 
+    "'. No new primitive was added!");
+  return -2;
 }
 
 
@@ -137,15 +83,16 @@ int GeometricPrimitiveMap::setGeometricPrimitive
 
 
 int GeometricPrimitiveMap::removeGeometricPrimitive(std::string name) {
-  if (std::find(all_primitive_names_.begin(), all_primitive_names_.end(), name)
-      == all_primitive_names_.end())
+  std::lock_guard<std::mutex> lock(structure_mutex_);
+  NameIndex::iterator it = name_index_.find(name);
+  if (it == name_index_.end())
   {
     printHiqpWarning("While trying to remove primitive with name '" + name 
       + "', could not find that primitive. No primitive was removed!");
     return -1;
   }
 
-  std::string dependencies = getDependenciesAsString(name);
+  std::string dependencies = getDependenciesAsString(it->second);
   if (dependencies.size() > 0)
   {
     printHiqpWarning("Geometric primitive '" + name + 
@@ -154,19 +101,8 @@ int GeometricPrimitiveMap::removeGeometricPrimitive(std::string name) {
       return -2;
   }
 
-  point_map_.erase(name);
-  line_map_.erase(name);
-  plane_map_.erase(name);
-  box_map_.erase(name);
-  cylinder_map_.erase(name);
-  sphere_map_.erase(name);
-  frame_map_.erase(name);
-  dependency_map_.erase(name);
-  
-  all_primitive_names_.erase(
-    std::remove(all_primitive_names_.begin(), all_primitive_names_.end(), name), 
-    all_primitive_names_.end()
-  );
+  erasePrimitive(it->second);
+  name_index_.erase(it);
 
   printHiqpInfo("Removed geometric primitive '" + name + "'.");
 
@@ -178,40 +114,25 @@ int GeometricPrimitiveMap::removeGeometricPrimitive(std::string name) {
 int GeometricPrimitiveMap::clear
 ()
 {
-  std::vector<std::string> names_to_remove;
-
-  for (auto&& name : all_primitive_names_)
+  std::lock_guard<std::mutex> lock(structure_mutex_);
+  NameIndex::iterator it = name_index_.begin();
+  while (it != name_index_.end())
   {
-    std::string dependencies = getDependenciesAsString(name);
+    std::string dependencies = getDependenciesAsString(it->second);
     if (dependencies.size() > 0)
     {
-      printHiqpWarning("Geometric primitive '" + name + 
+      printHiqpWarning("Geometric primitive '" + it->first + 
           "' has the following dependencies: " + dependencies + 
           " and could not be deleted. Remove the dependencies first!");
+      ++it;
     }
     else
     {
-      names_to_remove.push_back(name);
+      erasePrimitive(it->second);
+      it = name_index_.erase(it);
     }
   }
 
-  for (auto&& name : names_to_remove)
-  {
-    point_map_.erase(name);
-    line_map_.erase(name);
-    plane_map_.erase(name);
-    box_map_.erase(name);
-    cylinder_map_.erase(name);
-    sphere_map_.erase(name);
-    frame_map_.erase(name);
-    dependency_map_.erase(name);
-
-    all_primitive_names_.erase(
-      std::remove(all_primitive_names_.begin(), all_primitive_names_.end(), name), 
-      all_primitive_names_.end()
-    );
-  }
-
   return 0;
 }
 
@@ -219,26 +140,39 @@ int GeometricPrimitiveMap::clear
 
 
 
+GeometricPrimitiveHandle GeometricPrimitiveMap::getHandle
+(
+  const std::string& name
+) const
+{
+  NameIndex::const_iterator it = name_index_.find(name);
+  if (it == name_index_.end())
+    return GeometricPrimitiveHandle();
+  return it->second.handle_;
+}
+
+
+
+
+
 void GeometricPrimitiveMap::addDependencyToPrimitive
 (
   const std::string& primitive_name, 
   const std::string& dependency_name
 )
 {
-  DependencyMap::iterator it = dependency_map_.find(primitive_name);
+  NameIndex::iterator it = name_index_.find(primitive_name);
 
-  if (it == dependency_map_.end())
+  if (it == name_index_.end())
   {
     printHiqpWarning("Trying to add dependency to geometric primitive '" 
       + primitive_name + "'. No such primitive found. No dependency was added!");
+    return;
   }
 
-  std::vector<std::string>::iterator it2 = std::find(
-    it->second.begin(), it->second.end(), dependency_name
-  );
-
-  if (it2 == it->second.end())
-    it->second.push_back(dependency_name);
+  std::vector<std::string>& dependencies = it->second.dependencies_;
+  if (std::find(dependencies.begin(), dependencies.end(), dependency_name) == dependencies.end())
+    dependencies.push_back(dependency_name);
 }
 
 
@@ -250,196 +184,90 @@ void GeometricPrimitiveMap::removeDependency
   const std::string& dependency_name
 )
 {
-  for (auto&& kv : dependency_map_)
+  for (auto&& kv : name_index_)
   {
-    kv.second.erase(std::remove(kv.second.begin(), kv.second.end(), dependency_name),
-                    kv.second.end());
+    std::vector<std::string>& dependencies = kv.second.dependencies_;
+    dependencies.erase(std::remove(dependencies.begin(), dependencies.end(), dependency_name),
+                       dependencies.end());
   }
-
-  // DependencyMap::iterator it = dependency_map_.begin();
-  // while (it != dependency_map_.end())
-  // {
-  //   it->second.erase(
-  //     std::remove(
-  //       it->second.begin(), 
-  //       it->second.end(), 
-  //       dependency_name)
-  //     , 
-  //     it->second.end()
-  //     );
-
-  //   ++it;
-  // }
 }
 
 
 
 
 
-void GeometricPrimitiveMap::acceptVisitor(GeometricPrimitiveVisitor& visitor, 
-                                          const std::string& primitive_name) {
-  if (primitive_name.compare("") == 0) {
-    for (auto&& kv : point_map_) visitor.visit(kv.second);
-    for (auto&& kv : line_map_) visitor.visit(kv.second);
-    for (auto&& kv : plane_map_) visitor.visit(kv.second);
-    for (auto&& kv : box_map_) visitor.visit(kv.second);
-    for (auto&& kv : cylinder_map_) visitor.visit(kv.second);
-    for (auto&& kv : sphere_map_) visitor.visit(kv.second);
-    for (auto&& kv : frame_map_) visitor.visit(kv.second);
-  } else {
-    if (std::find(all_primitive_names_.begin(), all_primitive_names_.end(), primitive_name) 
-          != all_primitive_names_.end()) {
-      {
-        PointMap::iterator it = point_map_.find(primitive_name);
-        if (it != point_map_.end()) visitor.visit(it->second);
-      }
-      {
-        LineMap::iterator it = line_map_.find(primitive_name);
-        if (it != line_map_.end()) visitor.visit(it->second);
-      }
-      {
-        PlaneMap::iterator it = plane_map_.find(primitive_name);
-        if (it != plane_map_.end()) visitor.visit(it->second);
-      }
-      {
-        BoxMap::iterator it = box_map_.find(primitive_name);
-        if (it != box_map_.end()) visitor.visit(it->second);
-      }
-      {
-        CylinderMap::iterator it = cylinder_map_.find(primitive_name);
-        if (it != cylinder_map_.end()) visitor.visit(it->second);
-      }
-      {
-        SphereMap::iterator it = sphere_map_.find(primitive_name);
-        if (it != sphere_map_.end()) visitor.visit(it->second);
-      }
-      {
-        FrameMap::iterator it = frame_map_.find(primitive_name);
-        if (it != frame_map_.end()) visitor.visit(it->second);
-      }
-    }
-  }
-}
-
-
-
-
-////////////////////////////////////////////////////////////////////////////////
-//  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -
-// -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -
-//-  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  
-////////////////////////////////////////////////////////////////////////////////
-//
-//              G E T   G E O M E T R I C   P R I M I T I V E
-//
-////////////////////////////////////////////////////////////////////////////////
-
-template<>
-std::shared_ptr<GeometricPoint>
-GeometricPrimitiveMap::getGeometricPrimitive<GeometricPoint>
-(
-  const std::string& name
-)
-{
-  PointMap::iterator it = point_map_.find(name);
-  if (it  == point_map_.end())   return nullptr;
-  else                           return it->second;
-}
-
-
-
-
-
-template<>
-std::shared_ptr<GeometricLine>
-GeometricPrimitiveMap::getGeometricPrimitive<GeometricLine>
-(
-  const std::string& name
-)
-{
-  LineMap::iterator it = line_map_.find(name);
-  if (it  == line_map_.end())   return nullptr;
-  else                          return it->second;
-}
-
-
-
-
-
-template<>
-std::shared_ptr<GeometricPlane>
-GeometricPrimitiveMap::getGeometricPrimitive<GeometricPlane>
-(
-  const std::string& name
-)
-{
-  PlaneMap::iterator it = plane_map_.find(name);
-  if (it  == plane_map_.end())   return nullptr;
-  else                           return it->second;
-}
-
-
-
-
-
-template<>
-std::shared_ptr<GeometricBox>
-GeometricPrimitiveMap::getGeometricPrimitive<GeometricBox>
-(
-  const std::string& name
-)
-{
-  BoxMap::iterator it = box_map_.find(name);
-  if (it  == box_map_.end())     return nullptr;
-  else                           return it->second;
-}
-
-
-
+unsigned int GeometricPrimitiveMap::applyPublishedParameters() {
+  unsigned int n_updated = 0;
+  GeometricPrimitiveHandle handle;
 
+  // The flag is cleared before the parameters are read, so that parameters
+  // published meanwhile queue the primitive again
+  if (update_queue_overflow_.exchange(false)) {
+    while (update_queue_.pop(handle)) {}
+    for (auto&& primitive : getSlotMap<GeometricPoint>().getPrimitives()) { primitive->setUpdateQueued(false); n_updated += primitive->applyPublishedParameters(); }
+    for (auto&& primitive : getSlotMap<GeometricLine>().getPrimitives()) { primitive->setUpdateQueued(false); n_updated += primitive->applyPublishedParameters(); }
+    for (auto&& primitive : getSlotMap<GeometricPlane>().getPrimitives()) { primitive->setUpdateQueued(false); n_updated += primitive->applyPublishedParameters(); }
+    for (auto&& primitive : getSlotMap<GeometricBox>().getPrimitives()) { primitive->setUpdateQueued(false); n_updated += primitive->applyPublishedParameters(); }
+    for (auto&& primitive : getSlotMap<GeometricCylinder>().getPrimitives()) { primitive->setUpdateQueued(false); n_updated += primitive->applyPublishedParameters(); }
+    for (auto&& primitive : getSlotMap<GeometricSphere>().getPrimitives()) { primitive->setUpdateQueued(false); n_updated += primitive->applyPublishedParameters(); }
+    for (auto&& primitive : getSlotMap<GeometricFrame>().getPrimitives()) { primitive->setUpdateQueued(false); n_updated += primitive->applyPublishedParameters(); }
+    for (auto&& primitive : getSlotMap<GeometricCapsule>().getPrimitives()) { primitive->setUpdateQueued(false); n_updated += primitive->applyPublishedParameters(); }
+    for (auto&& primitive : getSlotMap<GeometricSDF>().getPrimitives()) { primitive->setUpdateQueued(false); n_updated += primitive->applyPublishedParameters(); }
+    return n_updated;
+  }
 
-template<>
-std::shared_ptr<GeometricCylinder>
-GeometricPrimitiveMap::getGeometricPrimitive<GeometricCylinder>
-(
-  const std::string& name
-)
-{
-  CylinderMap::iterator it = cylinder_map_.find(name);
-  if (it  == cylinder_map_.end())     return nullptr;
-  else                                return it->second;
+  while (update_queue_.pop(handle)) {
+    GeometricPrimitive* primitive = findPrimitive(handle);
+    if (!primitive)
+      continue;
+    primitive->setUpdateQueued(false);
+    n_updated += primitive->applyPublishedParameters();
+  }
+  return n_updated;
 }
 
 
 
 
 
-template<>
-std::shared_ptr<GeometricSphere>
-GeometricPrimitiveMap::getGeometricPrimitive<GeometricSphere>
-(
-  const std::string& name
-)
-{
-  SphereMap::iterator it = sphere_map_.find(name);
-  if (it  == sphere_map_.end())       return nullptr;
-  else                                return it->second;
-}
-
-
-
-
+void GeometricPrimitiveMap::acceptVisitor(GeometricPrimitiveVisitor& visitor, 
+                                          const std::string& primitive_name) {
+  if (primitive_name.compare("") == 0) {
+    for (auto&& primitive : getSlotMap<GeometricPoint>().getPrimitives()) visitor.visit(primitive);
+    for (auto&& primitive : getSlotMap<GeometricLine>().getPrimitives()) visitor.visit(primitive);
+    for (auto&& primitive : getSlotMap<GeometricPlane>().getPrimitives()) visitor.visit(primitive);
+    for (auto&& primitive : getSlotMap<GeometricBox>().getPrimitives()) visitor.visit(primitive);
+    for (auto&& primitive : getSlotMap<GeometricCylinder>().getPrimitives()) visitor.visit(primitive);
+    for (auto&& primitive : getSlotMap<GeometricSphere>().getPrimitives()) visitor.visit(primitive);
+    for (auto&& primitive : getSlotMap<GeometricFrame>().getPrimitives()) visitor.visit(primitive);
+    for (auto&& primitive : getSlotMap<GeometricCapsule>().getPrimitives()) visitor.visit(primitive);
+    for (auto&& primitive : getSlotMap<GeometricSDF>().getPrimitives()) visitor.visit(primitive);
+    return;
+  }
 
-template<>
-std::shared_ptr<GeometricFrame>
-GeometricPrimitiveMap::getGeometricPrimitive<GeometricFrame>
-(
-  const std::string& name
-)
-{
-  FrameMap::iterator it = frame_map_.find(name);
-  if (it  == frame_map_.end())        return nullptr;
-  else                                return it->second;
+  GeometricPrimitiveHandle handle = getHandle(primitive_name);
+  switch (handle.type_) {
+    case PrimitiveTypeIndex<GeometricPoint>::value:
+      visitor.visit(getGeometricPrimitive<GeometricPoint>(handle)); break;
+    case PrimitiveTypeIndex<GeometricLine>::value:
+      visitor.visit(getGeometricPrimitive<GeometricLine>(handle)); break;
+    case PrimitiveTypeIndex<GeometricPlane>::value:
+      visitor.visit(getGeometricPrimitive<GeometricPlane>(handle)); break;
+    case PrimitiveTypeIndex<GeometricBox>::value:
+      visitor.visit(getGeometricPrimitive<GeometricBox>(handle)); break;
+    case PrimitiveTypeIndex<GeometricCylinder>::value:
+      visitor.visit(getGeometricPrimitive<GeometricCylinder>(handle)); break;
+    case PrimitiveTypeIndex<GeometricSphere>::value:
+      visitor.visit(getGeometricPrimitive<GeometricSphere>(handle)); break;
+    case PrimitiveTypeIndex<GeometricFrame>::value:
+      visitor.visit(getGeometricPrimitive<GeometricFrame>(handle)); break;
+    case PrimitiveTypeIndex<GeometricCapsule>::value:
+      visitor.visit(getGeometricPrimitive<GeometricCapsule>(handle)); break;
+    case PrimitiveTypeIndex<GeometricSDF>::value:
+      visitor.visit(getGeometricPrimitive<GeometricSDF>(handle)); break;
+    default:
+      break;
+  }
 }
 
 
@@ -452,186 +280,192 @@ GeometricPrimitiveMap::getGeometricPrimitive<GeometricFrame>
 //-  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  
 ////////////////////////////////////////////////////////////////////////////////
 //
-//             U P D A T E   G E O M E T R I C   P R I M I T I V E 
+//                              P R I V A T E
 //
 ////////////////////////////////////////////////////////////////////////////////
 
-template<>
-void GeometricPrimitiveMap::updateGeometricPrimitive<GeometricPoint>
-(
-  const std::string& name, 
-  const std::vector<double>& parameters
-)
-{
-  PointMap::iterator it = point_map_.find(name);
-  if (it == point_map_.end()) 
-  {
-    printHiqpWarning("Couldn't update GeometricPoint with name '" + 
-      name + "'. The point was not found!");
-    return;
-  }
-  it->second->init(parameters);
-}
-
-
-
-
-
-template<>
-void GeometricPrimitiveMap::updateGeometricPrimitive<GeometricLine>
+void GeometricPrimitiveMap::erasePrimitive
 (
-  const std::string& name, 
-  const std::vector<double>& parameters
+  const PrimitiveEntry& entry
 )
 {
-  LineMap::iterator it = line_map_.find(name);
-  if (it == line_map_.end()) 
-  {
-    printHiqpWarning("Couldn't update GeometricLine with name '" + 
-      name + "'. The line was not found!");
-    return;
+  const GeometricPrimitiveHandle& handle = entry.handle_;
+  switch (handle.type_) {
+    case PrimitiveTypeIndex<GeometricPoint>::value:
+      getSlotMap<GeometricPoint>().erase(handle.slot_); break;
+    case PrimitiveTypeIndex<GeometricLine>::value:
+      getSlotMap<GeometricLine>().erase(handle.slot_); break;
+    case PrimitiveTypeIndex<GeometricPlane>::value:
+      getSlotMap<GeometricPlane>().erase(handle.slot_); break;
+    case PrimitiveTypeIndex<GeometricBox>::value:
+      getSlotMap<GeometricBox>().erase(handle.slot_); break;
+    case PrimitiveTypeIndex<GeometricCylinder>::value:
+      getSlotMap<GeometricCylinder>().erase(handle.slot_); break;
+    case PrimitiveTypeIndex<GeometricSphere>::value:
+      getSlotMap<GeometricSphere>().erase(handle.slot_); break;
+    case PrimitiveTypeIndex<GeometricFrame>::value:
+      getSlotMap<GeometricFrame>().erase(handle.slot_); break;
+    case PrimitiveTypeIndex<GeometricCapsule>::value:
+      getSlotMap<GeometricCapsule>().erase(handle.slot_); break;
+    case PrimitiveTypeIndex<GeometricSDF>::value:
+      getSlotMap<GeometricSDF>().erase(handle.slot_); break;
+    default:
+      break;
   }
-  it->second->init(parameters);
 }
 
 
 
 
 
-template<>
-void GeometricPrimitiveMap::updateGeometricPrimitive<GeometricPlane>
+std::shared_ptr<GeometricPrimitive> GeometricPrimitiveMap::getAnyGeometricPrimitive
 (
-  const std::string& name, 
-  const std::vector<double>& parameters
+  const std::string& name
 )
 {
-  PlaneMap::iterator it = plane_map_.find(name);
-  if (it == plane_map_.end()) 
-  {
-    printHiqpWarning("Couldn't update GeometricPlane with name '" + 
-      name + "'. The plane was not found!");
-    return;
+  GeometricPrimitiveHandle handle = getHandle(name);
+  switch (handle.type_) {
+    case PrimitiveTypeIndex<GeometricPoint>::value:
+      return getGeometricPrimitive<GeometricPoint>(handle);
+    case PrimitiveTypeIndex<GeometricLine>::value:
+      return getGeometricPrimitive<GeometricLine>(handle);
+    case PrimitiveTypeIndex<GeometricPlane>::value:
+      return getGeometricPrimitive<GeometricPlane>(handle);
+    case PrimitiveTypeIndex<GeometricBox>::value:
+      return getGeometricPrimitive<GeometricBox>(handle);
+    case PrimitiveTypeIndex<GeometricCylinder>::value:
+      return getGeometricPrimitive<GeometricCylinder>(handle);
+    case PrimitiveTypeIndex<GeometricSphere>::value:
+      return getGeometricPrimitive<GeometricSphere>(handle);
+    case PrimitiveTypeIndex<GeometricFrame>::value:
+      return getGeometricPrimitive<GeometricFrame>(handle);
+    case PrimitiveTypeIndex<GeometricCapsule>::value:
+      return getGeometricPrimitive<GeometricCapsule>(handle);
+    case PrimitiveTypeIndex<GeometricSDF>::value:
+      return getGeometricPrimitive<GeometricSDF>(handle);
+    default:
+      return nullptr;
   }
-  it->second->init(parameters);
 }
 
 
 
 
 
-template<>
-void GeometricPrimitiveMap::updateGeometricPrimitive<GeometricBox>
+GeometricPrimitive* GeometricPrimitiveMap::findPrimitive
 (
-  const std::string& name, 
-  const std::vector<double>& parameters
+  const GeometricPrimitiveHandle& handle
 )
 {
-  BoxMap::iterator it = box_map_.find(name);
-  if (it == box_map_.end()) 
-  {
-    printHiqpWarning("Couldn't update GeometricBox with name '" + 
-      name + "'. The box was not found!");
-    return;
+  switch (handle.type_) {
+    case PrimitiveTypeIndex<GeometricPoint>::value:
+      return getSlotMap<GeometricPoint>().find(handle.slot_, handle.generation_);
+    case PrimitiveTypeIndex<GeometricLine>::value:
+      return getSlotMap<GeometricLine>().find(handle.slot_, handle.generation_);
+    case PrimitiveTypeIndex<GeometricPlane>::value:
+      return getSlotMap<GeometricPlane>().find(handle.slot_, handle.generation_);
+    case PrimitiveTypeIndex<GeometricBox>::value:
+      return getSlotMap<GeometricBox>().find(handle.slot_, handle.generation_);
+    case PrimitiveTypeIndex<GeometricCylinder>::value:
+      return getSlotMap<GeometricCylinder>().find(handle.slot_, handle.generation_);
+    case PrimitiveTypeIndex<GeometricSphere>::value:
+      return getSlotMap<GeometricSphere>().find(handle.slot_, handle.generation_);
+    case PrimitiveTypeIndex<GeometricFrame>::value:
+      return getSlotMap<GeometricFrame>().find(handle.slot_, handle.generation_);
+    case PrimitiveTypeIndex<GeometricCapsule>::value:
+      return getSlotMap<GeometricCapsule>().find(handle.slot_, handle.generation_);
+    case PrimitiveTypeIndex<GeometricSDF>::value:
+      return getSlotMap<GeometricSDF>().find(handle.slot_, handle.generation_);
+    default:
+      return nullptr;
   }
-  it->second->init(parameters);
 }
 
 
 
 
 
-template<>
-void GeometricPrimitiveMap::updateGeometricPrimitive<GeometricCylinder>
+GeometricPrimitiveMap::HandleQueue::HandleQueue
 (
-  const std::string& name, 
-  const std::vector<double>& parameters
+  unsigned int capacity
 )
+: cells_(new Cell[capacity]), mask_(capacity - 1), push_position_(0), pop_position_(0)
 {
-  CylinderMap::iterator it = cylinder_map_.find(name);
-  if (it == cylinder_map_.end()) 
-  {
-    printHiqpWarning("Couldn't update GeometricCylinder with name '" + 
-      name + "'. The cylinder was not found!");
-    return;
-  }
-  it->second->init(parameters);
+  for (unsigned int i = 0; i < capacity; ++i)
+    cells_[i].sequence_.store(i, std::memory_order_relaxed);
 }
 
 
 
 
 
-template<>
-void GeometricPrimitiveMap::updateGeometricPrimitive<GeometricSphere>
+bool GeometricPrimitiveMap::HandleQueue::push
 (
-  const std::string& name, 
-  const std::vector<double>& parameters
+  const GeometricPrimitiveHandle& handle
 )
 {
-  SphereMap::iterator it = sphere_map_.find(name);
-  if (it == sphere_map_.end()) 
+  unsigned long position = push_position_.load(std::memory_order_relaxed);
+  Cell* cell;
+  while (true)
   {
-    printHiqpWarning("Couldn't update GeometricSphere with name '" + 
-      name + "'. The sphere was not found!");
-    return;
+    cell = &cells_[position & mask_];
+    unsigned long sequence = cell->sequence_.load(std::memory_order_acquire);
+    long diff = static_cast<long>(sequence) - static_cast<long>(position);
+    if (diff == 0)
+    {
+      if (push_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0)
+    {
+      return false;
+    }
+    else
+    {
+      position = push_position_.load(std::memory_order_relaxed);
+    }
   }
-  it->second->init(parameters);
+  cell->handle_ = handle;
+  cell->sequence_.store(position + 1, std::memory_order_release);
+  return true;
 }
 
 
 
 
 
-template<>
-void GeometricPrimitiveMap::updateGeometricPrimitive<GeometricFrame>
+bool GeometricPrimitiveMap::HandleQueue::pop
 (
-  const std::string& name, 
-  const std::vector<double>& parameters
+  GeometricPrimitiveHandle& handle
 )
 {
-  FrameMap::iterator it = frame_map_.find(name);
-  if (it == frame_map_.end()) 
-  {
-    printHiqpWarning("Couldn't update GeometricSphere with name '" + 
-      name + "'. The sphere was not found!");
-    return;
-  }
-  it->second->init(parameters);
+  Cell* cell = &cells_[pop_position_ & mask_];
+  unsigned long sequence = cell->sequence_.load(std::memory_order_acquire);
+  if (sequence != pop_position_ + 1)
+    return false;
+  handle = cell->handle_;
+  cell->sequence_.store(pop_position_ + mask_ + 1, std::memory_order_release);
+  ++pop_position_;
+  return true;
 }
 
 
 
 
 
-
-////////////////////////////////////////////////////////////////////////////////
-//  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -
-// -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -
-//-  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  
-////////////////////////////////////////////////////////////////////////////////
-//
-//                              P R I V A T E
-//
-////////////////////////////////////////////////////////////////////////////////
-
 std::string GeometricPrimitiveMap::getDependenciesAsString
 (
-  std::string name
+  const PrimitiveEntry& entry
 )
 {
-  DependencyMap::iterator it = dependency_map_.find(name);
-  if (it != dependency_map_.end())
-  {
-    if (!it->second.empty())
-    {
-      std::stringstream ss;
-      std::copy(it->second.begin(), it->second.end(),
-        std::ostream_iterator< std::string >(ss, ", ")
-      );
-      return ss.str();
-    }
-  }
-  return std::string();
+  if (entry.dependencies_.empty())
+    return std::string();
+
+  std::stringstream ss;
+  std::copy(entry.dependencies_.begin(), entry.dependencies_.end(),
+    std::ostream_iterator< std::string >(ss, ", ")
+  );
+  return ss.str();
 }
 
 
@@ -639,5 +473,3 @@ std::string GeometricPrimitiveMap::getDependenciesAsString
 } // namespace geometric_primitives
 
 } // namespace hiqp
-
-
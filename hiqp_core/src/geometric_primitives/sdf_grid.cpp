@@ -0,0 +1,211 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <hiqp/geometric_primitives/sdf_grid.h>
+#include <hiqp/utilities.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HEADER_MAGIC     "HIQPSDF1"
+#define HEADER_SIZE      56 // bytes
+#define DEFAULT_DIRECTORY "."
+
+namespace hiqp
+{
+namespace geometric_primitives
+{
+
+namespace
+{
+  std::mutex grid_directory_mutex;
+  std::string grid_directory = DEFAULT_DIRECTORY;
+}
+
+SDFGrid::SDFGrid()
+: mapping_(nullptr), mapping_size_(0), distances_(nullptr), nx_(0), ny_(0), nz_(0), voxel_size_(0) {}
+
+SDFGrid::~SDFGrid() noexcept {
+  unload();
+}
+
+
+
+
+
+void SDFGrid::setDirectory(const std::string& directory) {
+  std::lock_guard<std::mutex> lock(grid_directory_mutex);
+  grid_directory = directory;
+}
+
+std::string SDFGrid::getDirectory() {
+  std::lock_guard<std::mutex> lock(grid_directory_mutex);
+  return grid_directory;
+}
+
+
+
+
+
+void SDFGrid::unload() {
+  if (mapping_ != nullptr)
+    munmap(mapping_, mapping_size_);
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+  distances_ = nullptr;
+  surface_samples_.clear();
+}
+
+
+
+
+
+int SDFGrid::load(const std::string& path) {
+  unload();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    printHiqpWarning("SDFGrid couldn't open the grid file '" + path + "'!");
+    return -1;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size < HEADER_SIZE) {
+    close(fd);
+    printHiqpWarning("SDFGrid: the grid file '" + path + "' has no valid header!");
+    return -2;
+  }
+
+  // The mapping stays valid after the file is closed
+  std::size_t size = file_stat.st_size;
+  void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    printHiqpWarning("SDFGrid couldn't map the grid file '" + path + "'!");
+    return -1;
+  }
+
+  const char* data = static_cast<const char*>(mapping);
+  uint32_t n[3];
+  double origin[3];
+  double voxel_size;
+  std::memcpy(n, data + 8, sizeof(n));
+  std::memcpy(origin, data + 24, sizeof(origin));
+  std::memcpy(&voxel_size, data + 48, sizeof(voxel_size));
+
+  std::size_t n_samples = std::size_t(n[0]) * n[1] * n[2];
+  if (std::memcmp(data, HEADER_MAGIC, 8) != 0 || 
+      n[0] < 2 || n[1] < 2 || n[2] < 2 || !(voxel_size > 0) ||
+      size != HEADER_SIZE + n_samples * sizeof(float)) {
+    munmap(mapping, size);
+    printHiqpWarning("SDFGrid: the grid file '" + path + "' has an invalid header or size!");
+    return -2;
+  }
+
+  mapping_ = mapping;
+  mapping_size_ = size;
+  distances_ = reinterpret_cast<const float*>(data + HEADER_SIZE);
+  nx_ = n[0];
+  ny_ = n[1];
+  nz_ = n[2];
+  origin_ << origin[0], origin[1], origin[2];
+  voxel_size_ = voxel_size;
+  bounds_ = Eigen::AlignedBox3d(origin_, origin_ + voxel_size_ * Eigen::Vector3d(nx_ - 1, ny_ - 1, nz_ - 1));
+
+  for (unsigned int k = 0; k < nz_; ++k) {
+    for (unsigned int j = 0; j < ny_; ++j) {
+      for (unsigned int i = 0; i < nx_; ++i) {
+        double d = sample(i, j, k);
+        if (d <= 0 && d > -voxel_size_)
+          surface_samples_.push_back(origin_ + voxel_size_ * Eigen::Vector3d(i, j, k));
+      }
+    }
+  }
+  return 0;
+}
+
+
+
+
+
+double SDFGrid::getDistance(const Eigen::Vector3d& p, Eigen::Vector3d& gradient) const {
+  // Outside the grid the field is extended from the closest point on it
+  Eigen::Vector3d q = p.cwiseMax(bounds_.min()).cwiseMin(bounds_.max());
+  Eigen::Vector3d outside = p - q;
+  double outside_distance = outside.norm();
+
+  // The voxel of q and the position of q within it
+  Eigen::Vector3d u = (q - origin_) / voxel_size_;
+  const unsigned int n[3] = {nx_, ny_, nz_};
+  unsigned int c[3];
+  double t[3];
+  for (int k = 0; k < 3; ++k) {
+    double f = std::floor(u(k));
+    c[k] = static_cast<unsigned int>(f < 0 ? 0 : f);
+    if (c[k] > n[k] - 2)
+      c[k] = n[k] - 2;
+    t[k] = u(k) - c[k];
+  }
+
+  double d000 = sample(c[0],   c[1],   c[2]);
+  double d100 = sample(c[0]+1, c[1],   c[2]);
+  double d010 = sample(c[0],   c[1]+1, c[2]);
+  double d110 = sample(c[0]+1, c[1]+1, c[2]);
+  double d001 = sample(c[0],   c[1],   c[2]+1);
+  double d101 = sample(c[0]+1, c[1],   c[2]+1);
+  double d011 = sample(c[0],   c[1]+1, c[2]+1);
+  double d111 = sample(c[0]+1, c[1]+1, c[2]+1);
+
+  // Interpolate along x, then y, then z
+  double d00 = d000 + t[0] * (d100 - d000);
+  double d10 = d010 + t[0] * (d110 - d010);
+  double d01 = d001 + t[0] * (d101 - d001);
+  double d11 = d011 + t[0] * (d111 - d011);
+  double d0 = d00 + t[1] * (d10 - d00);
+  double d1 = d01 + t[1] * (d11 - d01);
+  double d = d0 + t[2] * (d1 - d0);
+
+  double gx0 = (d100 - d000) + t[1] * ((d110 - d010) - (d100 - d000));
+  double gx1 = (d101 - d001) + t[1] * ((d111 - d011) - (d101 - d001));
+  double gy0 = (d10 - d00);
+  double gy1 = (d11 - d01);
+  gradient(0) = (gx0 + t[2] * (gx1 - gx0)) / voxel_size_;
+  gradient(1) = (gy0 + t[2] * (gy1 - gy0)) / voxel_size_;
+  gradient(2) = (d1 - d0) / voxel_size_;
+
+  // The closest point on the grid only follows p along the axes it is not
+  // clamped in
+  if (outside_distance > 0) {
+    for (int k = 0; k < 3; ++k) {
+      if (outside(k) != 0)
+        gradient(k) = outside(k) / outside_distance;
+    }
+    return d + outside_distance;
+  }
+  return d;
+}
+
+} // namespace geometric_primitives
+
+} // namespace hiqp
@@ -0,0 +1,72 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <hiqp/geometric_primitives/segment_distance.h>
+
+#include <algorithm>
+
+#define PARALLEL_TOLERANCE  1e-12 // squared sine of the angle below which segments are treated as parallel
+#define MIN_SQUARED_LENGTH  1e-24 // squared length below which a direction is treated as zero
+
+namespace hiqp
+{
+namespace geometric_primitives
+{
+
+inline double clamp(double x, double lo, double hi) {
+  return std::min(std::max(x, lo), hi);
+}
+
+double closestSegmentPoints
+(
+  const KDL::Vector& p1, const KDL::Vector& d1, double s1_min, double s1_max,
+  const KDL::Vector& p2, const KDL::Vector& d2, double s2_min, double s2_max,
+  KDL::Vector& c1,
+  KDL::Vector& c2
+)
+{
+  KDL::Vector r = p1 - p2;
+  double a = KDL::dot(d1, d1);
+  double e = KDL::dot(d2, d2);
+  double b = KDL::dot(d1, d2);
+  double c = KDL::dot(d1, r);
+  double f = KDL::dot(d2, r);
+
+  // The closest point of the first segment to the second line, any point of
+  // the first segment will do if the lines are parallel
+  double s = 0;
+  double denom = a*e - b*b;
+  if (denom > PARALLEL_TOLERANCE * a * e + MIN_SQUARED_LENGTH * MIN_SQUARED_LENGTH)
+    s = (b*f - c*e) / denom;
+  s = clamp(s, s1_min, s1_max);
+
+  // The point of the second segment closest to that, and the point of the
+  // first segment closest to the clamped one (Ericson, Real-Time Collision
+  // Detection, 5.1.9)
+  double t = (b*s + f) / std::max(e, MIN_SQUARED_LENGTH);
+  t = clamp(t, s2_min, s2_max);
+  s = clamp((b*t - c) / std::max(a, MIN_SQUARED_LENGTH), s1_min, s1_max);
+
+  c1 = p1 + s * d1;
+  c2 = p2 + t * d2;
+  KDL::Vector w = c1 - c2;
+  return KDL::dot(w, w);
+}
+
+} // namespace geometric_primitives
+
+} // namespace hiqp
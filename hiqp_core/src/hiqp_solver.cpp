@@ -0,0 +1,282 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <hiqp/hiqp_solver.h>
+
+#include <algorithm>
+
+#define NULL_SPACE_TIKHONOV_FACTOR  5*1e-5 // same regularization as in the QP backends
+#define NULL_SPACE_RANK_THRESHOLD   1e-9 // relative to the norm of the unprojected rows
+#define NULL_SPACE_FEASIBILITY_TOL  1e-6
+#define ROW_COMPRESSION_RANK_THRESHOLD  1e-9
+
+namespace hiqp
+{
+
+  void HiQPSolver::finalizeSparseStage(HiQPStage& stage) {
+    Eigen::SparseMatrix<double, Eigen::RowMajor>& J = stage.J_sparse_;
+    const int n_rows = stage.nRows;
+    const int nnz = stage.support_inner_.size();
+
+    bool same_pattern = (J.rows() == n_rows && J.cols() == stage.J_.cols() &&
+                         J.isCompressed() && J.nonZeros() == nnz &&
+                         std::equal(stage.support_outer_.begin(), stage.support_outer_.end(), J.outerIndexPtr()) &&
+                         std::equal(stage.support_inner_.begin(), stage.support_inner_.end(), J.innerIndexPtr()));
+    if (!same_pattern) {
+      J.resize(n_rows, stage.J_.cols());
+      J.resizeNonZeros(nnz);
+      std::copy(stage.support_outer_.begin(), stage.support_outer_.end(), J.outerIndexPtr());
+      std::copy(stage.support_inner_.begin(), stage.support_inner_.end(), J.innerIndexPtr());
+    }
+
+    stage.bound_cols_.resize(n_rows);
+    double* values = J.valuePtr();
+    for (int i = 0; i < n_rows; ++i) {
+      int col = -1;
+      bool single = true;
+      for (int k = stage.support_outer_[i]; k < stage.support_outer_[i+1]; ++k) {
+        int j = stage.support_inner_[k];
+        values[k] = stage.J_(i, j);
+        if (values[k] == 0.0)
+          continue;
+        if (col != -1)
+          single = false;
+        col = j;
+      }
+      stage.bound_cols_[i] = (single ? col : -1);
+    }
+  }
+
+  void HiQPSolver::compressStage(HiQPStage& stage, bool sparse) {
+    const int n_rows = stage.nRows;
+    const int n_cols = stage.J_.cols();
+
+    int n_eq = std::count(stage.constraint_signs_.begin(), stage.constraint_signs_.end(), 0);
+    if (n_eq < 2)
+      return;
+
+    stage.J_eq_.resize(n_eq, n_cols);
+    stage.e_dot_star_eq_.resize(n_eq);
+    for (int i = 0, k = 0; i < n_rows; ++i) {
+      if (stage.constraint_signs_[i] != 0)
+        continue;
+      stage.J_eq_.row(k) = stage.J_.row(i);
+      stage.e_dot_star_eq_(k++) = stage.e_dot_star_(i);
+    }
+
+    stage.eq_qr_.setThreshold(ROW_COMPRESSION_RANK_THRESHOLD);
+    stage.eq_qr_.compute(stage.J_eq_);
+    const int rank = stage.eq_qr_.rank();
+    if (rank == n_eq)
+      return;
+
+    // |J*dq - de*|^2 = |Q1'*J*dq - Q1'*de*|^2 + |Q2'*de*|^2, where the rows of Q2'*J are zero
+    stage.J_eq_.applyOnTheLeft(stage.eq_qr_.householderQ().transpose());
+    stage.e_dot_star_eq_.applyOnTheLeft(stage.eq_qr_.householderQ().transpose());
+
+    // The appended rows are kept, and the compressed ones written to the
+    // storage they were kept in during the last cycle
+    stage.J_.swap(stage.J_original_);
+    stage.e_dot_star_.swap(stage.e_dot_star_original_);
+    stage.constraint_signs_.swap(stage.constraint_signs_original_);
+    stage.compressed_ = true;
+
+    const int n_compressed = rank + n_rows - n_eq;
+    stage.J_.resize(n_compressed, n_cols);
+    stage.e_dot_star_.resize(n_compressed);
+    stage.constraint_signs_.assign(rank, 0);
+
+    stage.J_.topRows(rank) = stage.J_eq_.topRows(rank);
+    stage.e_dot_star_.head(rank) = stage.e_dot_star_eq_.head(rank);
+    for (int i = 0, k = rank; i < n_rows; ++i) {
+      int sign = stage.constraint_signs_original_[i];
+      if (sign == 0)
+        continue;
+      stage.J_.row(k) = stage.J_original_.row(i);
+      stage.e_dot_star_(k++) = stage.e_dot_star_original_(i);
+      stage.constraint_signs_.push_back(sign);
+    }
+    stage.nRows = n_compressed;
+
+    if (!sparse)
+      return;
+
+    stage.support_outer_.swap(stage.support_outer_original_);
+    stage.support_inner_.swap(stage.support_inner_original_);
+    const std::vector<int>& outer = stage.support_outer_original_;
+    const std::vector<int>& inner = stage.support_inner_original_;
+
+    // The union of the supports of the equality rows, for each compressed row
+    stage.support_inner_.clear();
+    for (int i = 0; i < n_rows; ++i) {
+      if (stage.constraint_signs_original_[i] == 0)
+        stage.support_inner_.insert(stage.support_inner_.end(), inner.begin() + outer[i], inner.begin() + outer[i+1]);
+    }
+    std::sort(stage.support_inner_.begin(), stage.support_inner_.end());
+    stage.support_inner_.erase(std::unique(stage.support_inner_.begin(), stage.support_inner_.end()),
+                               stage.support_inner_.end());
+    const int n_union = stage.support_inner_.size();
+    stage.support_inner_.reserve(rank * n_union + inner.size());
+
+    stage.support_outer_.assign(1, 0);
+    stage.support_outer_.push_back(n_union);
+    for (int k = 1; k < rank; ++k) {
+      for (int j = 0; j < n_union; ++j)
+        stage.support_inner_.push_back(stage.support_inner_[j]);
+      stage.support_outer_.push_back(stage.support_inner_.size());
+    }
+    for (int i = 0; i < n_rows; ++i) {
+      if (stage.constraint_signs_original_[i] == 0)
+        continue;
+      stage.support_inner_.insert(stage.support_inner_.end(), inner.begin() + outer[i], inner.begin() + outer[i+1]);
+      stage.support_outer_.push_back(stage.support_inner_.size());
+    }
+  }
+
+  int HiQPSolver::getStageSlacks(std::size_t priority_level,
+                                 const std::vector<double>& solution,
+                                 Eigen::VectorXd& slacks) const {
+    StageMap::const_iterator it = stages_map_.find(priority_level);
+    if (it == stages_map_.end())
+      return -1;
+
+    const HiQPStage& stage = it->second;
+    const Eigen::MatrixXd& J = (stage.compressed_ ? stage.J_original_ : stage.J_);
+    const Eigen::VectorXd& e_dot_star = (stage.compressed_ ? stage.e_dot_star_original_ : stage.e_dot_star_);
+    const std::vector<int>& signs = (stage.compressed_ ? stage.constraint_signs_original_ : stage.constraint_signs_);
+    const int n_rows = (stage.compressed_ ? stage.constraint_signs_original_.size() : stage.nRows);
+
+    Eigen::Map<const Eigen::VectorXd> dq(solution.data(), solution.size());
+    slacks.resize(n_rows);
+    for (int i = 0; i < n_rows; ++i) {
+      double r = J.row(i).dot(dq) - e_dot_star(i);
+      slacks(i) = (signs[i] == 0 ? r : (signs[i] > 0 ? std::min(0.0, r) : std::max(0.0, r)));
+    }
+    return 0;
+  }
+
+  unsigned int HiQPSolver::solveEqualityStages(std::vector<double>& solution) {
+    if (!null_space_fast_path_ || stages_map_.empty())
+      return 0;
+
+    const unsigned int n = solution.size();
+
+    // Find the leading stages that contain only equality rows
+    unsigned int n_stages = 0;
+    unsigned int n_rows = 0;
+    for (auto&& kv : stages_map_) {
+      const std::vector<int>& signs = kv.second.constraint_signs_;
+      if (!std::all_of(signs.begin(), signs.end(), [](int sign) { return sign == 0; }))
+        break;
+      ++n_stages;
+      n_rows += kv.second.nRows;
+    }
+    if (n_stages == 0)
+      return 0;
+
+    if (eq_stage_slacks_.size() < n_rows)
+      eq_stage_slacks_.resize(n_rows);
+    if (ns_stages_.size() < n_stages)
+      ns_stages_.resize(n_stages);
+    ns_dq_.setZero(n);
+    ns_stages_.front().N_.setIdentity(n, n);
+
+    unsigned int stage_nr = 0;
+    unsigned int row_offset = 0;
+
+    for (auto&& kv : stages_map_) {
+      if (stage_nr == n_stages)
+        break;
+
+      const HiQPStage& stage = kv.second;
+      NullSpaceStage& ns = ns_stages_[stage_nr];
+      const unsigned int m = stage.nRows;
+      const unsigned int f = ns.N_.cols();
+      const bool last_stage = (stage_nr + 1 == n_stages);
+
+      if (f > 0) {
+        // dq = dq0 + N*z with dq0 orthogonal to N, then dq^2 = dq0^2 + z^2.
+        // Removing the part of dq in range(N) leaves the stages above as they are
+        if (stage_nr > 0) {
+          ns.z0_.noalias() = ns.N_.transpose() * ns_dq_;
+          ns_dq_.noalias() -= ns.N_ * ns.z0_;
+        }
+
+        ns.r_ = stage.e_dot_star_;
+        ns.r_.noalias() -= stage.J_ * ns_dq_;
+        ns.A_.noalias() = stage.J_ * ns.N_;
+
+        // The range and null space of A are found from the decomposition of A'.
+        // Rows in directions the stages above fixed leave only rounding errors
+        // in A, so the rank is judged against the norm of J
+        if (stage_nr == 0 || !last_stage) {
+          ns.qr_.compute(ns.A_.transpose());
+          ns.rank_ = absoluteRank(ns.qr_, NULL_SPACE_RANK_THRESHOLD * stage.J_.norm());
+          ns.Q_.resize(f, f);
+          ns.workspace_.resize(f);
+          ns.qr_.householderQ().evalTo(ns.Q_, ns.workspace_);
+        }
+
+        if (stage_nr == 0) {
+          // The highest stage is hard, use the minimum norm solution z = Q1*y
+          const unsigned int rank = ns.rank_;
+          ns.B_.noalias() = ns.A_ * ns.Q_.leftCols(rank);
+          ns.H_.noalias() = ns.B_.transpose() * ns.B_;
+          ns.llt_.compute(ns.H_);
+          ns.y_.noalias() = ns.B_.transpose() * ns.r_;
+          ns.llt_.solveInPlace(ns.y_);
+          ns.z_.noalias() = ns.Q_.leftCols(rank) * ns.y_;
+
+          // Hand an inconsistent highest stage to the backend
+          ns.r_.noalias() -= ns.B_ * ns.y_;
+          if (ns.r_.norm() > NULL_SPACE_FEASIBILITY_TOL * (1.0 + stage.e_dot_star_.norm()))
+            return 0;
+        } else {
+          // min TIKHONOV_FACTOR*z^2 + |A*z - r|^2
+          ns.H_.noalias() = ns.A_.transpose() * ns.A_;
+          ns.H_.diagonal().array() += NULL_SPACE_TIKHONOV_FACTOR;
+          ns.llt_.compute(ns.H_);
+          ns.z_.noalias() = ns.A_.transpose() * ns.r_;
+          ns.llt_.solveInPlace(ns.z_);
+        }
+
+        ns_dq_.noalias() += ns.N_ * ns.z_;
+      }
+
+      // Restrict the null space to the one of this stage for the next stage
+      if (!last_stage) {
+        const unsigned int rank = (f > 0 ? ns.rank_ : 0);
+        NullSpaceStage& ns_next = ns_stages_[stage_nr + 1];
+        ns_next.N_.resize(n, f - rank);
+        if (f > 0)
+          ns_next.N_.noalias() = ns.N_ * ns.Q_.rightCols(f - rank);
+      }
+
+      // The slacks w = J*dq - de* with which the rows are kept in the lower stages
+      eq_stage_slacks_.segment(row_offset, m).noalias() = stage.J_ * ns_dq_;
+      eq_stage_slacks_.segment(row_offset, m) -= stage.e_dot_star_;
+
+      row_offset += m;
+      ++stage_nr;
+    }
+
+    for (unsigned int i = 0; i < n; ++i)
+      solution.at(i) = ns_dq_(i);
+
+    return n_stages;
+  }
+
+} // namespace hiqp
@@ -0,0 +1,90 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <hiqp/kinematics_cache.h>
+
+namespace hiqp {
+
+  KinematicsCache::KinematicsCache(const KDL::Tree& tree)
+  : engine_(tree), poses_valid_(false), jacobians_valid_(false), 
+    n_hits_(0), n_misses_(0) {}
+
+  void KinematicsCache::invalidate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    poses_valid_ = false;
+    jacobians_valid_ = false;
+  }
+
+  int KinematicsCache::update(const KDL::JntArray& q, bool jacobians) {
+    if (jacobians ? jacobians_valid_ : poses_valid_) {
+      n_hits_.fetch_add(1, std::memory_order_relaxed);
+      return 0;
+    }
+
+    n_misses_.fetch_add(1, std::memory_order_relaxed);
+    if (!poses_valid_) {
+      if (engine_.updatePoses(q) != 0)
+        return -1;
+      poses_valid_ = true;
+    }
+    if (jacobians) {
+      engine_.updateJacobians();
+      jacobians_valid_ = true;
+    }
+    return 0;
+  }
+
+  int KinematicsCache::getFramePose(const KDL::JntArray& q, 
+                                    const std::string& frame_id, 
+                                    KDL::Frame& pose) {
+    int index = engine_.getSegmentIndex(frame_id);
+    if (index < 0)
+      return -2;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (update(q, false) != 0)
+      return -1;
+    engine_.getPose(index, pose);
+    return 0;
+  }
+
+  int KinematicsCache::getFrameJacobian(const KDL::JntArray& q, 
+                                        const std::string& frame_id, 
+                                        KDL::Jacobian& jacobian) {
+    int index = engine_.getSegmentIndex(frame_id);
+    if (index < 0)
+      return -2;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (update(q, true) != 0)
+      return -1;
+    engine_.getJacobian(index, jacobian);
+    return 0;
+  }
+
+  double KinematicsCache::getHitRate() const {
+    unsigned long n_hits = n_hits_.load();
+    unsigned long n_requests = n_hits + n_misses_.load();
+    if (n_requests == 0) 
+      return 0;
+    return static_cast<double>(n_hits) / n_requests;
+  }
+
+  void KinematicsCache::resetCounters() {
+    n_hits_.store(0);
+    n_misses_.store(0);
+  }
+
+} // namespace hiqp
@@ -0,0 +1,123 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <hiqp/kinematics_engine.h>
+
+namespace hiqp {
+
+  KinematicsEngine::KinematicsEngine(const KDL::Tree& tree)
+  : n_joints_(tree.getNrOfJoints()) {
+    // Breadth-first traversal from the root puts every parent before its children
+    std::vector<KDL::SegmentMap::const_iterator> queue;
+    queue.push_back(tree.getRootSegment());
+    parents_.push_back(0);
+    for (unsigned int i = 0; i < queue.size(); ++i) {
+      const KDL::TreeElement& element = queue.at(i)->second;
+      const KDL::Segment& segment = GetTreeElementSegment(element);
+      indices_[queue.at(i)->first] = i;
+      segments_.push_back(segment);
+      if (i == 0 || segment.getJoint().getType() == KDL::Joint::None)
+        q_nrs_.push_back(-1);
+      else
+        q_nrs_.push_back(GetTreeElementQNr(element));
+      for (auto&& child : GetTreeElementChildren(element)) {
+        queue.push_back(child);
+        parents_.push_back(i);
+      }
+    }
+
+    unsigned int n_segments = queue.size();
+    rotations_.assign(n_segments, Eigen::Matrix3d::Identity());
+    positions_.assign(n_segments, Eigen::Vector3d::Zero());
+    joint_twists_.setZero(6, n_segments);
+    jacobians_.setZero(6, n_segments * n_joints_);
+  }
+
+  int KinematicsEngine::getSegmentIndex(const std::string& segment_name) const {
+    std::map<std::string, int>::const_iterator it = indices_.find(segment_name);
+    if (it == indices_.end())
+      return -1;
+    return it->second;
+  }
+
+  int KinematicsEngine::updatePoses(const KDL::JntArray& q) {
+    if (q.rows() != n_joints_)
+      return -1;
+
+    for (unsigned int i = 1; i < parents_.size(); ++i) {
+      int parent = parents_[i];
+      double q_i = (q_nrs_[i] < 0 ? 0.0 : q(q_nrs_[i]));
+
+      KDL::Frame local = segments_[i].pose(q_i);
+      Eigen::Matrix3d local_rotation;
+      for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c)
+          local_rotation(r, c) = local.M(r, c);
+
+      positions_[i] = positions_[parent] 
+        + rotations_[parent] * Eigen::Vector3d(local.p(0), local.p(1), local.p(2));
+      rotations_[i] = rotations_[parent] * local_rotation;
+
+      if (q_nrs_[i] >= 0) {
+        // Twist of a unit joint velocity, in the parent frame with the
+        // segment origin as reference point
+        KDL::Twist twist = segments_[i].twist(q_i, 1.0);
+        joint_twists_.col(i).head<3>() = rotations_[parent] 
+          * Eigen::Vector3d(twist.vel(0), twist.vel(1), twist.vel(2));
+        joint_twists_.col(i).tail<3>() = rotations_[parent] 
+          * Eigen::Vector3d(twist.rot(0), twist.rot(1), twist.rot(2));
+      }
+    }
+    return 0;
+  }
+
+  void KinematicsEngine::updateJacobians() {
+    for (unsigned int i = 1; i < parents_.size(); ++i) {
+      int parent = parents_[i];
+      Eigen::Vector3d d = positions_[i] - positions_[parent];
+
+      // The joints of the parent move this segment the same way, only the
+      // reference point changes from the parent's origin to this one
+      for (unsigned int j = 0; j < n_joints_; ++j) {
+        Eigen::Matrix<double, 6, 1>::ConstMapType parent_col(&jacobians_(0, parent * n_joints_ + j));
+        Eigen::Matrix<double, 6, 1>::MapType col(&jacobians_(0, i * n_joints_ + j));
+        col.tail<3>() = parent_col.tail<3>();
+        col.head<3>() = parent_col.head<3>() + parent_col.tail<3>().cross(d);
+      }
+
+      if (q_nrs_[i] >= 0)
+        jacobians_.col(i * n_joints_ + q_nrs_[i]) = joint_twists_.col(i);
+    }
+  }
+
+  void KinematicsEngine::getPose(int index, KDL::Frame& pose) const {
+    const Eigen::Matrix3d& R = rotations_.at(index);
+    const Eigen::Vector3d& p = positions_.at(index);
+    for (int r = 0; r < 3; ++r) {
+      for (int c = 0; c < 3; ++c)
+        pose.M(r, c) = R(r, c);
+      pose.p(r) = p(r);
+    }
+  }
+
+  void KinematicsEngine::getJacobian(int index, KDL::Jacobian& jacobian) const {
+    if (jacobian.columns() != n_joints_)
+      jacobian.resize(n_joints_);
+    jacobian.data = jacobians_.middleCols(index * n_joints_, n_joints_);
+  }
+
+} // namespace hiqp
@@ -0,0 +1,96 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <hiqp/solver_registry.h>
+#include <hiqp/solvers/active_set_solver.h>
+#include <hiqp/solvers/decoupled_solver.h>
+#include <hiqp/solvers/reduced_space_solver.h>
+
+#ifdef HIQP_GUROBI
+  #include <hiqp/solvers/gurobi_solver.h>
+#endif
+
+namespace hiqp
+{
+
+  int SolverRegistry::registerSolver(const std::string& name, const Factory& factory) {
+    std::lock_guard<std::mutex> lock(getMutex());
+    return (getFactories().emplace(name, factory).second ? 0 : -1);
+  }
+
+  std::shared_ptr<HiQPSolver> SolverRegistry::createSolver(const std::string& name) {
+    Factory factory;
+    {
+      std::lock_guard<std::mutex> lock(getMutex());
+      FactoryMap::const_iterator it = getFactories().find(name);
+      if (it == getFactories().end())
+        return nullptr;
+      factory = it->second;
+    }
+    return factory();
+  }
+
+  bool SolverRegistry::hasSolver(const std::string& name) {
+    std::lock_guard<std::mutex> lock(getMutex());
+    return getFactories().count(name) > 0;
+  }
+
+  std::vector<std::string> SolverRegistry::getSolverNames() {
+    std::lock_guard<std::mutex> lock(getMutex());
+    std::vector<std::string> names;
+    for (auto&& kv : getFactories())
+      names.push_back(kv.first);
+    return names;
+  }
+
+  std::string SolverRegistry::getDefaultSolverName() {
+    #ifdef HIQP_GUROBI
+    return "gurobi";
+    #else
+    return "activeset";
+    #endif
+  }
+
+  SolverRegistry::FactoryMap& SolverRegistry::getFactories() {
+    // The built-in backends are added here rather than by static registrar
+    // objects in their translation units, which the linker may drop
+    static FactoryMap factories = []() {
+      FactoryMap built_in;
+      built_in["activeset"] = []() { return std::make_shared<ActiveSetSolver>(); };
+      built_in["reduced"] = []() { return std::make_shared<ReducedSpaceSolver>(); };
+      #ifdef HIQP_GUROBI
+      built_in["gurobi"] = []() { return std::make_shared<GurobiSolver>(); };
+      #endif
+
+      // Each backend can also solve independent groups of joints concurrently
+      FactoryMap decoupled;
+      for (auto&& kv : built_in) {
+        Factory factory = kv.second;
+        decoupled["decoupled_" + kv.first] = [factory]() { return std::make_shared<DecoupledSolver>(factory); };
+      }
+      built_in.insert(decoupled.begin(), decoupled.end());
+      return built_in;
+    }();
+    return factories;
+  }
+
+  std::mutex& SolverRegistry::getMutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+} // namespace hiqp
@@ -0,0 +1,269 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <limits>
+
+#include <hiqp/solvers/decoupled_solver.h>
+
+namespace hiqp
+{
+
+  DecoupledSolver::DecoupledSolver(const SolverFactory& factory)
+  : factory_(factory), n_solution_dims_(0), n_components_(0) {
+    solve_job_ = [this](unsigned int i) { solveComponent(i); };
+  }
+
+  void DecoupledSolver::init(unsigned int n_solution_dims) {
+    n_solution_dims_ = n_solution_dims;
+    n_components_ = 0;
+    stage_rows_.clear();
+  }
+
+  bool DecoupledSolver::solve(std::vector<double>& solution) {
+    if (stages_map_.empty())
+      return false;
+
+    stages_.clear();
+    priorities_.clear();
+    for (auto&& kv : stages_map_) {
+      priorities_.push_back(kv.first);
+      stages_.push_back(&kv.second);
+    }
+
+    if (!componentsValid(solution.size()))
+      computeComponents(solution.size());
+
+    // The cycle budget covers all components, see solveComponent()
+    startCycle();
+
+    if (worker_pool_ && n_components_ > 1) {
+      worker_pool_->run(n_components_, solve_job_);
+    } else {
+      for (unsigned int i = 0; i < n_components_; ++i)
+        solveComponent(i);
+    }
+
+    for (unsigned int j = 0; j < solution.size(); ++j) {
+      if (col_components_[j] < 0)
+        solution[j] = 0;
+    }
+
+    bool solved = true;
+    n_solved_stages_ = stages_.size();
+    for (unsigned int i = 0; i < n_components_; ++i) {
+      const Component& comp = components_[i];
+      if (!comp.solved_) {
+        solved = false;
+        continue;
+      }
+      for (unsigned int c = 0; c < comp.cols_.size(); ++c)
+        solution[comp.cols_[c]] = comp.solution_[c];
+
+      // The first stage the component did not solve limits the stages the whole solution satisfies
+      unsigned int n_comp_solved = comp.solver_->getNumSolvedStages();
+      if (n_comp_solved < comp.stage_nrs_.size())
+        n_solved_stages_ = std::min(n_solved_stages_, comp.stage_nrs_[n_comp_solved]);
+    }
+
+    return solved;
+  }
+
+  bool DecoupledSolver::componentsValid(unsigned int n_solution_dims) const {
+    if (n_solution_dims != n_solution_dims_ || n_components_ == 0 || stages_.size() != stage_rows_.size())
+      return false;
+
+    for (unsigned int s = 0; s < stages_.size(); ++s) {
+      const HiQPStage& stage = *stages_[s];
+      if (stage.nRows != stage_rows_[s] || stage.J_.cols() != n_solution_dims)
+        return false;
+      for (int i = 0; i < stage.nRows; ++i) {
+        int comp = row_components_[s][i];
+        for (unsigned int j = 0; j < n_solution_dims; ++j) {
+          if (stage.J_(i, j) != 0.0 && col_components_[j] != comp)
+            return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  void DecoupledSolver::computeComponents(unsigned int n_solution_dims) {
+    const unsigned int n = n_solution_dims;
+    n_solution_dims_ = n;
+
+    // Union the joints each row acts on, anchor_col is a joint of the first
+    // row of the highest stage that acts on any joint
+    uf_parents_.resize(n);
+    for (unsigned int j = 0; j < n; ++j)
+      uf_parents_[j] = j;
+    std::vector<char> touched(n, 0);
+    int anchor_col = -1;
+    for (unsigned int s = 0; s < stages_.size(); ++s) {
+      const HiQPStage& stage = *stages_[s];
+      for (int i = 0; i < stage.nRows; ++i) {
+        int first = -1;
+        for (unsigned int j = 0; j < n; ++j) {
+          if (stage.J_(i, j) == 0.0)
+            continue;
+          touched[j] = 1;
+          if (first < 0)
+            first = j;
+          else
+            uf_parents_[findRoot(j)] = findRoot(first);
+        }
+        if (anchor_col < 0 && first >= 0)
+          anchor_col = first;
+      }
+    }
+
+    // Only trees with rows in the highest stage form components of their own
+    std::vector<char> has_top_rows(n, 0);
+    const HiQPStage& top_stage = *stages_.front();
+    for (int i = 0; i < top_stage.nRows; ++i) {
+      for (unsigned int j = 0; j < n; ++j) {
+        if (top_stage.J_(i, j) != 0.0) {
+          has_top_rows[findRoot(j)] = 1;
+          break;
+        }
+      }
+    }
+
+    std::vector<int> root_components(n, -1);
+    col_components_.assign(n, -1);
+    n_components_ = 0;
+    for (unsigned int j = 0; j < n; ++j) {
+      if (!touched[j])
+        continue;
+      int root = findRoot(j);
+      if (!has_top_rows[root])
+        root = findRoot(anchor_col);
+      if (root_components[root] < 0)
+        root_components[root] = n_components_++;
+      col_components_[j] = root_components[root];
+    }
+
+    // Without any nonzeros all joints are kept in one component
+    if (n_components_ == 0) {
+      col_components_.assign(n, 0);
+      n_components_ = 1;
+    }
+    int anchor_component = (anchor_col >= 0 ? col_components_[anchor_col] : 0);
+
+    while (components_.size() < n_components_) {
+      components_.push_back(Component());
+      components_.back().solver_ = factory_();
+    }
+
+    for (unsigned int c = 0; c < n_components_; ++c) {
+      Component& comp = components_[c];
+      comp.cols_.clear();
+      comp.stage_nrs_.clear();
+      comp.rows_.clear();
+      comp.solved_ = 0;
+    }
+    for (unsigned int j = 0; j < n; ++j) {
+      if (col_components_[j] >= 0)
+        components_[col_components_[j]].cols_.push_back(j);
+    }
+
+    // Rows that act on no joint are kept with the anchor
+    stage_rows_.resize(stages_.size());
+    row_components_.resize(stages_.size());
+    for (unsigned int s = 0; s < stages_.size(); ++s) {
+      const HiQPStage& stage = *stages_[s];
+      stage_rows_[s] = stage.nRows;
+      row_components_[s].assign(stage.nRows, anchor_component);
+      for (int i = 0; i < stage.nRows; ++i) {
+        for (unsigned int j = 0; j < n; ++j) {
+          if (stage.J_(i, j) != 0.0) {
+            row_components_[s][i] = col_components_[j];
+            break;
+          }
+        }
+        Component& comp = components_[row_components_[s][i]];
+        if (comp.stage_nrs_.empty() || comp.stage_nrs_.back() != s) {
+          comp.stage_nrs_.push_back(s);
+          comp.rows_.push_back(std::vector<int>());
+        }
+        comp.rows_.back().push_back(i);
+      }
+    }
+
+    for (unsigned int c = 0; c < n_components_; ++c) {
+      Component& comp = components_[c];
+      unsigned int n_stages = comp.stage_nrs_.size();
+      comp.e_dot_star_.resize(n_stages);
+      comp.J_.resize(n_stages);
+      comp.constraint_signs_.resize(n_stages);
+      for (unsigned int k = 0; k < n_stages; ++k) {
+        comp.e_dot_star_[k].resize(comp.rows_[k].size());
+        comp.J_[k].resize(comp.rows_[k].size(), comp.cols_.size());
+        comp.constraint_signs_[k].resize(comp.rows_[k].size());
+      }
+      comp.solution_.assign(comp.cols_.size(), 0.0);
+      comp.solver_->init(comp.cols_.size());
+    }
+  }
+
+  void DecoupledSolver::solveComponent(unsigned int i) {
+    Component& comp = components_[i];
+
+    unsigned int n_guaranteed = 0;
+    while (n_guaranteed < comp.stage_nrs_.size() && comp.stage_nrs_[n_guaranteed] < n_guaranteed_stages_)
+      ++n_guaranteed;
+    // The component solvers behave like the backend would on its own
+    comp.solver_->setNullSpaceFastPath(null_space_fast_path_);
+    comp.solver_->setSparseStages(sparse_stages_);
+    comp.solver_->setRowCompression(row_compression_);
+    // Components solved one after another only get the time the ones before
+    // them left of the cycle. With none left, only their guaranteed stages
+    // are solved, a budget of zero would disable it
+    double budget = cycle_budget_;
+    if (cycle_budget_ > 0)
+      budget = std::max(getRemainingTime(), std::numeric_limits<double>::min());
+    comp.solver_->setCycleBudget(budget, n_guaranteed);
+
+    comp.solver_->clearStages();
+    for (unsigned int k = 0; k < comp.stage_nrs_.size(); ++k) {
+      const HiQPStage& stage = *stages_[comp.stage_nrs_[k]];
+      const std::vector<int>& rows = comp.rows_[k];
+      for (unsigned int r = 0; r < rows.size(); ++r) {
+        comp.e_dot_star_[k](r) = stage.e_dot_star_(rows[r]);
+        comp.constraint_signs_[k][r] = stage.constraint_signs_[rows[r]];
+        for (unsigned int c = 0; c < comp.cols_.size(); ++c)
+          comp.J_[k](r, c) = stage.J_(rows[r], comp.cols_[c]);
+      }
+      comp.solver_->appendStage(priorities_[comp.stage_nrs_[k]],
+                                comp.e_dot_star_[k],
+                                comp.J_[k],
+                                comp.constraint_signs_[k]);
+    }
+    comp.solver_->finalizeStages();
+
+    comp.solved_ = (comp.solver_->solve(comp.solution_) ? 1 : 0);
+  }
+
+  int DecoupledSolver::findRoot(int col) {
+    while (uf_parents_[col] != col) {
+      uf_parents_[col] = uf_parents_[uf_parents_[col]];
+      col = uf_parents_[col];
+    }
+    return col;
+  }
+
+} // namespace hiqp
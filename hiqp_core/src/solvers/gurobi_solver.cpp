@@ -31,6 +31,7 @@
 #define TIME_LIMIT       1.0//0.005
 #define DUAL_REDUCTIONS  1
 #define TIKHONOV_FACTOR  5*1e-5
+#define METHOD           GRB_METHOD_DUAL // simplex provides a basis for warm-starting
 
 namespace hiqp
 {
@@ -42,6 +43,7 @@ namespace hiqp
     env_.set(GRB_IntParam_ScaleFlag, SCALE_FLAG);
     env_.set(GRB_DoubleParam_TimeLimit, TIME_LIMIT);
     env_.set(GRB_IntParam_DualReductions, DUAL_REDUCTIONS);
+    env_.set(GRB_IntParam_Method, METHOD);
   }
 
   bool GurobiSolver::solve(std::vector<double>& solution) {
@@ -49,42 +51,103 @@ namespace hiqp
       return false;
 
     n_solution_dims_ = solution.size();
-    hqp_constraints_.reset(n_solution_dims_);
+    unsigned int n_rows = 0;
+    for (auto&& kv : stages_map_)
+      n_rows += kv.second.nRows;
+    hqp_constraints_.reset(n_solution_dims_, n_rows);
     unsigned int current_priority = 0;
 
+    unsigned int stage_nr = 0;
+
+    startCycle();
+
+    // Leading equality-only stages might already be solved in closed form
+    unsigned int n_eq_stages = solveEqualityStages(solution);
+    n_solved_stages_ = n_eq_stages;
+
     for (auto&& kv : stages_map_) {
       current_priority = kv.first;
       const HiQPStage& current_stage = kv.second;
 
-      hqp_constraints_.appendConstraints(current_stage);
+      hqp_constraints_.appendConstraints(current_stage, sparse_stages_);
 
-      QPProblem qp_problem(env_, hqp_constraints_, n_solution_dims_);
+      if (stage_nr < n_eq_stages) {
+        hqp_constraints_.w_.segment(hqp_constraints_.n_acc_stage_dims_, current_stage.nRows) =
+          eq_stage_slacks_.segment(hqp_constraints_.n_acc_stage_dims_, current_stage.nRows);
+        ++stage_nr;
+        continue;
+      }
 
-      try { qp_problem.setup(); }
-      catch (GRBException e) {
-        std::cerr << "In GurobiSolver::QPProblem::setup : Gurobi exception with error code "
-                  << e.getErrorCode() << ", and error message "
-                  << e.getMessage().c_str() << ".\n";
-        return false;
+      // The stages solved in closed form have no model, so more than one slot can be missing
+      if (qp_problems_.size() <= stage_nr)
+        qp_problems_.resize(stage_nr + 1);
+
+      if (!mayStartStage(stage_nr))
+        return acceptPartialSolution(stage_nr);
+
+      // Stages beyond the guaranteed ones may only use what is left of the budget
+      double time_limit = TIME_LIMIT;
+      if (stage_nr >= n_guaranteed_stages_ && getRemainingTime() >= 0)
+        time_limit = std::min(getRemainingTime(), time_limit);
+
+      std::shared_ptr<QPProblem>& qp_problem_ptr = qp_problems_.at(stage_nr);
+
+      // Rebuild the model only if the stage layout changed since the last call
+      if (!qp_problem_ptr || !qp_problem_ptr->fits(n_solution_dims_)) {
+        qp_problem_ptr.reset();
+        try {
+          qp_problem_ptr = std::make_shared<QPProblem>(env_, hqp_constraints_, n_solution_dims_);
+          qp_problem_ptr->setup();
+        }
+        catch (GRBException e) {
+          qp_problem_ptr.reset();
+          std::cerr << "In GurobiSolver::QPProblem::setup : Gurobi exception with error code "
+                    << e.getErrorCode() << ", and error message "
+                    << e.getMessage().c_str() << ".\n";
+          return acceptPartialSolution(stage_nr);
+        }
+      } else {
+        try { qp_problem_ptr->update(); }
+        catch (GRBException e) {
+          qp_problem_ptr.reset();
+          std::cerr << "In GurobiSolver::QPProblem::update : Gurobi exception with error code "
+                    << e.getErrorCode() << ", and error message "
+                    << e.getMessage().c_str() << ".\n";
+          return acceptPartialSolution(stage_nr);
+        }
       }
 
-      try { qp_problem.solve(); }
+      QPProblem& qp_problem = *qp_problem_ptr;
+
+      bool optimal = false;
+      try { optimal = qp_problem.solve(time_limit); }
       catch (GRBException e) {
         std::cerr << "In GurobiSolver::QPProblem::solve : Gurobi exception with error code "
                   << e.getErrorCode() << ", and error message "
                   << e.getMessage().c_str() << ".\n";
-        return false;
+        return acceptPartialSolution(stage_nr);
       }
 
+      // A stage that may be dropped is only used if it was solved to optimality
+      if (!optimal && acceptPartialSolution(stage_nr))
+        return true;
+
       try { qp_problem.getSolution(solution); }
       catch (GRBException e) {
         std::cerr << "In GurobiSolver::QPProblem::getSolution : Gurobi exception with error code "
                   << e.getErrorCode() << ", and error message "
                   << e.getMessage().c_str() << ".\n";
-        return false;
+        return acceptPartialSolution(stage_nr);
       }
+
+      finishStage(stage_nr);
+      ++stage_nr;
     }
 
+    // Release the models of stages that no longer exist
+    if (stage_nr == stages_map_.size())
+      qp_problems_.resize(stage_nr);
+
     return true;
   }
 
@@ -92,10 +155,17 @@ namespace hiqp
                                      HQPConstraints& hqp_constraints,
                                      unsigned int solution_dims)
   : model_(env), hqp_constraints_(hqp_constraints), solution_dims_(solution_dims),
+    acc_stage_dims_(hqp_constraints.n_acc_stage_dims_),
+    stage_dims_(hqp_constraints.n_stage_dims_),
     lb_dq_(nullptr), ub_dq_(nullptr), dq_(nullptr),
     lb_w_(nullptr), ub_w_(nullptr), w_(nullptr),
     rhsides_(nullptr), lhsides_(nullptr), coeff_dq_(nullptr), coeff_w_(nullptr),
-    constraints_(nullptr)
+    constraints_(nullptr),
+    n_constrs_(0), constr_rows_(nullptr), bound_cols_(nullptr), senses_(nullptr),
+    n_coeffs_(0), coeff_constrs_(nullptr), coeff_vars_(nullptr), coeff_vals_(nullptr),
+    warm_start_available_(false),
+    start_dq_(nullptr), start_w_(nullptr),
+    vbasis_dq_(nullptr), vbasis_w_(nullptr), cbasis_(nullptr)
   {}
 
   GurobiSolver::QPProblem::~QPProblem() {
@@ -110,55 +180,126 @@ namespace hiqp
     delete[] coeff_w_;
     delete[] lhsides_;
     delete[] constraints_;
+    delete[] constr_rows_;
+    delete[] bound_cols_;
+    delete[] senses_;
+    delete[] coeff_constrs_;
+    delete[] coeff_vars_;
+    delete[] coeff_vals_;
+    delete[] start_dq_;
+    delete[] start_w_;
+    delete[] vbasis_dq_;
+    delete[] vbasis_w_;
+    delete[] cbasis_;
+  }
+
+  bool GurobiSolver::QPProblem::fits(unsigned int solution_dims) const {
+    if (solution_dims_ != solution_dims ||
+        acc_stage_dims_ != hqp_constraints_.n_acc_stage_dims_ ||
+        stage_dims_ != hqp_constraints_.n_stage_dims_)
+      return false;
+
+    for (unsigned int i = 0; i < acc_stage_dims_ + stage_dims_; ++i) {
+      if (getBoundCol(i) != bound_cols_[i])
+        return false;
+    }
+    return J_outer_ == hqp_constraints_.J_outer_ && J_inner_ == hqp_constraints_.J_inner_;
+  }
+
+  int GurobiSolver::QPProblem::getBoundCol(unsigned int i) const {
+    // the rows of the previous stages and of the highest stage have no slack
+    bool hard_row = (i < acc_stage_dims_ || acc_stage_dims_ == 0);
+    return (hard_row ? hqp_constraints_.bound_cols_.at(i) : -1);
+  }
+
+  void GurobiSolver::QPProblem::gatherRowData() {
+    std::fill_n(lb_dq_, solution_dims_, -GRB_INFINITY);
+    std::fill_n(ub_dq_, solution_dims_, GRB_INFINITY);
+
+    unsigned int k = 0;
+    for (unsigned int i = 0; i < acc_stage_dims_ + stage_dims_; ++i) {
+      double rhs = hqp_constraints_.de_(i) + hqp_constraints_.w_(i);
+      char sense = hqp_constraints_.constraint_signs_.at(i);
+      int col = bound_cols_[i];
+
+      if (col < 0) {
+        rhsides_[k] = rhs;
+        senses_[k] = sense;
+        ++k;
+      } else {
+        int sign = (sense == GRB_LESS_EQUAL ? -1 : (sense == GRB_GREATER_EQUAL ? 1 : 0));
+        mergeBound(hqp_constraints_.getCoeff(i, col), rhs, sign, lb_dq_[col], ub_dq_[col]);
+      }
+    }
   }
 
   void GurobiSolver::QPProblem::setup() {
-    unsigned int stage_dims = hqp_constraints_.n_stage_dims_;
-    unsigned int acc_stage_dims = hqp_constraints_.n_acc_stage_dims_;
+    unsigned int stage_dims = stage_dims_;
+    unsigned int acc_stage_dims = acc_stage_dims_;
     unsigned int total_stage_dims = stage_dims + acc_stage_dims;
 
+    // Split the rows into bounds on dq and constraints
+    bound_cols_ = new int[total_stage_dims];
+    n_constrs_ = 0;
+    for (unsigned int i = 0; i < total_stage_dims; ++i) {
+      bound_cols_[i] = getBoundCol(i);
+      if (bound_cols_[i] < 0)
+        ++n_constrs_;
+    }
+    constr_rows_ = new unsigned int[n_constrs_];
+    for (unsigned int i = 0, k = 0; i < total_stage_dims; ++i) {
+      if (bound_cols_[i] < 0)
+        constr_rows_[k++] = i;
+    }
+
     // Allocate and set lower and upper bounds for joint velocities and slack variables
     lb_dq_ = new double[solution_dims_];
     ub_dq_ = new double[solution_dims_];
-    std::fill_n(lb_dq_, solution_dims_, -GRB_INFINITY);
-    std::fill_n(ub_dq_, solution_dims_, GRB_INFINITY);
 
     lb_w_ = new double[stage_dims];
     ub_w_ = new double[stage_dims];
     std::fill_n(lb_w_, stage_dims, -GRB_INFINITY);
     std::fill_n(ub_w_, stage_dims, GRB_INFINITY);
 
+    // Allocate and set right-hand-side constants and senses
+    rhsides_ = new double[n_constrs_];
+    senses_ = new char[n_constrs_];
+    gatherRowData();
+
     dq_ = model_.addVars(lb_dq_, ub_dq_, NULL, NULL, NULL, solution_dims_);
     w_ = model_.addVars(lb_w_, ub_w_, NULL, NULL, NULL, stage_dims);
     model_.update();
 
-    // Allocate and set right-hand-side constants
-    rhsides_ = new double[total_stage_dims];
-    Eigen::Map<Eigen::VectorXd>(rhsides_, total_stage_dims)
-     = hqp_constraints_.de_ + hqp_constraints_.w_;
-
     // Allocate and set left-hand-side expressions
-    lhsides_ = new GRBLinExpr[total_stage_dims];
+    lhsides_ = new GRBLinExpr[n_constrs_];
     coeff_dq_ = new double[solution_dims_];
     coeff_w_ = new double[stage_dims];
 
-    for (unsigned int i = 0; i < acc_stage_dims; ++i) {
-      Eigen::Map<Eigen::VectorXd>(coeff_dq_, solution_dims_) = hqp_constraints_.J_.row(i);
-      lhsides_[i].addTerms(coeff_dq_, dq_, solution_dims_);
-    }
-
-    for (unsigned int i = 0; i < stage_dims; ++i) {
-      Eigen::Map<Eigen::VectorXd>(coeff_dq_, solution_dims_) = hqp_constraints_.J_.row(acc_stage_dims + i);
-      lhsides_[acc_stage_dims + i].addTerms(coeff_dq_, dq_, solution_dims_);
+    // Only the nonzeros of the rows are added
+    J_outer_ = hqp_constraints_.J_outer_;
+    J_inner_ = hqp_constraints_.J_inner_;
+    std::vector<GRBVar> row_vars(solution_dims_);
+    n_coeffs_ = 0;
+    for (unsigned int k = 0; k < n_constrs_; ++k) {
+      unsigned int i = constr_rows_[k];
+      unsigned int n_row_coeffs = 0;
+      for (int l = J_outer_[i]; l < J_outer_[i+1]; ++l, ++n_row_coeffs) {
+        coeff_dq_[n_row_coeffs] = hqp_constraints_.J_values_[l];
+        row_vars[n_row_coeffs] = dq_[J_inner_[l]];
+      }
+      lhsides_[k].addTerms(coeff_dq_, row_vars.data(), n_row_coeffs);
+      n_coeffs_ += n_row_coeffs;
+      if (i < acc_stage_dims)
+        continue;
       if(acc_stage_dims == 0)
         // Force the slack variables to be zero in the highest stage
-        lhsides_[acc_stage_dims + i] -= w_[i]*0.0;
+        lhsides_[k] -= w_[i - acc_stage_dims]*0.0;
       else
-        lhsides_[acc_stage_dims + i] -= w_[i];
+        lhsides_[k] -= w_[i - acc_stage_dims];
     }
 
     // Add constraints to the QP model
-    constraints_ = model_.addConstrs(lhsides_, &hqp_constraints_.constraint_signs_[0], rhsides_, NULL, total_stage_dims);
+    constraints_ = model_.addConstrs(lhsides_, senses_, rhsides_, NULL, n_constrs_);
 
     // Add objective function
     GRBQuadExpr obj;
@@ -169,6 +310,27 @@ namespace hiqp
     model_.setObjective(obj, GRB_MINIMIZE);
     model_.update();
 
+    // Allocate the coefficient buffers used by update(), the rows and columns
+    // of the dq coefficients never change for this layout
+    coeff_constrs_ = new GRBConstr[n_coeffs_];
+    coeff_vars_ = new GRBVar[n_coeffs_];
+    coeff_vals_ = new double[n_coeffs_];
+    for (unsigned int k = 0, m = 0; k < n_constrs_; ++k) {
+      unsigned int i = constr_rows_[k];
+      for (int l = J_outer_[i]; l < J_outer_[i+1]; ++l, ++m) {
+        coeff_constrs_[m] = constraints_[k];
+        coeff_vars_[m] = dq_[J_inner_[l]];
+      }
+    }
+
+    // Allocate the warm-start buffers, a fresh model always starts cold
+    start_dq_ = new double[solution_dims_];
+    start_w_ = new double[stage_dims];
+    vbasis_dq_ = new int[solution_dims_];
+    vbasis_w_ = new int[stage_dims];
+    cbasis_ = new int[n_constrs_];
+    warm_start_available_ = false;
+
     // DEBUG =============================================
     // std::cerr << std::setprecision(2) << "Gurobi solver stage " << s_count << " matrices:" << std::endl;
     // std::cerr << "A" << std::endl << A_ << std::endl;
@@ -180,25 +342,83 @@ namespace hiqp
     // DEBUG END ==========================================
   }
 
-  void GurobiSolver::QPProblem::solve() {
+  void GurobiSolver::QPProblem::update() {
+    for (unsigned int k = 0, m = 0; k < n_constrs_; ++k) {
+      unsigned int i = constr_rows_[k];
+      for (int l = J_outer_[i]; l < J_outer_[i+1]; ++l, ++m)
+        coeff_vals_[m] = hqp_constraints_.J_values_[l];
+    }
+    model_.chgCoeffs(coeff_constrs_, coeff_vars_, coeff_vals_, n_coeffs_);
+
+    gatherRowData();
+    model_.set(GRB_DoubleAttr_RHS, constraints_, rhsides_, n_constrs_);
+    model_.set(GRB_CharAttr_Sense, constraints_, senses_, n_constrs_);
+    model_.set(GRB_DoubleAttr_LB, dq_, lb_dq_, solution_dims_);
+    model_.set(GRB_DoubleAttr_UB, dq_, ub_dq_, solution_dims_);
+  }
+
+  void GurobiSolver::QPProblem::setWarmStart() {
+    if (!warm_start_available_)
+      return;
+
+    model_.set(GRB_DoubleAttr_PStart, dq_, start_dq_, solution_dims_);
+    model_.set(GRB_DoubleAttr_PStart, w_, start_w_, stage_dims_);
+    model_.set(GRB_IntAttr_VBasis, dq_, vbasis_dq_, solution_dims_);
+    model_.set(GRB_IntAttr_VBasis, w_, vbasis_w_, stage_dims_);
+    model_.set(GRB_IntAttr_CBasis, constraints_, cbasis_, n_constrs_);
+  }
+
+  void GurobiSolver::QPProblem::storeWarmStart() {
+    warm_start_available_ = false;
+
+    // The basis is only available if the model was solved by simplex
+    try {
+      for (unsigned int i = 0; i < solution_dims_; ++i) {
+        start_dq_[i] = dq_[i].get(GRB_DoubleAttr_X);
+        vbasis_dq_[i] = dq_[i].get(GRB_IntAttr_VBasis);
+      }
+      for (unsigned int i = 0; i < stage_dims_; ++i) {
+        start_w_[i] = w_[i].get(GRB_DoubleAttr_X);
+        vbasis_w_[i] = w_[i].get(GRB_IntAttr_VBasis);
+      }
+      for (unsigned int k = 0; k < n_constrs_; ++k)
+        cbasis_[k] = constraints_[k].get(GRB_IntAttr_CBasis);
+    }
+    catch (GRBException e) {
+      return;
+    }
+
+    warm_start_available_ = true;
+  }
+
+  bool GurobiSolver::QPProblem::solve(double time_limit) {
+    setWarmStart();
+
+    model_.set(GRB_DoubleParam_TimeLimit, time_limit);
     model_.optimize();
     int status = model_.get(GRB_IntAttr_Status);
     double runtime = model_.get(GRB_DoubleAttr_Runtime);
 
-    if (status != GRB_OPTIMAL) {
+    if (status == GRB_OPTIMAL) {
+      storeWarmStart();
+    } else {
+      warm_start_available_ = false;
+
       if(status == GRB_TIME_LIMIT)
-        ROS_WARN("Stage solving runtime %f sec exceeds the set time limit of %f sec.", runtime, TIME_LIMIT);
+        ROS_WARN("Stage solving runtime %f sec exceeds the set time limit of %f sec.", runtime, time_limit);
       else
         ROS_ERROR("In HQPSolver::solve(...): No optimal solution found for stage with priority %d. Status is %d.", 0, status);
 
       //model.write("/home/rkg/Desktop/model.lp");
       //model.write("/home/yumi/Desktop/model.sol");
     }
+
+    return status == GRB_OPTIMAL;
   }
 
   void GurobiSolver::QPProblem::getSolution(std::vector<double>& solution) {
-    unsigned int stage_dims = hqp_constraints_.n_stage_dims_;
-    unsigned int acc_stage_dims = hqp_constraints_.n_acc_stage_dims_;
+    unsigned int stage_dims = stage_dims_;
+    unsigned int acc_stage_dims = acc_stage_dims_;
 
     for (unsigned int i = 0; i < solution_dims_; ++i)
       solution.at(i) = dq_[i].get(GRB_DoubleAttr_X);
@@ -207,16 +427,33 @@ namespace hiqp
       hqp_constraints_.w_(acc_stage_dims + i) = w_[i].get(GRB_DoubleAttr_X);
   }
 
-  void GurobiSolver::HQPConstraints::reset(unsigned int n_solution_dims) {
+  void GurobiSolver::HQPConstraints::reset(unsigned int n_solution_dims, unsigned int n_rows) {
     n_acc_stage_dims_ = 0;
     n_stage_dims_ = 0;
-    w_.resize(0);
-    de_.resize(0);
-    J_.resize(0, n_solution_dims);
+    w_.resize(n_rows);
+    de_.resize(n_rows);
+    J_outer_.assign(1, 0);
+    J_outer_.reserve(n_rows + 1);
+    // A row has at most one coefficient per dimension of dq
+    J_inner_.clear();
+    J_inner_.reserve(n_rows * n_solution_dims);
+    J_values_.clear();
+    J_values_.reserve(n_rows * n_solution_dims);
     constraint_signs_.clear();
+    constraint_signs_.reserve(n_rows);
+    bound_cols_.clear();
+    bound_cols_.reserve(n_rows);
+  }
+
+  double GurobiSolver::HQPConstraints::getCoeff(unsigned int i, int col) const {
+    for (int l = J_outer_[i]; l < J_outer_[i+1]; ++l) {
+      if (J_inner_[l] == col)
+        return J_values_[l];
+    }
+    return 0.0;
   }
 
-  void GurobiSolver::HQPConstraints::appendConstraints(const HiQPStage& current_stage) {
+  void GurobiSolver::HQPConstraints::appendConstraints(const HiQPStage& current_stage, bool sparse) {
     // append stage dimensions from the previously solved stage
     n_acc_stage_dims_ += n_stage_dims_;
     n_stage_dims_ = current_stage.nRows;
@@ -231,12 +468,29 @@ namespace hiqp
       }
     }
 
-    de_.conservativeResize(n_acc_stage_dims_ + n_stage_dims_);
-    de_.tail(n_stage_dims_) = current_stage.e_dot_star_;
-    J_.conservativeResize(n_acc_stage_dims_ + n_stage_dims_, Eigen::NoChange);
-    J_.bottomRows(n_stage_dims_) = current_stage.J_;
-    w_.conservativeResize(n_acc_stage_dims_ + n_stage_dims_);
-    w_.tail(n_stage_dims_).setZero();
+    bound_cols_.insert(bound_cols_.end(),
+                       current_stage.bound_cols_.begin(),
+                       current_stage.bound_cols_.end());
+
+    de_.segment(n_acc_stage_dims_, n_stage_dims_) = current_stage.e_dot_star_;
+    w_.segment(n_acc_stage_dims_, n_stage_dims_).setZero();
+
+    if (sparse) {
+      const Eigen::SparseMatrix<double, Eigen::RowMajor>& J = current_stage.J_sparse_;
+      int offset = J_inner_.size();
+      for (unsigned int i = 0; i < n_stage_dims_; ++i)
+        J_outer_.push_back(offset + J.outerIndexPtr()[i+1]);
+      J_inner_.insert(J_inner_.end(), J.innerIndexPtr(), J.innerIndexPtr() + J.nonZeros());
+      J_values_.insert(J_values_.end(), J.valuePtr(), J.valuePtr() + J.nonZeros());
+    } else {
+      for (unsigned int i = 0; i < n_stage_dims_; ++i) {
+        for (int j = 0; j < current_stage.J_.cols(); ++j) {
+          J_inner_.push_back(j);
+          J_values_.push_back(current_stage.J_(i, j));
+        }
+        J_outer_.push_back(J_inner_.size());
+      }
+    }
   }
 
 } // namespace hiqp
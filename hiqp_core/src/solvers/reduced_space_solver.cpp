@@ -0,0 +1,252 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include <hiqp/solvers/reduced_space_solver.h>
+
+#define REDUCED_SPACE_RANK_THRESHOLD  1e-9 // relative to the norm of the rows before the reduction
+
+namespace hiqp
+{
+
+  ReducedSpaceSolver::ReducedSpaceSolver()
+  : tikhonov_factor_(5*1e-5), n_reduced_vars_(0), n_held_(0) {}
+
+  void ReducedSpaceSolver::init(unsigned int n_solution_dims) {
+    // Reserve for a few stages with twice as many rows as solution dimensions,
+    // like the ActiveSetSolver
+    const unsigned int n_reserved_stages = 4;
+    const unsigned int n_reserved_rows = 2 * n_solution_dims;
+
+    dq_.resize(n_solution_dims);
+    w_.resize(n_reserved_rows);
+    held_J_.resize(n_reserved_stages * n_reserved_rows, n_solution_dims);
+    held_b_.resize(n_reserved_stages * n_reserved_rows);
+    held_signs_.reserve(n_reserved_stages * n_reserved_rows);
+    held_rows_.reserve(n_reserved_stages * n_reserved_rows);
+    while (reduced_stages_.size() < n_reserved_stages) {
+      reduced_stages_.push_back(ReducedStage());
+      reduced_stages_.back().qp_ = std::make_shared<ActiveSetQP>();
+      reduced_stages_.back().qp_->reserve(n_solution_dims + n_reserved_rows,
+                                          n_reserved_rows,
+                                          n_reserved_stages * n_reserved_rows);
+    }
+  }
+
+  bool ReducedSpaceSolver::solve(std::vector<double>& solution) {
+    if (stages_map_.empty())
+      return false;
+
+    const unsigned int n = solution.size();
+
+    while (reduced_stages_.size() < stages_map_.size()) {
+      reduced_stages_.push_back(ReducedStage());
+      reduced_stages_.back().qp_ = std::make_shared<ActiveSetQP>();
+    }
+    if (held_J_.cols() != n)
+      held_J_.resize(held_J_.rows(), n);
+
+    dq_.setZero(n);
+    n_held_ = 0;
+    held_signs_.clear();
+    reduced_stages_.front().N_.setIdentity(n, n);
+
+    startCycle();
+
+    unsigned int stage_nr = 0;
+    for (StageMap::const_iterator it = stages_map_.begin(); it != stages_map_.end(); ++it, ++stage_nr) {
+      const HiQPStage& stage = it->second;
+
+      if (!mayStartStage(stage_nr))
+        return acceptPartialSolution(stage_nr);
+
+      if (w_.size() < stage.nRows)
+        w_.resize(stage.nRows);
+
+      n_reduced_vars_ = reduced_stages_[stage_nr].N_.cols();
+      if (n_reduced_vars_ == 0)
+        solveFixedStage(stage);
+      else if (!solveStage(stage, stage_nr))
+        return acceptPartialSolution(stage_nr);
+
+      for (unsigned int i = 0; i < n; ++i)
+        solution.at(i) = dq_(i);
+
+      reduceStage(stage, stage_nr, std::next(it) == stages_map_.end());
+      finishStage(stage_nr);
+    }
+
+    return true;
+  }
+
+  bool ReducedSpaceSolver::solveStage(const HiQPStage& stage, unsigned int stage_nr) {
+    ReducedStage& rs = reduced_stages_[stage_nr];
+    ActiveSetQP& qp = *rs.qp_;
+    const unsigned int f = rs.N_.cols();
+    const unsigned int m = stage.nRows;
+
+    // The highest stage is solved without slack variables
+    const unsigned int n_slacks = (stage_nr == 0 ? 0 : m);
+
+    // dq = dq0 + N*z with dq0 orthogonal to N, then dq^2 = dq0^2 + z^2
+    rs.z0_.noalias() = rs.N_.transpose() * dq_;
+    rs.dq0_ = dq_;
+    rs.dq0_.noalias() -= rs.N_ * rs.z0_;
+
+    rs.A_.noalias() = stage.J_ * rs.N_;
+    rs.held_A_.noalias() = held_J_.topRows(n_held_) * rs.N_;
+
+    // Held rows that dq cannot move along anymore keep the value they got
+    // in the stage they were solved in and are left out
+    held_rows_.clear();
+    for (unsigned int h = 0; h < n_held_; ++h) {
+      if (rs.held_A_.row(h).norm() > REDUCED_SPACE_RANK_THRESHOLD * held_J_.row(h).norm())
+        held_rows_.push_back(h);
+    }
+
+    unsigned int n_eq = 0;
+    for (int i = 0; i < stage.nRows; ++i) {
+      if (stage.constraint_signs_.at(i) == 0)
+        ++n_eq;
+    }
+    qp.resize(f + n_slacks, n_eq, m - n_eq + held_rows_.size());
+
+    qp.hessianDiagonal().head(f).setConstant(tikhonov_factor_);
+    qp.hessianDiagonal().tail(n_slacks).setConstant(1.0);
+
+    unsigned int i_eq = 0, i_in = 0;
+    for (unsigned int k = 0; k < held_rows_.size(); ++k) {
+      int h = held_rows_[k];
+      setConstraint(qp, i_eq, i_in, rs.held_A_, h, -1,
+                    held_b_(h) - held_J_.row(h).dot(rs.dq0_),
+                    held_signs_[h]);
+    }
+    for (unsigned int i = 0; i < m; ++i) {
+      setConstraint(qp, i_eq, i_in, rs.A_, i,
+                    (n_slacks > 0 ? f + i : -1),
+                    stage.e_dot_star_(i) - stage.J_.row(i).dot(rs.dq0_),
+                    stage.constraint_signs_.at(i));
+    }
+
+    if (!qp.solve())
+      return false;
+
+    dq_ = rs.dq0_;
+    dq_.noalias() += rs.N_ * qp.solution().head(f);
+    for (unsigned int i = 0; i < m; ++i)
+      w_(i) = (n_slacks > 0 ? qp.solution()(f + i) : 0.0);
+
+    return true;
+  }
+
+  void ReducedSpaceSolver::solveFixedStage(const HiQPStage& stage) {
+    // The smallest slacks that satisfy J*dq - w (<=,=,>=) de*
+    for (int i = 0; i < stage.nRows; ++i) {
+      double r = stage.J_.row(i).dot(dq_) - stage.e_dot_star_(i);
+      int sign = stage.constraint_signs_.at(i);
+      w_(i) = (sign == 0 ? r : (sign > 0 ? std::min(0.0, r) : std::max(0.0, r)));
+    }
+  }
+
+  void ReducedSpaceSolver::reduceStage(const HiQPStage& stage, unsigned int stage_nr, bool last_stage) {
+    ReducedStage& rs = reduced_stages_[stage_nr];
+    const unsigned int n = dq_.size();
+    const unsigned int f = rs.N_.cols();
+
+    if (last_stage)
+      return;
+
+    // The inequality rows are kept as constraints with their slacks fixed
+    unsigned int n_eq = 0;
+    for (int i = 0; i < stage.nRows; ++i) {
+      int sign = stage.constraint_signs_.at(i);
+      if (sign == 0) {
+        ++n_eq;
+        continue;
+      }
+      if (held_J_.rows() <= static_cast<int>(n_held_)) {
+        held_J_.conservativeResize(2 * n_held_ + stage.nRows, Eigen::NoChange);
+        held_b_.conservativeResize(2 * n_held_ + stage.nRows);
+      }
+      held_J_.row(n_held_) = stage.J_.row(i);
+      held_b_(n_held_) = stage.e_dot_star_(i) + w_(i);
+      held_signs_.push_back(sign);
+      ++n_held_;
+    }
+
+    // The equality rows are kept by moving only in their null space
+    ReducedStage& next = reduced_stages_[stage_nr + 1];
+    if (n_eq == 0 || f == 0) {
+      next.N_ = rs.N_;
+      return;
+    }
+
+    rs.M_.resize(n_eq, f);
+    double eq_squared_norm = 0;
+    for (int i = 0, k = 0; i < stage.nRows; ++i) {
+      if (stage.constraint_signs_.at(i) == 0) {
+        rs.M_.row(k++) = rs.A_.row(i);
+        eq_squared_norm += stage.J_.row(i).squaredNorm();
+      }
+    }
+
+    // The null space of M is found from the decomposition of M'. Rows in
+    // directions the stages above fixed leave only rounding errors in M, so
+    // the rank is judged against the norm of the equality rows of J
+    rs.qr_.compute(rs.M_.transpose());
+    rs.Q_.resize(f, f);
+    rs.workspace_.resize(f);
+    rs.qr_.householderQ().evalTo(rs.Q_, rs.workspace_);
+
+    const unsigned int rank = absoluteRank(rs.qr_, REDUCED_SPACE_RANK_THRESHOLD * std::sqrt(eq_squared_norm));
+    next.N_.resize(n, f - rank);
+    next.N_.noalias() = rs.N_ * rs.Q_.rightCols(f - rank);
+  }
+
+  void ReducedSpaceSolver::setConstraint(ActiveSetQP& qp,
+                                         unsigned int& i_eq,
+                                         unsigned int& i_in,
+                                         const Eigen::MatrixXd& A,
+                                         unsigned int row,
+                                         int slack_col,
+                                         double b,
+                                         int sign) {
+    const unsigned int f = A.cols();
+    const unsigned int n_vars = qp.getNumVariables();
+
+    // A*z - w = b      ->  [A -1]*x - b = 0
+    // A*z - w >= b     ->  [A -1]*x - b >= 0
+    // A*z - w <= b     -> -[A -1]*x + b >= 0
+    ActiveSetQP::MatrixBlock normals = (sign == 0 ? qp.eqNormals() : qp.inNormals());
+    unsigned int col = (sign == 0 ? i_eq++ : i_in++);
+    double factor = (sign < 0 ? -1.0 : 1.0);
+
+    normals.col(col).head(f) = factor * A.row(row).transpose();
+    normals.col(col).tail(n_vars - f).setZero();
+    if (slack_col >= 0)
+      normals(slack_col, col) = -factor;
+
+    if (sign == 0)
+      qp.eqOffsets()(col) = -b;
+    else
+      qp.inOffsets()(col) = -factor * b;
+  }
+
+} // namespace hiqp
@@ -16,6 +16,7 @@
 
 #include <hiqp/task.h>
 
+#include <hiqp/tasks/tdef_convex_distance.h>
 #include <hiqp/tasks/tdef_full_pose.h>
 #include <hiqp/tasks/tdef_geometric_alignment.h>
 #include <hiqp/tasks/tdef_geometric_projection.h>
@@ -37,6 +38,7 @@
 
 namespace hiqp {
 
+  using tasks::TDefConvexDistance;
   using tasks::TDefFullPose;
   using tasks::TDefGeometricAlignment;
   using tasks::TDefGeometricProjection;
@@ -67,6 +69,9 @@ namespace hiqp {
       return -2;
     }
 
+    def_params_ = def_params;
+    dyn_params_ = dyn_params;
+
     if (constructDefinition(def_params) != 0) return -3;
     if (constructDynamics(dyn_params) != 0) return -4;
 
@@ -136,18 +141,32 @@ namespace hiqp {
         def_ = std::make_shared< TDefGeometricProjection<GeometricPoint, GeometricCylinder> >(geom_prim_map_, visualizer_);
       } else if (prim_type1.compare("point") == 0 && prim_type2.compare("sphere") == 0) {
         def_ = std::make_shared< TDefGeometricProjection<GeometricPoint, GeometricSphere> >(geom_prim_map_, visualizer_);
+      } else if (prim_type1.compare("point") == 0 && prim_type2.compare("capsule") == 0) {
+        def_ = std::make_shared< TDefGeometricProjection<GeometricPoint, GeometricCapsule> >(geom_prim_map_, visualizer_);
+      } else if (prim_type1.compare("point") == 0 && prim_type2.compare("sdf") == 0) {
+        def_ = std::make_shared< TDefGeometricProjection<GeometricPoint, GeometricSDF> >(geom_prim_map_, visualizer_);
       } else if (prim_type1.compare("line") == 0 && prim_type2.compare("line") == 0) {
         def_ = std::make_shared< TDefGeometricProjection<GeometricLine, GeometricLine> >(geom_prim_map_, visualizer_);
+      } else if (prim_type1.compare("cylinder") == 0 && prim_type2.compare("capsule") == 0) {
+        def_ = std::make_shared< TDefGeometricProjection<GeometricCylinder, GeometricCapsule> >(geom_prim_map_, visualizer_);
       } else if (prim_type1.compare("sphere") == 0 && prim_type2.compare("plane") == 0) {
         def_ = std::make_shared< TDefGeometricProjection<GeometricSphere, GeometricPlane> >(geom_prim_map_, visualizer_);
       } else if (prim_type1.compare("sphere") == 0 && prim_type2.compare("sphere") == 0) {
         def_ = std::make_shared< TDefGeometricProjection<GeometricSphere, GeometricSphere> >(geom_prim_map_, visualizer_);
+      } else if (prim_type1.compare("sphere") == 0 && prim_type2.compare("capsule") == 0) {
+        def_ = std::make_shared< TDefGeometricProjection<GeometricSphere, GeometricCapsule> >(geom_prim_map_, visualizer_);
+      } else if (prim_type1.compare("sphere") == 0 && prim_type2.compare("sdf") == 0) {
+        def_ = std::make_shared< TDefGeometricProjection<GeometricSphere, GeometricSDF> >(geom_prim_map_, visualizer_);
+      } else if (prim_type1.compare("capsule") == 0 && prim_type2.compare("capsule") == 0) {
+        def_ = std::make_shared< TDefGeometricProjection<GeometricCapsule, GeometricCapsule> >(geom_prim_map_, visualizer_);
       } else if (prim_type1.compare("frame") == 0 && prim_type2.compare("frame") == 0) {
         def_ = std::make_shared< TDefGeometricProjection<GeometricFrame, GeometricFrame> >(geom_prim_map_, visualizer_);
       } else {
         printHiqpWarning("TDefGeomProj does not support primitive combination of types '" + prim_type1 + "' and '" + prim_type2 + "'!");
         return -1;
       }
+    } else if (type.compare("TDefConvexDist") == 0) {
+      def_ = std::make_shared<TDefConvexDistance>(geom_prim_map_, visualizer_);
     } else if (type.compare("TDefGeomAlign") == 0) {
       std::string prim_type1 = def_params.at(1);
       std::string prim_type2 = def_params.at(2);
@@ -15,18 +15,15 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <iomanip> // std::setw
+#include <chrono>
+#include <cmath>
 #include <ros/console.h>
 #include <hiqp/task_manager.h>
 #include <hiqp/utilities.h>
 #include <hiqp/geometric_primitives/geometric_primitive_visualizer.h>
 #include <hiqp/geometric_primitives/geometric_primitive_couter.h>
 
-#ifdef HIQP_CASADI
-  #include <hiqp/solvers/casadi_solver.h>
-#endif
-#ifdef HIQP_GUROBI
-  #include <hiqp/solvers/gurobi_solver.h>
-#endif
+#include <hiqp/solver_registry.h>
 
 #include <Eigen/Dense>
 
@@ -36,47 +33,191 @@ using hiqp::geometric_primitives::GeometricPrimitiveCouter;
 namespace hiqp {
 
   TaskManager::TaskManager(std::shared_ptr<Visualizer> visualizer)
-  : visualizer_(visualizer) {
+  : visualizer_(visualizer), snapshot_(new TaskSnapshot(0)), n_snapshot_releases_(0), task_set_version_(0),
+    n_published_snapshots_(0),
+    null_space_fast_path_(false), sparse_stages_(false), row_compression_(false), cycle_budget_(0), n_guaranteed_stages_(1),
+    activation_margin_(-1), broad_phase_serial_(0), n_dropped_tasks_(0) {
     geometric_primitive_map_ = std::make_shared<GeometricPrimitiveMap>();
-    #ifdef HIQP_CASADI
-    solver_ = std::make_shared<CasadiSolver>();
-    #endif
-    #ifdef HIQP_GUROBI
-    solver_ = std::make_shared<GurobiSolver>();
-    #endif
+    solver_name_ = SolverRegistry::getDefaultSolverName();
+    solver_ = SolverRegistry::createSolver(solver_name_);
+
+    update_job_ = [this](unsigned int i) {
+      update_results_[i] = update_tasks_[i]->update(update_robot_state_);
+    };
   }
 
-  TaskManager::~TaskManager() noexcept {}
+  TaskManager::~TaskManager() noexcept {
+    delete snapshot_.load();
+    for (auto&& retired : retired_snapshots_)
+      delete retired.first;
+  }
 
-  void TaskManager::init(unsigned int n_controls) {
+  int TaskManager::init(unsigned int n_controls, const std::string& solver_name) {
     n_controls_ = n_controls; 
+    int result = 0;
+
+    if (!solver_name.empty()) {
+      std::shared_ptr<HiQPSolver> solver = SolverRegistry::createSolver(solver_name);
+      if (solver) {
+        solver_ = solver;
+        solver_name_ = solver_name;
+      } else {
+        std::string names;
+        for (auto&& name : SolverRegistry::getSolverNames())
+          names += " " + name;
+        printHiqpWarning("The solver backend '" + solver_name + "' is not available, using '"
+          + SolverRegistry::getDefaultSolverName() + "'. Available backends:" + names);
+        result = -1;
+      }
+    }
+
+    solver_->setNullSpaceFastPath(null_space_fast_path_);
+    solver_->setSparseStages(sparse_stages_);
+    solver_->setRowCompression(row_compression_);
+    solver_->setCycleBudget(cycle_budget_, n_guaranteed_stages_);
+    solver_->setWorkerPool(&worker_pool_);
+    solver_->init(n_controls_);
+    return result;
+  }
+
+  int TaskManager::setShadowSolver(const std::string& solver_name) {
+    if (solver_name.empty()) {
+      shadow_solver_.reset();
+      solver_comparison_ = SolverComparison();
+      return 0;
+    }
+
+    std::shared_ptr<HiQPSolver> solver = SolverRegistry::createSolver(solver_name);
+    if (!solver) {
+      printHiqpWarning("The shadow solver backend '" + solver_name + "' is not available!");
+      return -1;
+    }
+    configureSolver(*solver);
+    solver->setWorkerPool(&worker_pool_);
+    solver->init(n_controls_);
+    shadow_controls_.assign(n_controls_, 0.0);
+    shadow_solver_ = solver;
+    return 0;
+  }
+
+  void TaskManager::setNullSpaceFastPath(bool enabled) {
+    null_space_fast_path_ = enabled;
+    solver_->setNullSpaceFastPath(enabled);
+    if (shadow_solver_)
+      shadow_solver_->setNullSpaceFastPath(enabled);
+  }
+
+  void TaskManager::setSparseStages(bool enabled) {
+    sparse_stages_ = enabled;
+    solver_->setSparseStages(enabled);
+    if (shadow_solver_)
+      shadow_solver_->setSparseStages(enabled);
+  }
+
+  void TaskManager::setRowCompression(bool enabled) {
+    row_compression_ = enabled;
+    solver_->setRowCompression(enabled);
+    if (shadow_solver_)
+      shadow_solver_->setRowCompression(enabled);
+  }
+
+  void TaskManager::setCycleBudget(double budget, unsigned int n_guaranteed_stages) {
+    cycle_budget_ = budget;
+    n_guaranteed_stages_ = n_guaranteed_stages;
+    solver_->setCycleBudget(budget, n_guaranteed_stages);
+    if (shadow_solver_)
+      shadow_solver_->setCycleBudget(budget, n_guaranteed_stages);
+  }
+
+  void TaskManager::configureSolver(HiQPSolver& solver) const {
+    solver.setNullSpaceFastPath(null_space_fast_path_);
+    solver.setSparseStages(sparse_stages_);
+    solver.setRowCompression(row_compression_);
+    solver.setCycleBudget(cycle_budget_, n_guaranteed_stages_);
+  }
+
+  void TaskManager::setNumWorkerThreads(unsigned int n_threads, bool pin_threads) {
+    resource_mutex_.lock();
+    worker_pool_.setNumThreads(n_threads, pin_threads);
+    resource_mutex_.unlock();
   }
 
   bool TaskManager::getVelocityControls(RobotStatePtr robot_state,
                                         std::vector<double> &controls) {
-    if (task_map_.size() < 1) {
+    // Parameters published to the primitives, e.g. by topic callbacks, take
+    // effect here before the tasks read them. If a service call is modifying
+    // the primitives they are applied in a later cycle.
+    if (resource_mutex_.try_lock()) {
+      geometric_primitive_map_->applyPublishedParameters();
+      resource_mutex_.unlock();
+    }
+
+    const TaskSnapshot* snapshot = acquireSnapshot();
+
+    n_dropped_tasks_ = 0;
+    if (activation_margin_ >= 0)
+      updateActivation(snapshot, robot_state);
+
+    update_tasks_.clear();
+    for (unsigned int i = 0; i < snapshot->entries_.size(); ++i) {
+      const TaskSnapshotEntry& entry = snapshot->entries_[i];
+      if (!entry.active_)
+        continue;
+      if (activation_margin_ >= 0 && activation_pairs_[i] >= 0 && broad_phase_.isSeparated(activation_pairs_[i])) {
+        ++n_dropped_tasks_;
+        continue;
+      }
+      update_tasks_.push_back(entry.task_.get());
+    }
+
+    if (update_tasks_.empty()) {
+      releaseSnapshot();
       for (int i=0; i<controls.size(); ++i)
         controls.at(i) = 0;
       
       return false;
     }
 
+    updateGuaranteedLevels(snapshot);
     solver_->clearStages();
-
-    resource_mutex_.lock();
-    for (auto&& kv : task_map_) {
-      if (kv.second->getActive()) {
-        if (kv.second->update(robot_state) == 0) {
-          solver_->appendStage(kv.second->getPriority(), 
-                               kv.second->getDynamics(), 
-                               kv.second->getJacobian(),
-                               kv.second->getTaskTypes());
-        }
+    if (shadow_solver_)
+      shadow_solver_->clearStages();
+    update_results_.resize(update_tasks_.size());
+
+    // The tasks are updated concurrently, but appended in the order of the
+    // task map so that the stages do not depend on the thread scheduling
+    update_robot_state_ = robot_state;
+    worker_pool_.run(update_tasks_.size(), update_job_);
+    update_robot_state_.reset();
+
+    for (unsigned int i = 0; i < update_tasks_.size(); ++i) {
+      if (update_results_[i] == 0) {
+        solver_->appendStage(update_tasks_[i]->getPriority(), 
+                             update_tasks_[i]->getDynamics(), 
+                             update_tasks_[i]->getJacobian(),
+                             update_tasks_[i]->getTaskTypes(),
+                             update_tasks_[i]->getColumnSupport());
+        if (shadow_solver_)
+          shadow_solver_->appendStage(update_tasks_[i]->getPriority(), 
+                                      update_tasks_[i]->getDynamics(), 
+                                      update_tasks_[i]->getJacobian(),
+                                      update_tasks_[i]->getTaskTypes(),
+                                      update_tasks_[i]->getColumnSupport());
       }
     }
-    resource_mutex_.unlock();
+    releaseSnapshot();
+
+    solver_->finalizeStages();
 
-    if (!solver_->solve(controls)) {
+    std::chrono::steady_clock::time_point solve_start = std::chrono::steady_clock::now();
+    bool solved = solver_->solve(controls);
+    solver_comparison_.solve_time_ = 
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - solve_start).count();
+
+    if (shadow_solver_)
+      solveShadow(controls);
+
+    if (!solved) {
       printHiqpWarning("Unable to solve the hierarchical QP, setting the velocity controls to zero!");
       for (int i=0; i<controls.size(); ++i)
         controls.at(i) = 0;
@@ -87,23 +228,143 @@ namespace hiqp {
     return true;
   }
 
+  void TaskManager::solveShadow(const std::vector<double>& controls) {
+    shadow_solver_->finalizeStages();
+    shadow_controls_.resize(controls.size());
+
+    std::chrono::steady_clock::time_point solve_start = std::chrono::steady_clock::now();
+    solver_comparison_.shadow_solved_ = shadow_solver_->solve(shadow_controls_);
+    solver_comparison_.shadow_solve_time_ = 
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - solve_start).count();
+
+    solver_comparison_.max_deviation_ = 0;
+    for (unsigned int i = 0; i < controls.size(); ++i)
+      solver_comparison_.max_deviation_ = std::max(solver_comparison_.max_deviation_,
+                                                    std::abs(controls[i] - shadow_controls_[i]));
+  }
+
+  void TaskManager::updateGuaranteedLevels(const TaskSnapshot* snapshot) {
+    // Find the n_guaranteed_stages_ lowest priority numbers among the active
+    // tasks, the rows dropped by the broad phase only leave their stage empty
+    unsigned int n_levels = 0;
+    std::size_t level = 0;
+    while (n_levels < n_guaranteed_stages_) {
+      bool found = false;
+      std::size_t next_level = 0;
+      for (auto&& entry : snapshot->entries_) {
+        if (!entry.active_)
+          continue;
+        std::size_t priority = entry.task_->getPriority();
+        if ((n_levels == 0 || priority > level) && (!found || priority < next_level)) {
+          next_level = priority;
+          found = true;
+        }
+      }
+      if (!found)
+        break;
+      level = next_level;
+      ++n_levels;
+    }
+
+    if (n_levels == 0) {
+      solver_->setCycleBudget(cycle_budget_, 0);
+      if (shadow_solver_)
+        shadow_solver_->setCycleBudget(cycle_budget_, 0);
+      return;
+    }
+    solver_->setGuaranteedPriorityLevel(level);
+    if (shadow_solver_)
+      shadow_solver_->setGuaranteedPriorityLevel(level);
+  }
+
+  void TaskManager::updateActivation(const TaskSnapshot* snapshot, RobotStatePtr robot_state) {
+    // The primitives of the pairs are kept alive by the tasks of the snapshot,
+    // so the pairs are added anew whenever the snapshot changes
+    if (snapshot->serial_ != broad_phase_serial_ || activation_pairs_.size() != snapshot->entries_.size()) {
+      broad_phase_.clear();
+      activation_pairs_.assign(snapshot->entries_.size(), -1);
+      for (unsigned int i = 0; i < snapshot->entries_.size(); ++i) {
+        GeometricPrimitive* first = nullptr;
+        GeometricPrimitive* second = nullptr;
+        if (snapshot->entries_[i].task_->getActivationPrimitives(first, second))
+          activation_pairs_[i] = broad_phase_.addPair(first, second);
+      }
+      broad_phase_serial_ = snapshot->serial_;
+    }
+
+    if (broad_phase_.getNumPairs() > 0)
+      broad_phase_.update(robot_state, activation_margin_);
+  }
+
+  void TaskManager::publishSnapshot() {
+    TaskSnapshot* snapshot = new TaskSnapshot(++n_published_snapshots_);
+    snapshot->entries_.reserve(task_map_.size());
+    for (auto&& kv : task_map_)
+      snapshot->entries_.push_back(TaskSnapshotEntry(kv.second, kv.second->getActive(), kv.second->getMonitored()));
+
+    // The exchange and the load of the releases are sequentially consistent,
+    // as are the release and the next acquire in the control loop. Either the
+    // next acquire of the control loop returns the new snapshot, or the
+    // release before that acquire is already counted here. With
+    // release/acquire the old snapshot could be acquired again after the
+    // count was taken, and be deleted while the control loop reads it
+    const TaskSnapshot* old_snapshot = snapshot_.exchange(snapshot, std::memory_order_seq_cst);
+    ++task_set_version_;
+    retired_snapshots_.push_back(std::make_pair(old_snapshot, n_snapshot_releases_.load(std::memory_order_seq_cst)));
+
+    // A snapshot is no longer used once the control loop has released a
+    // snapshot after it was retired, the tasks only it refers to are
+    // destroyed here and not in the control loop
+    unsigned long n_releases = n_snapshot_releases_.load(std::memory_order_seq_cst);
+    std::vector< std::pair<const TaskSnapshot*, unsigned long> >::iterator it = retired_snapshots_.begin();
+    while (it != retired_snapshots_.end()) {
+      if (n_releases > it->second) {
+        delete it->first;
+        it = retired_snapshots_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  RobotStatePtr TaskManager::prepareServiceRobotState(RobotStatePtr robot_state) {
+    if (robot_state->kinematics_cache_ == nullptr)
+      return robot_state;
+
+    // The tasks read the cache of the robot state they are updated with, so
+    // the control loop keeps using its own cache afterwards
+    if (!service_robot_state_ || service_robot_state_->getNumJoints() != robot_state->getNumJoints()) {
+      service_robot_state_ = std::make_shared<RobotState>(*robot_state);
+      service_robot_state_->kinematics_cache_ = std::make_shared<KinematicsCache>(service_robot_state_->kdl_tree_);
+    } else {
+      service_robot_state_->sampling_time_point_ = robot_state->sampling_time_point_;
+      service_robot_state_->sampling_time_ = robot_state->sampling_time_;
+      service_robot_state_->kdl_jnt_array_vel_ = robot_state->kdl_jnt_array_vel_;
+      service_robot_state_->kdl_effort_ = robot_state->kdl_effort_;
+      service_robot_state_->joint_handle_info_ = robot_state->joint_handle_info_;
+      service_robot_state_->kinematics_cache_->invalidate();
+    }
+    return service_robot_state_;
+  }
+
   void TaskManager::getTaskMeasures(std::vector<TaskMeasure>& data) {
     data.clear();
-    resource_mutex_.lock();
-    for (auto&& kv : task_map_) {
-      if (kv.second->getMonitored()) {
-        kv.second->monitor();
-        data.push_back(TaskMeasure(kv.second->getTaskName(), 
-                                   kv.second->getValue(),
-                                   kv.second->getDynamics(),
-                                   kv.second->getPerformanceMeasures()));
+    const TaskSnapshot* snapshot = acquireSnapshot();
+    for (auto&& entry : snapshot->entries_) {
+      if (entry.monitored_) {
+        entry.task_->monitor();
+        data.push_back(TaskMeasure(entry.task_->getTaskName(), 
+                                   entry.task_->getValue(),
+                                   entry.task_->getDynamics(),
+                                   entry.task_->getPerformanceMeasures()));
       }
     }
-    resource_mutex_.unlock();
+    releaseSnapshot();
   }
 
   void TaskManager::renderPrimitives() {
-    resource_mutex_.lock();
+    if (!resource_mutex_.try_lock())
+      return;
     GeometricPrimitiveVisualizer geom_prim_vis(visualizer_, 0);
     geometric_primitive_map_->acceptVisitor(geom_prim_vis);
     resource_mutex_.unlock();
@@ -121,13 +382,11 @@ namespace hiqp {
     std::shared_ptr<Task> task;
     std::string action = "Added";
 
-    TaskMap::iterator it = task_map_.find(task_name);
-    if (it == task_map_.end()) {
-      task = std::make_shared<Task>(geometric_primitive_map_, visualizer_, n_controls_);
-    } else {
-      task = it->second;
+    // An existing task is replaced by a new one, since the control loop
+    // might still be using the old one
+    task = std::make_shared<Task>(geometric_primitive_map_, visualizer_, n_controls_);
+    if (task_map_.find(task_name) != task_map_.end())
       action = "Updated";
-    }
 
     task->setTaskName(task_name);
     task->setPriority(priority);
@@ -135,23 +394,54 @@ namespace hiqp {
     task->setActive(active);
     task->setMonitored(monitored);
 
-    if (task->init(def_params, dyn_params, robot_state) != 0) {
+    if (task->init(def_params, dyn_params, prepareServiceRobotState(robot_state)) != 0) {
       //printHiqpWarning("The task '" + task_name + "' was not added!");
       resource_mutex_.unlock();
       return -1;
     } else {
-      task_map_.emplace(task_name, task);
+      task_map_[task_name] = task;
+      publishSnapshot();
       printHiqpInfo(action + " task '" + task_name + "'");
     }
     resource_mutex_.unlock();
     return 0;
   }
 
+  int TaskManager::cloneActiveTasks(RobotStatePtr robot_state,
+                                     std::vector< std::shared_ptr<Task> >& tasks,
+                                     unsigned long& version) {
+    int result = 0;
+    tasks.clear();
+
+    version = task_set_version_.load();
+    for (auto&& kv : task_map_) {
+      const Task& original = *kv.second;
+      if (!kv.second->getActive())
+        continue;
+
+      std::shared_ptr<Task> task = std::make_shared<Task>(geometric_primitive_map_, visualizer_, n_controls_);
+      task->setTaskName(kv.first);
+      task->setPriority(kv.second->getPriority());
+      task->setVisible(false);
+      task->setActive(true);
+      task->setMonitored(false);
+      if (task->init(original.getDefParams(), original.getDynParams(), robot_state) != 0) {
+        printHiqpWarning("Unable to create an instance of the task '" + kv.first + "'!");
+        result = -1;
+        continue;
+      }
+      tasks.push_back(task);
+    }
+
+    return result;
+  }
+
   int TaskManager::removeTask(std::string task_name) {
     resource_mutex_.lock();
     if (task_map_.erase(task_name) == 1) 
     {
       geometric_primitive_map_->removeDependency(task_name);
+      publishSnapshot();
       resource_mutex_.unlock();
       return 0;
     }
@@ -167,6 +457,7 @@ namespace hiqp {
       ++it;
     }
     task_map_.clear();
+    publishSnapshot();
     resource_mutex_.unlock();
     return 0;
   }
@@ -214,6 +505,7 @@ namespace hiqp {
     TaskMap::iterator it = task_map_.find(task_name);
     if (it != task_map_.end()) {
       it->second->setActive(true);
+      publishSnapshot();
     } else {
       printHiqpWarning("When trying to activate task '" + task_name + "': No task with that name found.");
     }
@@ -225,6 +517,7 @@ namespace hiqp {
     TaskMap::iterator it = task_map_.find(task_name);
     if (it != task_map_.end()) {
       it->second->setActive(false);
+      publishSnapshot();
     } else {
       printHiqpWarning("When trying to deactivate task '" + task_name + "': No task with that name found.");
     }
@@ -236,6 +529,7 @@ namespace hiqp {
     TaskMap::iterator it = task_map_.find(task_name);
     if (it != task_map_.end()) {
       it->second->setMonitored(true);
+      publishSnapshot();
     } else {
       printHiqpWarning("When trying to activate monitoring of task '" + task_name + "': No task with that name found.");
     }
@@ -247,6 +541,7 @@ namespace hiqp {
     TaskMap::iterator it = task_map_.find(task_name);
     if (it != task_map_.end()) {
       it->second->setMonitored(false);
+      publishSnapshot();
     } else {
       printHiqpWarning("When trying to deactivate monitoring of task '" + task_name + "': No task with that name found.");
     }
@@ -261,6 +556,7 @@ namespace hiqp {
                                 const std::vector<double>& parameters) {
     resource_mutex_.lock();
     geometric_primitive_map_->setGeometricPrimitive(name, type, frame_id, visible, color, parameters);
+    ++task_set_version_;
     resource_mutex_.unlock();
     return 0;
   }
@@ -271,6 +567,7 @@ namespace hiqp {
     geometric_primitive_map_->acceptVisitor(geom_prim_vis, name);
     geom_prim_vis.removeAllVisitedPrimitives();
     geometric_primitive_map_->removeGeometricPrimitive(name);
+    ++task_set_version_;
     resource_mutex_.unlock();
     return 0;
   }
@@ -281,6 +578,7 @@ namespace hiqp {
     geometric_primitive_map_->acceptVisitor(geom_prim_vis);
     geom_prim_vis.removeAllVisitedPrimitives();
     geometric_primitive_map_->clear();
+    ++task_set_version_;
     resource_mutex_.unlock();
     return 0;
   }
@@ -306,6 +604,7 @@ namespace hiqp {
         ++it;
       }
     }
+    publishSnapshot();
     resource_mutex_.unlock();
   }
 
@@ -315,6 +614,7 @@ namespace hiqp {
       if (kv.second->getPriority() == priority)
         kv.second->setActive(true);
     }
+    publishSnapshot();
     resource_mutex_.unlock();
   }
 
@@ -324,6 +624,7 @@ namespace hiqp {
       if (kv.second->getPriority() == priority)
         kv.second->setActive(false);
     }
+    publishSnapshot();
     resource_mutex_.unlock();
   }
 
@@ -333,6 +634,7 @@ namespace hiqp {
       if (kv.second->getPriority() == priority)
         kv.second->setMonitored(true);
     }
+    publishSnapshot();
     resource_mutex_.unlock();
   }
 
@@ -342,6 +644,7 @@ namespace hiqp {
       if (kv.second->getPriority() == priority)
         kv.second->setMonitored(false);
     }
+    publishSnapshot();
     resource_mutex_.unlock();
   }
 
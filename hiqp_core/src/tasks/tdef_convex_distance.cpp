@@ -0,0 +1,201 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <hiqp/tasks/tdef_convex_distance.h>
+
+#include <hiqp/utilities.h>
+
+#include <iterator>
+#include <sstream>
+
+namespace hiqp
+{
+namespace tasks
+{
+
+  int TDefConvexDistance::init(const std::vector<std::string>& parameters,
+                               RobotStatePtr robot_state) {
+    int parameters_size = parameters.size();
+    if (parameters_size != 2) {
+      printHiqpWarning("'" + getTaskName() + "': TDefConvexDist takes 2 parameters, got " + std::to_string(parameters_size) + "! The task was not added!");
+      return -1;
+    }
+
+    std::stringstream ss(parameters.at(1));
+    std::vector<std::string> args(
+      std::istream_iterator<std::string>{ss},
+      std::istream_iterator<std::string>{});
+
+    if (args.size() != 3) {
+      printHiqpWarning("'" + getTaskName() + "': TDefConvexDist's parameter nr.2 needs whitespace separation! The task was not added!");
+      return -2;
+    }
+
+    unsigned int n_joints = robot_state->getNumJoints();
+    e_.resize(1);
+    J_.resize(1, n_joints);
+    performance_measures_.resize(1);
+
+    if (robot_state->kinematics_cache_ == nullptr) {
+      printHiqpWarning("In TDefConvexDistance::init(), the robot state has no kinematics cache. Unable to create task!");
+      return -5;
+    }
+
+    std::shared_ptr<GeometricPrimitiveMap> gpm = this->getGeometricPrimitiveMap();
+
+    primitive_a_ = gpm->getAnyGeometricPrimitive(args.at(0));
+    if (primitive_a_ == nullptr) {
+      printHiqpWarning("In TDefConvexDistance::init(), couldn't find primitive with name '"
+        + args.at(0) + "'. Unable to create task!");
+      return -3;
+    }
+
+    primitive_b_ = gpm->getAnyGeometricPrimitive(args.at(2));
+    if (primitive_b_ == nullptr) {
+      printHiqpWarning("In TDefConvexDistance::init(), couldn't find primitive with name '"
+        + args.at(2) + "'. Unable to create task!");
+      return -3;
+    }
+
+    KDL::Vector support;
+    if (!primitive_a_->getSupport(KDL::Vector(1, 0, 0), support) ||
+        !primitive_b_->getSupport(KDL::Vector(1, 0, 0), support)) {
+      printHiqpWarning("In TDefConvexDistance::init(), the primitives '" + args.at(0)
+        + "' and '" + args.at(2) + "' must both be bounded and convex (points, boxes, "
+        + "finite cylinders, spheres, frames or capsules). Unable to create task!");
+      return -6;
+    }
+
+    gpm->addDependencyToPrimitive(args.at(0), this->getTaskName());
+    gpm->addDependencyToPrimitive(args.at(2), this->getTaskName());
+
+    // The frames of the primitives never change, hence neither do the columns
+    // the jacobian can have nonzeros in
+    setColumnSupportFromLinks(robot_state->kdl_tree_, {primitive_a_->getFrameId(), primitive_b_->getFrameId()});
+
+    int sign = 0;
+
+    if (args.at(1).compare("<") == 0 || args.at(1).compare("<=") == 0) {
+      sign = -1;
+    } else if (args.at(1).compare("=") == 0 || args.at(1).compare("==") == 0) {
+      sign = 0;
+    } else if (args.at(1).compare(">") == 0 || args.at(1).compare(">=") == 0) {
+      sign = 1;
+    } else {
+      return -4;
+    }
+
+    task_types_.clear();
+    task_types_.insert(task_types_.begin(), 1, sign);
+
+    distance_.reset();
+    return 0;
+  }
+
+  int TDefConvexDistance::update(RobotStatePtr robot_state) {
+    int retval = 0;
+
+    // The cache of the thread that updates the task, see TaskManager::setTask()
+    KinematicsCache* kinematics_cache = robot_state->kinematics_cache_.get();
+    if (kinematics_cache == nullptr)
+      return -5;
+
+    retval = kinematics_cache->getFramePose(robot_state->kdl_jnt_array_vel_.q, primitive_a_->getFrameId(), pose_a_);
+    if (retval != 0) {
+      printHiqpWarning("In TDefConvexDistance::update(), can't get the pose of link '"
+        + primitive_a_->getFrameId() + "'! KinematicsCache::getFramePose returned error code '"
+        + std::to_string(retval) + "'");
+      return -1;
+    }
+
+    retval = kinematics_cache->getFramePose(robot_state->kdl_jnt_array_vel_.q, primitive_b_->getFrameId(), pose_b_);
+    if (retval != 0) {
+      printHiqpWarning("In TDefConvexDistance::update(), can't get the pose of link '"
+        + primitive_b_->getFrameId() + "'! KinematicsCache::getFramePose returned error code '"
+        + std::to_string(retval) + "'");
+      return -2;
+    }
+
+    retval = kinematics_cache->getFrameJacobian(robot_state->kdl_jnt_array_vel_.q, primitive_a_->getFrameId(), jacobian_a_);
+    if (retval != 0) {
+      printHiqpWarning("In TDefConvexDistance::update(), can't get the jacobian of link '"
+        + primitive_a_->getFrameId() + "'! KinematicsCache::getFrameJacobian returned error code '"
+        + std::to_string(retval) + "'");
+      return -3;
+    }
+
+    retval = kinematics_cache->getFrameJacobian(robot_state->kdl_jnt_array_vel_.q, primitive_b_->getFrameId(), jacobian_b_);
+    if (retval != 0) {
+      printHiqpWarning("In TDefConvexDistance::update(), can't get the jacobian of link '"
+        + primitive_b_->getFrameId() + "'! KinematicsCache::getFrameJacobian returned error code '"
+        + std::to_string(retval) + "'");
+      return -4;
+    }
+
+    distance_.compute(*primitive_a_, pose_a_, *primitive_b_, pose_b_);
+
+    const Eigen::Vector3d& pa = distance_.getFirstPoint();
+    const Eigen::Vector3d& pb = distance_.getSecondPoint();
+    const Eigen::Vector3d& n = distance_.getNormal();
+    KDL::Vector pa__ = KDL::Vector(pa(0), pa(1), pa(2)) - pose_a_.p;
+    KDL::Vector pb__ = KDL::Vector(pb(0), pb(1), pb(2)) - pose_b_.p;
+    KDL::Vector n_kdl(n(0), n(1), n(2));
+
+    e_(0) = distance_.getDistance();
+    performance_measures_(0) = distance_.getNumIterations();
+
+    // The witness points move with their links, and the distance changes
+    // along the normal, J = n^T (Jpb - Jpa)
+    for (int q_nr = 0; q_nr < jacobian_a_.columns(); ++q_nr) {
+      KDL::Twist Ja = jacobian_a_.getColumn(q_nr);
+      KDL::Twist Jb = jacobian_b_.getColumn(q_nr);
+      KDL::Vector Jpa = Ja.vel + Ja.rot * pa__;
+      KDL::Vector Jpb = Jb.vel + Jb.rot * pb__;
+      J_(0, q_nr) = KDL::dot(n_kdl, Jpb - Jpa);
+    }
+
+    maskJacobian(robot_state);
+    return 0;
+  }
+
+  int TDefConvexDistance::monitor() {
+    return 0;
+  }
+
+  bool TDefConvexDistance::getActivationPrimitives
+  (
+    GeometricPrimitive*& first,
+    GeometricPrimitive*& second
+  )
+  {
+    if (task_types_.size() != 1 || task_types_[0] != 1)
+      return false;
+
+    first = primitive_a_.get();
+    second = primitive_b_.get();
+    return true;
+  }
+
+  void TDefConvexDistance::maskJacobian(RobotStatePtr robot_state) {
+    for (unsigned int c=0; c<robot_state->getNumJoints(); ++c) {
+      if (!robot_state->isQNrWritable(c))
+        J_.col(c).setZero();
+    }
+  }
+
+} // namespace tasks
+
+} // namespace hiqp
@@ -56,9 +56,11 @@ namespace tasks
     // -1  0  0  0  0
     //  0 -1  0  0  0
     //  0  0  0 -1  0
+    column_support_.clear();
     for (int c=0, r=0; c<n_joints; ++c) {
       if (robot_state->isQNrWritable(c)) {
         J_(r, c) = -1;
+        column_support_.push_back(c);
         r++;
       }
     }
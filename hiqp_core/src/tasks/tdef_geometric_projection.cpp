@@ -23,9 +23,12 @@
 #include <hiqp/geometric_primitives/geometric_cylinder.h>
 #include <hiqp/geometric_primitives/geometric_sphere.h>
 #include <hiqp/geometric_primitives/geometric_frame.h>
+#include <hiqp/geometric_primitives/geometric_capsule.h>
+#include <hiqp/geometric_primitives/geometric_sdf.h>
 
 #include <hiqp/utilities.h>
 
+#include <cmath>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -35,13 +38,9 @@ namespace hiqp
 namespace tasks
 {
 
-  /// \todo Implement point-capsule projection
   /// \todo Implement cylinder-cylinder projection
   /// \todo Implement cylinder-sphere projection
-  /// \todo Implement cylinder-capsule projection
-  /// \todo Implement sphere-capsule projection
-  /// \todo Implement capsule-capsule projection
-  /// \todo Implement activation zones for all tasks
+  /// \todo Implement activation zones for tasks that keep primitives close ("<" and "="), only ">" tasks are gated, see TaskManager::setActivationMargin()
 
   ///////////////////////////////////////////////////////////////////////////////
   //  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  
@@ -240,6 +239,20 @@ namespace tasks
     return 0;
   }
 
+  template<>
+  int TDefGeometricProjection<GeometricPoint, GeometricCapsule>::project
+  (std::shared_ptr<GeometricPoint> point, std::shared_ptr<GeometricCapsule> capsule) {
+    KDL::Vector p = pose_a_.p + pose_a_.M * point->getPointKDL();
+
+    KDL::Vector v = pose_b_.M * capsule->getDirectionKDL();
+    KDL::Vector d = pose_b_.p + pose_b_.M * capsule->getOffsetKDL();
+
+    KDL::Vector p1, p2;
+    geometric_primitives::closestSegmentPoints(p, KDL::Vector::Zero(), 0, 0, d, v, 0, capsule->getHeight(), p1, p2);
+    setSegmentDistance(p1, p2, capsule->getRadius());
+    return 0;
+  }
+
 
 
 
@@ -296,6 +309,40 @@ namespace tasks
 
 
 
+  ///////////////////////////////////////////////////////////////////////////////
+  //  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  
+  // -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -
+  //-  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -
+  ///////////////////////////////////////////////////////////////////////////////
+  //
+  //                               C Y L I N D E R
+  //
+  ///////////////////////////////////////////////////////////////////////////////
+
+  /// The cylinder is treated as a capsule, i.e. the distance is underestimated
+  /// near the ends of a finite cylinder
+  template<>
+  int TDefGeometricProjection<GeometricCylinder, GeometricCapsule>::project
+  (std::shared_ptr<GeometricCylinder> cylinder, std::shared_ptr<GeometricCapsule> capsule) {
+    KDL::Vector v1 = pose_a_.M * cylinder->getDirectionKDL();
+    KDL::Vector d1 = pose_a_.p + pose_a_.M * cylinder->getOffsetKDL();
+
+    KDL::Vector v2 = pose_b_.M * capsule->getDirectionKDL();
+    KDL::Vector d2 = pose_b_.p + pose_b_.M * capsule->getOffsetKDL();
+
+    double s_min = (cylinder->isInfinite() ? -INFINITY : 0);
+    double s_max = (cylinder->isInfinite() ? INFINITY : cylinder->getHeight());
+    KDL::Vector p1, p2;
+    geometric_primitives::closestSegmentPoints(d1, v1, s_min, s_max, d2, v2, 0, capsule->getHeight(), p1, p2);
+    setSegmentDistance(p1, p2, cylinder->getRadius() + capsule->getRadius());
+    return 0;
+  }
+
+
+
+
+
+
   ///////////////////////////////////////////////////////////////////////////////
   //  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  
   // -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -
@@ -357,6 +404,83 @@ namespace tasks
     return 0;
   }
 
+  template<>
+  int TDefGeometricProjection<GeometricSphere, GeometricCapsule>::project
+  (std::shared_ptr<GeometricSphere> sphere, std::shared_ptr<GeometricCapsule> capsule) {
+    KDL::Vector c = pose_a_.p + pose_a_.M * sphere->getCenterKDL();
+
+    KDL::Vector v = pose_b_.M * capsule->getDirectionKDL();
+    KDL::Vector d = pose_b_.p + pose_b_.M * capsule->getOffsetKDL();
+
+    KDL::Vector p1, p2;
+    geometric_primitives::closestSegmentPoints(c, KDL::Vector::Zero(), 0, 0, d, v, 0, capsule->getHeight(), p1, p2);
+    setSegmentDistance(p1, p2, sphere->getRadius() + capsule->getRadius());
+    return 0;
+  }
+
+
+
+
+
+
+
+  ///////////////////////////////////////////////////////////////////////////////
+  //  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  
+  // -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -
+  //-  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -
+  ///////////////////////////////////////////////////////////////////////////////
+  //
+  //                                C A P S U L E
+  //
+  ///////////////////////////////////////////////////////////////////////////////
+
+  template<>
+  int TDefGeometricProjection<GeometricCapsule, GeometricCapsule>::project
+  (std::shared_ptr<GeometricCapsule> capsule1, std::shared_ptr<GeometricCapsule> capsule2) {
+    KDL::Vector v1 = pose_a_.M * capsule1->getDirectionKDL();
+    KDL::Vector d1 = pose_a_.p + pose_a_.M * capsule1->getOffsetKDL();
+
+    KDL::Vector v2 = pose_b_.M * capsule2->getDirectionKDL();
+    KDL::Vector d2 = pose_b_.p + pose_b_.M * capsule2->getOffsetKDL();
+
+    KDL::Vector p1, p2;
+    geometric_primitives::closestSegmentPoints(d1, v1, 0, capsule1->getHeight(), d2, v2, 0, capsule2->getHeight(), p1, p2);
+    setSegmentDistance(p1, p2, capsule1->getRadius() + capsule2->getRadius());
+    return 0;
+  }
+
+
+
+
+
+
+  ///////////////////////////////////////////////////////////////////////////////
+  //  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  
+  // -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -
+  //-  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -  -
+  ///////////////////////////////////////////////////////////////////////////////
+  //
+  //                  S I G N E D   D I S T A N C E   F I E L D
+  //
+  ///////////////////////////////////////////////////////////////////////////////
+
+  /// The task function is the signed distance, not the squared distance as 
+  /// for the other primitives, so that it stays negative inside the obstacles
+  template<>
+  int TDefGeometricProjection<GeometricPoint, GeometricSDF>::project
+  (std::shared_ptr<GeometricPoint> point, std::shared_ptr<GeometricSDF> sdf) {
+    KDL::Vector p__ = pose_a_.M * point->getPointKDL();
+    setFieldDistance(*sdf, p__, 0);
+    return 0;
+  }
+
+  template<>
+  int TDefGeometricProjection<GeometricSphere, GeometricSDF>::project
+  (std::shared_ptr<GeometricSphere> sphere, std::shared_ptr<GeometricSDF> sdf) {
+    KDL::Vector p__ = pose_a_.M * sphere->getCenterKDL();
+    setFieldDistance(*sdf, p__, sphere->getRadius());
+    return 0;
+  }
 
 
 
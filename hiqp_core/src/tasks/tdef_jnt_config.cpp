@@ -60,6 +60,7 @@ int TDefJntConfig::init(const std::vector<std::string>& parameters,
     J_(0, i) = 0;
 
   J_(0, joint_q_nr_) = -1;
+  column_support_.assign(1, joint_q_nr_);
 
   return 0;
 }
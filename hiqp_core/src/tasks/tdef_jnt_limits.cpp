@@ -68,6 +68,7 @@ namespace tasks
         J_(i, j) = (j == link_frame_q_nr_ ? 1 : 0);
       }
     }
+    column_support_.assign(1, link_frame_q_nr_);
 
     return 0;
   }
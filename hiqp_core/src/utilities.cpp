@@ -146,6 +146,22 @@ namespace hiqp
       return -1;
   }
 
+  int kdl_getAncestorQNrs(const KDL::Tree& kdl_tree,
+                          const std::string& link_name,
+                          std::vector<int>& qnrs) {
+    KDL::SegmentMap::const_iterator it = kdl_tree.getSegments().find(link_name);
+    if (it == kdl_tree.getSegments().end())
+      return -1;
+
+    KDL::SegmentMap::const_iterator root = kdl_tree.getRootSegment();
+    while (it != root) {
+      if (GetTreeElementSegment(it->second).getJoint().getType() != KDL::Joint::None)
+        qnrs.push_back(GetTreeElementQNr(it->second));
+      it = GetTreeElementParent(it->second);
+    }
+    return 0;
+  }
+
   double absMax(std::vector<double> v) {
     double f = 0;
     for (auto&& x : v)
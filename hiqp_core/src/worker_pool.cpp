@@ -0,0 +1,126 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <hiqp/worker_pool.h>
+#include <hiqp/utilities.h>
+
+#ifdef __linux__
+  #include <pthread.h>
+#endif
+
+namespace hiqp {
+
+  WorkerPool::WorkerPool()
+  : generation_(0), stop_(false), job_(nullptr), jobs_(0), n_done_(0) {}
+
+  WorkerPool::~WorkerPool() noexcept {
+    stopThreads();
+  }
+
+  void WorkerPool::setNumThreads(unsigned int n_threads, bool pin_threads) {
+    stopThreads();
+
+    stop_ = false;
+    for (unsigned int i = 0; i < n_threads; ++i) {
+      threads_.push_back(std::thread(&WorkerPool::workerLoop, this));
+
+      if (pin_threads) {
+        #ifdef __linux__
+        unsigned int n_cores = std::thread::hardware_concurrency();
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET((i + 1) % (n_cores > 0 ? n_cores : 1), &cpuset);
+        if (pthread_setaffinity_np(threads_.back().native_handle(), sizeof(cpu_set_t), &cpuset) != 0)
+          printHiqpWarning("In WorkerPool::setNumThreads(), unable to pin worker thread " + std::to_string(i) + "!");
+        #else
+        printHiqpWarning("In WorkerPool::setNumThreads(), pinning threads is only supported on linux!");
+        #endif
+      }
+    }
+  }
+
+  void WorkerPool::run(unsigned int n_jobs, const Job& job) {
+    if (n_jobs == 0)
+      return;
+
+    if (threads_.empty() || n_jobs == 1) {
+      for (unsigned int i = 0; i < n_jobs; ++i)
+        job(i);
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_ = &job;
+      n_done_.store(0);
+      jobs_.store(static_cast<uint64_t>(n_jobs) << 32);
+      ++generation_;
+    }
+    start_cv_.notify_all();
+
+    work();
+
+    // The remaining jobs are short, so wait for them without sleeping
+    while (n_done_.load(std::memory_order_acquire) < n_jobs)
+      std::this_thread::yield();
+  }
+
+  void WorkerPool::stopThreads() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto&& thread : threads_)
+      thread.join();
+    threads_.clear();
+  }
+
+  void WorkerPool::workerLoop() {
+    unsigned long last_generation = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      last_generation = generation_;
+    }
+
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_cv_.wait(lock, [&] { return stop_ || generation_ != last_generation; });
+        if (stop_)
+          return;
+        last_generation = generation_;
+      }
+      work();
+    }
+  }
+
+  void WorkerPool::work() {
+    // The number of jobs is taken together with the index, so a worker that
+    // is late for a run() can not mistake an index of that run for one of
+    // the next run
+    while (true) {
+      uint64_t jobs = jobs_.fetch_add(1);
+      unsigned int i = static_cast<unsigned int>(jobs & 0xffffffff);
+      if (i >= (jobs >> 32))
+        return;
+      (*job_)(i);
+      n_done_.fetch_add(1, std::memory_order_release);
+    }
+  }
+
+} // namespace hiqp
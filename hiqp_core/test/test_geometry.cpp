@@ -0,0 +1,550 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <hiqp/broad_phase.h>
+#include <hiqp/robot_state.h>
+#include <hiqp/geometric_primitives/aabb_tree.h>
+#include <hiqp/geometric_primitives/convex_distance.h>
+#include <hiqp/geometric_primitives/geometric_box.h>
+#include <hiqp/geometric_primitives/geometric_capsule.h>
+#include <hiqp/geometric_primitives/geometric_plane.h>
+#include <hiqp/geometric_primitives/geometric_sphere.h>
+#include <hiqp/geometric_primitives/sdf_grid.h>
+#include <hiqp/geometric_primitives/segment_distance.h>
+
+#include <gtest/gtest.h>
+
+#include <kdl/joint.hpp>
+#include <kdl/segment.hpp>
+#include <kdl/tree.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#define FD_STEP  1e-6 // step of the finite differences
+
+namespace hiqp
+{
+namespace geometric_primitives
+{
+
+  TEST(SegmentDistanceTest, SkewSegments) {
+    KDL::Vector c1, c2;
+    double d2 = closestSegmentPoints(KDL::Vector(0, 0, 0), KDL::Vector(1, 0, 0), 0, 1,
+                                     KDL::Vector(0.3, -1, 2), KDL::Vector(0, 1, 0), 0, 2, c1, c2);
+    EXPECT_NEAR(4.0, d2, 1e-12);
+    EXPECT_NEAR(0.0, (c1 - KDL::Vector(0.3, 0, 0)).Norm(), 1e-12);
+    EXPECT_NEAR(0.0, (c2 - KDL::Vector(0.3, 0, 2)).Norm(), 1e-12);
+
+    // Past the end of the second segment, its end point is the closest one
+    d2 = closestSegmentPoints(KDL::Vector(0, 0, 0), KDL::Vector(1, 0, 0), 0, 1,
+                              KDL::Vector(0.3, 1, 2), KDL::Vector(0, 1, 0), 0, 2, c1, c2);
+    EXPECT_NEAR(5.0, d2, 1e-12);
+    EXPECT_NEAR(0.0, (c2 - KDL::Vector(0.3, 1, 2)).Norm(), 1e-12);
+  }
+
+  TEST(SegmentDistanceTest, ParallelSegments) {
+    // Overlapping: any pair of opposite points in the overlap will do
+    KDL::Vector c1, c2;
+    double d2 = closestSegmentPoints(KDL::Vector(0, 0, 0), KDL::Vector(1, 0, 0), 0, 1,
+                                     KDL::Vector(0.5, 1, 0), KDL::Vector(2, 0, 0), 0, 1, c1, c2);
+    EXPECT_NEAR(1.0, d2, 1e-12);
+    EXPECT_NEAR(1.0, KDL::dot(c2 - c1, c2 - c1), 1e-12);
+    EXPECT_GE(c1.x(), 0.5 - 1e-12);
+    EXPECT_LE(c1.x(), 1.0 + 1e-12);
+    EXPECT_NEAR(c1.x(), c2.x(), 1e-12);
+
+    // Disjoint: the facing end points, also with opposite directions
+    d2 = closestSegmentPoints(KDL::Vector(0, 0, 0), KDL::Vector(1, 0, 0), 0, 1,
+                              KDL::Vector(3, 1, 0), KDL::Vector(-1, 0, 0), 0, 1, c1, c2);
+    EXPECT_NEAR(2.0, d2, 1e-12);
+    EXPECT_NEAR(0.0, (c1 - KDL::Vector(1, 0, 0)).Norm(), 1e-12);
+    EXPECT_NEAR(0.0, (c2 - KDL::Vector(2, 1, 0)).Norm(), 1e-12);
+  }
+
+  TEST(SegmentDistanceTest, PointsAndLines) {
+    KDL::Vector c1, c2;
+
+    // A point, given by equal bounds, and a segment
+    double d2 = closestSegmentPoints(KDL::Vector(2, 1, 0), KDL::Vector(1, 0, 0), 0, 0,
+                                     KDL::Vector(0, 0, 0), KDL::Vector(1, 0, 0), 0, 1, c1, c2);
+    EXPECT_NEAR(2.0, d2, 1e-12);
+    EXPECT_NEAR(0.0, (c1 - KDL::Vector(2, 1, 0)).Norm(), 1e-12);
+    EXPECT_NEAR(0.0, (c2 - KDL::Vector(1, 0, 0)).Norm(), 1e-12);
+
+    // A point, given by a zero direction, and a line
+    d2 = closestSegmentPoints(KDL::Vector(5, 3, 0), KDL::Vector::Zero(), 0, 1,
+                              KDL::Vector(0, 0, 0), KDL::Vector(1, 0, 0), -INFINITY, INFINITY, c1, c2);
+    EXPECT_NEAR(9.0, d2, 1e-12);
+    EXPECT_NEAR(0.0, (c2 - KDL::Vector(5, 0, 0)).Norm(), 1e-12);
+
+    // Two points
+    d2 = closestSegmentPoints(KDL::Vector(1, 2, 3), KDL::Vector::Zero(), 0, 0,
+                              KDL::Vector(1, 2, 5), KDL::Vector::Zero(), 0, 0, c1, c2);
+    EXPECT_NEAR(4.0, d2, 1e-12);
+
+    // Two parallel lines
+    d2 = closestSegmentPoints(KDL::Vector(0, 0, 0), KDL::Vector(0, 0, 1), -INFINITY, INFINITY,
+                              KDL::Vector(3, 4, 7), KDL::Vector(0, 0, -2), -INFINITY, INFINITY, c1, c2);
+    EXPECT_NEAR(25.0, d2, 1e-12);
+  }
+
+  TEST(SegmentDistanceTest, GradientMatchesFiniteDifferences) {
+    // The closest points sliding along the segments do not change the
+    // squared distance to first order, its gradient with respect to the
+    // start of the second segment is 2 (c2 - c1)
+    const KDL::Vector p1(0.1, -0.2, 0.3), d1(0.4, 0.9, -0.2);
+    const KDL::Vector d2(-0.7, 0.1, 0.5);
+    const KDL::Vector starts[] = { KDL::Vector(0.5, 0.6, -0.8),   // interior points
+                                   KDL::Vector(2.0, 1.5, 1.0),    // clamped first segment
+                                   KDL::Vector(-1.0, -2.0, 0.5) };// both clamped
+
+    for (const KDL::Vector& p2 : starts) {
+      KDL::Vector c1, c2;
+      closestSegmentPoints(p1, d1, 0, 1, p2, d2, 0, 1, c1, c2);
+      KDL::Vector gradient = 2 * (c2 - c1);
+
+      for (int k = 0; k < 3; ++k) {
+        KDL::Vector step = KDL::Vector::Zero();
+        step(k) = FD_STEP;
+        KDL::Vector unused1, unused2;
+        double forward = closestSegmentPoints(p1, d1, 0, 1, p2 + step, d2, 0, 1, unused1, unused2);
+        double backward = closestSegmentPoints(p1, d1, 0, 1, p2 - step, d2, 0, 1, unused1, unused2);
+        EXPECT_NEAR(gradient(k), (forward - backward) / (2 * FD_STEP), 1e-6);
+      }
+    }
+  }
+
+  /// Writes a grid sampled from a function to a temporary file and loads it
+  class SDFGridTest : public ::testing::Test {
+  protected:
+    void TearDown() {
+      if (!path_.empty())
+        unlink(path_.c_str());
+    }
+
+    void loadGrid(const std::function<double(const Eigen::Vector3d&)>& f) {
+      char path[] = "/tmp/hiqp_test_sdf_XXXXXX";
+      int fd = mkstemp(path);
+      ASSERT_GE(fd, 0);
+      close(fd);
+      path_ = path;
+
+      const uint32_t n[3] = {N_SAMPLES, N_SAMPLES, N_SAMPLES};
+      const uint32_t padding = 0;
+      const double origin[3] = {ORIGIN, ORIGIN, ORIGIN};
+      const double voxel_size = VOXEL_SIZE;
+      std::FILE* file = std::fopen(path, "wb");
+      ASSERT_NE(nullptr, file);
+      std::fwrite("HIQPSDF1", 1, 8, file);
+      std::fwrite(n, sizeof(uint32_t), 3, file);
+      std::fwrite(&padding, sizeof(uint32_t), 1, file);
+      std::fwrite(origin, sizeof(double), 3, file);
+      std::fwrite(&voxel_size, sizeof(double), 1, file);
+      for (unsigned int k = 0; k < N_SAMPLES; ++k) {
+        for (unsigned int j = 0; j < N_SAMPLES; ++j) {
+          for (unsigned int i = 0; i < N_SAMPLES; ++i) {
+            float d = f(samplePosition(i, j, k));
+            std::fwrite(&d, sizeof(float), 1, file);
+          }
+        }
+      }
+      std::fclose(file);
+
+      ASSERT_EQ(0, grid_.load(path_));
+    }
+
+    static Eigen::Vector3d samplePosition(unsigned int i, unsigned int j, unsigned int k) {
+      return Eigen::Vector3d(ORIGIN, ORIGIN, ORIGIN) + VOXEL_SIZE * Eigen::Vector3d(i, j, k);
+    }
+
+    /// Compares the gradient of the grid at p with central finite differences
+    void expectGradient(const Eigen::Vector3d& p, double tolerance) {
+      Eigen::Vector3d gradient, unused;
+      grid_.getDistance(p, gradient);
+      for (int k = 0; k < 3; ++k) {
+        Eigen::Vector3d step = Eigen::Vector3d::Zero();
+        step(k) = FD_STEP;
+        double forward = grid_.getDistance(p + step, unused);
+        double backward = grid_.getDistance(p - step, unused);
+        EXPECT_NEAR(gradient(k), (forward - backward) / (2 * FD_STEP), tolerance) << "at " << p.transpose();
+      }
+    }
+
+    static const unsigned int N_SAMPLES = 11;
+    static constexpr double ORIGIN = -1.0;
+    static constexpr double VOXEL_SIZE = 0.2;
+
+    std::string path_;
+    SDFGrid grid_;
+  };
+
+  constexpr double SDFGridTest::ORIGIN;
+  constexpr double SDFGridTest::VOXEL_SIZE;
+
+  TEST_F(SDFGridTest, LinearFieldIsInterpolatedExactly) {
+    // Trilinear interpolation reproduces a linear field and its gradient
+    const Eigen::Vector3d a(0.3, -0.5, 0.8);
+    loadGrid([&](const Eigen::Vector3d& x) { return a.dot(x) + 0.25; });
+
+    const Eigen::Vector3d points[] = { Eigen::Vector3d(0.13, -0.41, 0.77),
+                                       Eigen::Vector3d(-0.95, 0.05, 0.5),
+                                       Eigen::Vector3d(0.2, 0.4, -0.6) }; // a sample
+    for (const Eigen::Vector3d& p : points) {
+      Eigen::Vector3d gradient;
+      EXPECT_NEAR(a.dot(p) + 0.25, grid_.getDistance(p, gradient), 1e-6);
+      EXPECT_NEAR(0.0, (gradient - a).norm(), 1e-6);
+    }
+  }
+
+  TEST_F(SDFGridTest, SphereFieldInsideTheGrid) {
+    const double radius = 0.5;
+    loadGrid([&](const Eigen::Vector3d& x) { return x.norm() - radius; });
+
+    // The samples are reproduced up to float precision
+    Eigen::Vector3d gradient;
+    for (unsigned int i = 0; i < N_SAMPLES; i += 3) {
+      Eigen::Vector3d x = samplePosition(i, 7, 2);
+      EXPECT_NEAR(x.norm() - radius, grid_.getDistance(x, gradient), 1e-6);
+    }
+
+    // Between the samples the interpolation error is of the order of the
+    // curvature times the voxel size squared, and the gradient is that of
+    // the interpolated field
+    const Eigen::Vector3d points[] = { Eigen::Vector3d(0.71, 0.13, -0.25),
+                                       Eigen::Vector3d(-0.33, -0.47, 0.05),
+                                       Eigen::Vector3d(0.09, 0.31, 0.65) };
+    for (const Eigen::Vector3d& p : points) {
+      EXPECT_NEAR(p.norm() - radius, grid_.getDistance(p, gradient), VOXEL_SIZE * VOXEL_SIZE);
+      EXPECT_NEAR(0.0, (gradient - p.normalized()).norm(), 0.2);
+      expectGradient(p, 1e-6);
+    }
+
+    EXPECT_FALSE(grid_.getSurfaceSamples().empty());
+    for (auto&& x : grid_.getSurfaceSamples())
+      EXPECT_LE(x.norm() - radius, 1e-6);
+  }
+
+  TEST_F(SDFGridTest, FieldIsExtendedOutsideTheGrid) {
+    const Eigen::Vector3d a(0.3, -0.5, 0.8);
+    loadGrid([&](const Eigen::Vector3d& x) { return a.dot(x); });
+
+    // Outside the grid the distance is that of the closest point on the grid
+    // plus the distance to it, beyond a face and beyond a corner
+    const Eigen::Vector3d points[] = { Eigen::Vector3d(1.5, 0.13, -0.27),
+                                       Eigen::Vector3d(-1.4, 1.3, 1.7) };
+    for (const Eigen::Vector3d& p : points) {
+      Eigen::Vector3d q = p.cwiseMax(grid_.getBounds().min()).cwiseMin(grid_.getBounds().max());
+      Eigen::Vector3d gradient;
+      EXPECT_NEAR(a.dot(q) + (p - q).norm(), grid_.getDistance(p, gradient), 1e-6);
+      expectGradient(p, 1e-6);
+    }
+  }
+
+  /// Pairs of primitives with analytic distances
+  class ConvexDistanceTest : public ::testing::Test {
+  protected:
+    ConvexDistanceTest()
+    : color_({1, 0, 0, 1}),
+      sphere1_("sphere1", "world", false, color_),
+      sphere2_("sphere2", "world", false, color_),
+      box_("box", "world", false, color_),
+      capsule1_("capsule1", "world", false, color_),
+      capsule2_("capsule2", "world", false, color_) {}
+
+    /// Compares the normal with the finite differences of the distance when the second primitive is moved
+    void expectNormal(GeometricPrimitive& first, const KDL::Frame& first_pose,
+                      GeometricPrimitive& second, const KDL::Frame& second_pose,
+                      double tolerance) {
+      ASSERT_EQ(0, distance_.compute(first, first_pose, second, second_pose));
+      Eigen::Vector3d normal = distance_.getNormal();
+
+      ConvexDistance probe;
+      for (int k = 0; k < 3; ++k) {
+        KDL::Frame moved = second_pose;
+        moved.p(k) += FD_STEP;
+        ASSERT_EQ(0, probe.compute(first, first_pose, second, moved));
+        double forward = probe.getDistance();
+        moved.p(k) -= 2 * FD_STEP;
+        ASSERT_EQ(0, probe.compute(first, first_pose, second, moved));
+        double backward = probe.getDistance();
+        EXPECT_NEAR(normal(k), (forward - backward) / (2 * FD_STEP), tolerance);
+      }
+    }
+
+    std::vector<double>   color_;
+    GeometricSphere       sphere1_;
+    GeometricSphere       sphere2_;
+    GeometricBox          box_;
+    GeometricCapsule      capsule1_;
+    GeometricCapsule      capsule2_;
+    ConvexDistance        distance_;
+  };
+
+  TEST_F(ConvexDistanceTest, SphereSphere) {
+    sphere1_.init({0.1, 0, 0, 0.5});
+    sphere2_.init({0, 0.2, 0, 0.3});
+    KDL::Frame pose1(KDL::Rotation::RPY(0.1, 0.2, 0.3), KDL::Vector(0.5, -0.5, 1));
+    const Eigen::Vector3d c1(0.1 * cos(0.3) * cos(0.2) + 0.5,
+                             0.1 * sin(0.3) * cos(0.2) - 0.5,
+                             -0.1 * sin(0.2) + 1);
+    const Eigen::Vector3d direction = Eigen::Vector3d(1, 2, -2).normalized();
+
+    // Separated, touching and penetrating
+    const double gaps[] = {0.4, 0.0, -0.2};
+    for (double gap : gaps) {
+      Eigen::Vector3d c2 = c1 + (0.8 + gap) * direction;
+      KDL::Frame pose2(KDL::Rotation::Identity(), KDL::Vector(c2(0), c2(1) - 0.2, c2(2)));
+
+      distance_.reset();
+      ASSERT_EQ(0, distance_.compute(sphere1_, pose1, sphere2_, pose2));
+      EXPECT_NEAR(gap, distance_.getDistance(), 1e-6) << "gap " << gap;
+      EXPECT_NEAR(0.0, (distance_.getNormal() - direction).norm(), 1e-3) << "gap " << gap;
+      EXPECT_NEAR(0.0, (distance_.getFirstPoint() - (c1 + 0.5 * direction)).norm(), 1e-3) << "gap " << gap;
+      EXPECT_NEAR(0.0, (distance_.getSecondPoint() - (c2 - 0.3 * direction)).norm(), 1e-3) << "gap " << gap;
+    }
+  }
+
+  TEST_F(ConvexDistanceTest, SphereBox) {
+    // A box of 2 x 1 x 0.5 rotated about z, in its own axes the distance is
+    // that of the sphere's center to the box minus the radius
+    box_.init({0, 0, 0, 2, 1, 0.5, 0, 0, 0.4});
+    KDL::Frame box_pose(KDL::Rotation::Identity(), KDL::Vector(0, 0, 1));
+    const Eigen::Matrix3d R = Eigen::AngleAxisd(0.4, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+    const Eigen::Vector3d half_extents(1, 0.5, 0.25);
+    const double radius = 0.2;
+    sphere1_.init({0, 0, 0, radius});
+
+    const Eigen::Vector3d centers[] = { Eigen::Vector3d(1.5, 0.1, 0.05),    // off a face
+                                        Eigen::Vector3d(1.3, 0.9, 0.6),     // off a corner
+                                        Eigen::Vector3d(0.85, 0.1, 0.05) }; // penetrating a face
+    const double expected[] = { 0.5 - radius,
+                                Eigen::Vector3d(0.3, 0.4, 0.35).norm() - radius,
+                                -(0.15 + radius) };
+
+    for (int i = 0; i < 3; ++i) {
+      Eigen::Vector3d c = R * centers[i] + Eigen::Vector3d(0, 0, 1);
+      KDL::Frame sphere_pose(KDL::Rotation::Identity(), KDL::Vector(c(0), c(1), c(2)));
+
+      distance_.reset();
+      ASSERT_EQ(0, distance_.compute(box_, box_pose, sphere1_, sphere_pose));
+      EXPECT_NEAR(expected[i], distance_.getDistance(), 1e-5) << "center " << i;
+      expectNormal(box_, box_pose, sphere1_, sphere_pose, 1e-3);
+    }
+  }
+
+  TEST_F(ConvexDistanceTest, CapsuleCapsule) {
+    capsule1_.init({1, 0, 0, -0.5, 0, 0, 0.1, 1});
+    capsule2_.init({0, 1, 1, 0, 0, 0, 0.2, 0.8});
+    KDL::Frame pose1(KDL::Rotation::RPY(0.3, -0.2, 0.5), KDL::Vector(0.1, 0.2, 0.3));
+
+    const KDL::Vector offsets[] = { KDL::Vector(0.2, -0.4, 0.9),    // separated
+                                    KDL::Vector(0.6, 0.5, -0.2),    // separated, end points closest
+                                    KDL::Vector(0.05, 0.1, 0.15) }; // penetrating
+    for (const KDL::Vector& offset : offsets) {
+      KDL::Frame pose2(KDL::Rotation::RPY(-0.4, 0.1, 0.2), pose1.p + offset);
+
+      // The analytic distance is that of the segments minus the radii
+      KDL::Vector c1, c2;
+      double d2 = closestSegmentPoints(pose1 * capsule1_.getOffsetKDL(), pose1.M * capsule1_.getDirectionKDL(), 0, capsule1_.getHeight(),
+                                       pose2 * capsule2_.getOffsetKDL(), pose2.M * capsule2_.getDirectionKDL(), 0, capsule2_.getHeight(),
+                                       c1, c2);
+      double expected = std::sqrt(d2) - capsule1_.getRadius() - capsule2_.getRadius();
+
+      distance_.reset();
+      ASSERT_EQ(0, distance_.compute(capsule1_, pose1, capsule2_, pose2));
+      EXPECT_NEAR(expected, distance_.getDistance(), 1e-5);
+      expectNormal(capsule1_, pose1, capsule2_, pose2, 1e-3);
+    }
+  }
+
+  TEST_F(ConvexDistanceTest, WarmStartConvergesFaster) {
+    capsule1_.init({1, 0, 0, -0.5, 0, 0, 0.1, 1});
+    box_.init({0, 0, 0, 0.3, 0.4, 0.5, 0.2, 0.3, 0.1});
+    KDL::Frame pose1(KDL::Rotation::RPY(0.3, -0.2, 0.5), KDL::Vector(0.1, 0.2, 0.3));
+    KDL::Frame pose2(KDL::Rotation::RPY(-0.4, 0.1, 0.2), KDL::Vector(0.4, 0.9, 0.7));
+
+    ASSERT_EQ(0, distance_.compute(capsule1_, pose1, box_, pose2));
+    unsigned int cold_iterations = distance_.getNumIterations();
+
+    // A small motion, as between two control cycles
+    for (int cycle = 0; cycle < 10; ++cycle) {
+      pose2.p += KDL::Vector(1e-3, -2e-3, 1e-3);
+      ASSERT_EQ(0, distance_.compute(capsule1_, pose1, box_, pose2));
+      EXPECT_LE(distance_.getNumIterations(), 3u);
+
+      ConvexDistance cold;
+      ASSERT_EQ(0, cold.compute(capsule1_, pose1, box_, pose2));
+      EXPECT_NEAR(cold.getDistance(), distance_.getDistance(), 1e-6);
+    }
+    EXPECT_GT(cold_iterations, 3u);
+  }
+
+  /// Random boxes, the queries of the tree are compared with a search over all of them
+  class AABBTreeTest : public ::testing::Test {
+  protected:
+    AABBTreeTest() : generator_(42) {}
+
+    Eigen::AlignedBox3d randomBox(double extent, double size) {
+      std::uniform_real_distribution<double> position(-extent, extent);
+      std::uniform_real_distribution<double> sizes(0.01, size);
+      Eigen::Vector3d min(position(generator_), position(generator_), position(generator_));
+      return Eigen::AlignedBox3d(min, min + Eigen::Vector3d(sizes(generator_), sizes(generator_), sizes(generator_)));
+    }
+
+    void expectQueriesMatch(unsigned int n_queries) {
+      for (unsigned int q = 0; q < n_queries; ++q) {
+        Eigen::AlignedBox3d bounds = randomBox(1.0, 0.5);
+
+        std::vector<int> found;
+        tree_.query(bounds, found);
+        std::sort(found.begin(), found.end());
+
+        std::vector<int> expected;
+        for (int proxy : proxies_) {
+          if (proxy >= 0 && tree_.getFatBounds(proxy).intersects(bounds))
+            expected.push_back(proxy);
+        }
+        std::sort(expected.begin(), expected.end());
+        EXPECT_EQ(expected, found);
+      }
+    }
+
+    std::mt19937        generator_;
+    AABBTree            tree_;
+    std::vector<int>    proxies_; // -1 for destroyed ones
+  };
+
+  TEST_F(AABBTreeTest, QueriesFindTheIntersectingProxies) {
+    const unsigned int n = 200;
+    for (unsigned int i = 0; i < n; ++i) {
+      Eigen::AlignedBox3d bounds = randomBox(1.0, 0.2);
+      proxies_.push_back(tree_.createProxy(bounds, i));
+      EXPECT_TRUE(tree_.getFatBounds(proxies_.back()).contains(bounds));
+    }
+    EXPECT_EQ(n, tree_.getNumProxies());
+    for (unsigned int i = 0; i < n; ++i)
+      EXPECT_EQ(static_cast<int>(i), tree_.getUserData(proxies_[i]));
+
+    // The rotations keep the tree balanced
+    EXPECT_LE(tree_.getHeight(), 2 * std::log2(n));
+    expectQueriesMatch(100);
+  }
+
+  TEST_F(AABBTreeTest, MovedAndDestroyedProxies) {
+    tree_.setFatMargin(0.05);
+    for (unsigned int i = 0; i < 100; ++i)
+      proxies_.push_back(tree_.createProxy(randomBox(1.0, 0.2), i));
+
+    // Within the fat box a proxy stays where it is, beyond it it is reinserted
+    Eigen::AlignedBox3d fat_bounds = tree_.getFatBounds(proxies_[0]);
+    Eigen::AlignedBox3d bounds(fat_bounds.min().array() + 0.05, fat_bounds.max().array() - 0.05);
+    bounds.translate(Eigen::Vector3d(0.02, -0.02, 0.01));
+    EXPECT_FALSE(tree_.moveProxy(proxies_[0], bounds));
+    bounds.translate(Eigen::Vector3d(0.5, 0, 0));
+    EXPECT_TRUE(tree_.moveProxy(proxies_[0], bounds));
+    EXPECT_TRUE(tree_.getFatBounds(proxies_[0]).contains(bounds));
+
+    for (unsigned int i = 1; i < proxies_.size(); i += 3)
+      tree_.moveProxy(proxies_[i], randomBox(1.0, 0.2));
+    for (unsigned int i = 2; i < proxies_.size(); i += 3) {
+      tree_.destroyProxy(proxies_[i]);
+      proxies_[i] = -1;
+    }
+    EXPECT_EQ(100u - 33u, tree_.getNumProxies());
+    expectQueriesMatch(100);
+
+    tree_.clear();
+    EXPECT_EQ(0u, tree_.getNumProxies());
+    EXPECT_EQ(0, tree_.getHeight());
+  }
+
+  /// A sphere fixed in the world, one on a prismatic joint along x, and a plane
+  class BroadPhaseTest : public ::testing::Test {
+  protected:
+    BroadPhaseTest()
+    : color_({1, 0, 0, 1}),
+      fixed_("fixed", "world", false, color_),
+      moving_("moving", "link1", false, color_),
+      plane_("plane", "world", false, color_),
+      state_(std::make_shared<RobotState>()) {}
+
+    void SetUp() {
+      fixed_.init({0, 0, 0, 0.1});
+      moving_.init({0, 0, 0, 0.1});
+      plane_.init({0, 0, 1, -1});
+
+      state_->kdl_tree_ = KDL::Tree("world");
+      state_->kdl_tree_.addSegment(KDL::Segment("link1", KDL::Joint("joint1", KDL::Joint::TransX)), "world");
+      state_->kdl_jnt_array_vel_.resize(1);
+      state_->kinematics_cache_ = std::make_shared<KinematicsCache>(state_->kdl_tree_);
+    }
+
+    void setJointPosition(double q) {
+      state_->kdl_jnt_array_vel_.q(0) = q;
+      state_->kinematics_cache_->invalidate();
+    }
+
+    std::vector<double>          color_;
+    GeometricSphere              fixed_;
+    GeometricSphere              moving_;
+    GeometricPlane               plane_;
+    std::shared_ptr<RobotState>  state_;
+  };
+
+  TEST_F(BroadPhaseTest, PairsFurtherApartThanTheMarginAreSeparated) {
+    BroadPhase broad_phase;
+    unsigned int pair = broad_phase.addPair(&fixed_, &moving_);
+    unsigned int reversed = broad_phase.addPair(&moving_, &fixed_);
+    unsigned int unbounded = broad_phase.addPair(&fixed_, &plane_);
+    EXPECT_EQ(3u, broad_phase.getNumPairs());
+
+    // The gap between the bounds of the spheres is q - 0.2, the margin 0.05
+    const double positions[] = {1.0, 0.3, 0.24, 0.0, 1.0};
+    for (double q : positions) {
+      setJointPosition(q);
+      ASSERT_EQ(0, broad_phase.update(state_, 0.05));
+      EXPECT_EQ(q - 0.2 > 0.05, broad_phase.isSeparated(pair)) << "q " << q;
+      EXPECT_EQ(q - 0.2 > 0.05, broad_phase.isSeparated(reversed)) << "q " << q;
+      EXPECT_FALSE(broad_phase.isSeparated(unbounded)) << "q " << q;
+    }
+
+    // Without the pose of a primitive no pair is separated
+    GeometricSphere lost("lost", "no_such_link", false, color_);
+    lost.init({0, 0, 0, 0.1});
+    broad_phase.addPair(&lost, &fixed_);
+    setJointPosition(1.0);
+    EXPECT_EQ(-1, broad_phase.update(state_, 0.05));
+    EXPECT_FALSE(broad_phase.isSeparated(pair));
+  }
+
+} // namespace geometric_primitives
+
+} // namespace hiqp
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,334 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <hiqp/solvers/active_set_solver.h>
+#include <hiqp/solvers/decoupled_solver.h>
+#include <hiqp/solvers/reduced_space_solver.h>
+#ifdef HIQP_GUROBI
+#include <hiqp/solvers/gurobi_solver.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace hiqp
+{
+
+  /// A hierarchy with an equality-only highest stage followed by an inequality stage
+  class SolversTest : public ::testing::Test {
+  protected:
+    void SetUp() {
+      n_ = 7;
+      solution_.resize(n_);
+
+      J_top_ = Eigen::MatrixXd::Random(2, n_);
+      e_top_ = Eigen::VectorXd::Random(2);
+      signs_top_.assign(2, 0);
+
+      J_limits_ = Eigen::MatrixXd::Zero(2, n_);
+      J_limits_(0, n_ - 1) = 1;
+      J_limits_(1, n_ - 1) = 1;
+      e_limits_.resize(2);
+      e_limits_ << -0.1, 0.1;
+      signs_limits_ = {1, -1};
+
+      J_pose_ = -Eigen::MatrixXd::Identity(n_, n_);
+      e_pose_ = Eigen::VectorXd::Random(n_);
+      signs_pose_.assign(n_, 0);
+    }
+
+    void assembleStages(HiQPSolver& solver) {
+      solver.clearStages();
+      solver.appendStage(0, e_top_, J_top_, signs_top_);
+      solver.appendStage(1, e_limits_, J_limits_, signs_limits_);
+      solver.appendStage(2, e_pose_, J_pose_, signs_pose_);
+      solver.finalizeStages();
+    }
+
+    /// Returns the residual of the highest stage for the current solution
+    double topResidual() const {
+      Eigen::Map<const Eigen::VectorXd> dq(solution_.data(), n_);
+      return (J_top_ * dq - e_top_).norm();
+    }
+
+    unsigned int            n_;
+    std::vector<double>     solution_;
+
+    Eigen::MatrixXd         J_top_, J_limits_, J_pose_;
+    Eigen::VectorXd         e_top_, e_limits_, e_pose_;
+    std::vector<int>        signs_top_, signs_limits_, signs_pose_;
+  };
+
+  /// Stage 1 acts only in directions stage 0 fixed, which the stage 2 rows must not lose
+  class FixedDirectionsTest : public ::testing::Test {
+  protected:
+    void SetUp() {
+      n_ = 6;
+
+      // The stages act on blocks of the coordinates of a random rotation
+      Eigen::HouseholderQR<Eigen::MatrixXd> qr(Eigen::MatrixXd::Random(n_, n_));
+      Eigen::MatrixXd R = qr.householderQ();
+
+      J_.resize(3);
+      e_.resize(3);
+      J_[0] = Eigen::MatrixXd::Random(3, 3) * R.topRows(3);
+      J_[1] = Eigen::MatrixXd::Random(2, 3) * R.topRows(3);
+      J_[2] = Eigen::MatrixXd::Random(3, 3) * R.bottomRows(3);
+      for (int k = 0; k < 3; ++k)
+        e_[k] = Eigen::VectorXd::Random(J_[k].rows());
+    }
+
+    /// Solves the hierarchy, and returns the residuals of the stages
+    Eigen::Vector3d solve(HiQPSolver& solver) {
+      std::vector<double> solution(n_);
+      solver.clearStages();
+      for (int k = 0; k < 3; ++k)
+        solver.appendStage(k, e_[k], J_[k], std::vector<int>(J_[k].rows(), 0));
+      solver.finalizeStages();
+      EXPECT_TRUE(solver.solve(solution));
+
+      Eigen::Map<const Eigen::VectorXd> dq(solution.data(), n_);
+      Eigen::Vector3d residuals;
+      for (int k = 0; k < 3; ++k)
+        residuals(k) = (J_[k] * dq - e_[k]).norm();
+      return residuals;
+    }
+
+    unsigned int                    n_;
+    std::vector<Eigen::MatrixXd>    J_;
+    std::vector<Eigen::VectorXd>    e_;
+  };
+
+  TEST_F(FixedDirectionsTest, NullSpaceFastPathKeepsFreedomOfLowerStages) {
+    for (int k = 0; k < 20; ++k) {
+      SetUp();
+      ActiveSetSolver cascade;
+      cascade.init(n_);
+      Eigen::Vector3d expected = solve(cascade);
+
+      ActiveSetSolver fast_path;
+      fast_path.init(n_);
+      fast_path.setNullSpaceFastPath(true);
+      Eigen::Vector3d residuals = solve(fast_path);
+
+      EXPECT_LT(residuals(0), 1e-6);
+      EXPECT_NEAR(expected(1), residuals(1), 1e-4);
+      EXPECT_NEAR(expected(2), residuals(2), 1e-4);
+    }
+  }
+
+  TEST_F(FixedDirectionsTest, ReducedSpaceMatchesActiveSet) {
+    for (int k = 0; k < 20; ++k) {
+      SetUp();
+      ActiveSetSolver active_set;
+      active_set.init(n_);
+      Eigen::Vector3d expected = solve(active_set);
+
+      ReducedSpaceSolver reduced;
+      reduced.init(n_);
+      Eigen::Vector3d residuals = solve(reduced);
+
+      EXPECT_LT(residuals(0), 1e-6);
+      EXPECT_NEAR(expected(1), residuals(1), 1e-4);
+      EXPECT_NEAR(expected(2), residuals(2), 1e-4);
+    }
+  }
+
+  TEST(GuaranteedStagesTest, EmptyGuaranteedLevelDoesNotGuaranteeLowerLevels) {
+    const unsigned int n = 4;
+    std::vector<double> solution(n);
+    Eigen::MatrixXd J = Eigen::MatrixXd::Identity(n, n);
+    Eigen::VectorXd e = Eigen::VectorXd::Ones(n);
+    std::vector<int> signs(n, 0);
+
+    // Level 0 got no rows in this cycle, only levels 1 and 2 have stages
+    ActiveSetSolver solver;
+    solver.init(n);
+    auto solveLevels = [&]() {
+      solver.clearStages();
+      solver.appendStage(1, e, J, signs);
+      solver.appendStage(2, -e, J, signs);
+      solver.finalizeStages();
+      solver.solve(solution);
+      return solver.getNumSolvedStages();
+    };
+
+    // Both stages take longer than the budget once they have been timed
+    solver.setCycleBudget(1e-12, 2);
+    EXPECT_EQ(2u, solveLevels());
+
+    solver.setGuaranteedPriorityLevel(0);
+    EXPECT_EQ(0u, solveLevels());
+
+    solver.setGuaranteedPriorityLevel(1);
+    EXPECT_EQ(1u, solveLevels());
+
+    solver.setCycleBudget(1e-12, 1);
+    EXPECT_EQ(1u, solveLevels());
+  }
+
+  TEST(GuaranteedStagesTest, StageDurationsFollowPriorityLevels) {
+    const unsigned int n = 4;
+    std::vector<double> solution(n);
+    Eigen::MatrixXd J = Eigen::MatrixXd::Identity(n, n);
+    Eigen::VectorXd e = Eigen::VectorXd::Ones(n);
+    std::vector<int> signs(n, 0);
+
+    ActiveSetSolver solver;
+    solver.init(n);
+    solver.setCycleBudget(1.0, 3);
+    solver.appendStage(0, e, J, signs);
+    solver.appendStage(1, -e, J, signs);
+    solver.appendStage(2, e, J, signs);
+    solver.finalizeStages();
+    EXPECT_TRUE(solver.solve(solution));
+    const double level1_duration = solver.getLevelDuration(1);
+    EXPECT_GT(level1_duration, 0.0);
+
+    // Level 1 has no rows, level 2 becomes the second stage
+    solver.clearStages();
+    solver.appendStage(0, e, J, signs);
+    solver.appendStage(2, -e, J, signs);
+    solver.finalizeStages();
+    EXPECT_TRUE(solver.solve(solution));
+    EXPECT_EQ(level1_duration, solver.getLevelDuration(1));
+    EXPECT_GT(solver.getLevelDuration(2), 0.0);
+  }
+
+  TEST(GuaranteedStagesTest, NoGuaranteedStagesAndExhaustedBudgetFails) {
+    const unsigned int n = 4;
+    Eigen::MatrixXd J = Eigen::MatrixXd::Identity(n, n);
+    Eigen::VectorXd e = Eigen::VectorXd::Ones(n);
+    std::vector<int> signs(n, 0);
+
+    ActiveSetSolver active_set;
+    ReducedSpaceSolver reduced;
+    for (HiQPSolver* solver : std::vector<HiQPSolver*>{&active_set, &reduced}) {
+      solver->init(n);
+      std::vector<double> solution(n, 0.0);
+      auto solve = [&]() {
+        solver->clearStages();
+        solver->appendStage(0, e, J, signs);
+        solver->appendStage(1, -e, J, signs);
+        solver->finalizeStages();
+        return solver->solve(solution);
+      };
+
+      // Time the stages, then leave them no budget and no guarantee
+      solver->setCycleBudget(1e-12, 2);
+      EXPECT_TRUE(solve());
+
+      std::fill(solution.begin(), solution.end(), 7.0);
+      solver->setCycleBudget(1e-12, 0);
+      EXPECT_FALSE(solve());
+      EXPECT_EQ(0u, solver->getNumSolvedStages());
+
+      // The same when the guaranteed level has no stage in this cycle
+      solver->setGuaranteedPriorityLevel(0);
+      solver->clearStages();
+      solver->appendStage(1, -e, J, signs);
+      solver->finalizeStages();
+      EXPECT_FALSE(solver->solve(solution));
+    }
+  }
+
+  /// Records the cycle budget it is solved with, and takes a few milliseconds
+  class BudgetProbeSolver : public HiQPSolver {
+  public:
+    bool solve(std::vector<double>& solution) {
+      budgets_.push_back(cycle_budget_);
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      std::fill(solution.begin(), solution.end(), 0.0);
+      n_solved_stages_ = stages_map_.size();
+      return true;
+    }
+
+    static std::vector<double> budgets_;
+  };
+
+  std::vector<double> BudgetProbeSolver::budgets_;
+
+  TEST(GuaranteedStagesTest, DecoupledComponentsShareTheCycleBudget) {
+    DecoupledSolver solver([]() { return std::make_shared<BudgetProbeSolver>(); });
+    solver.init(4);
+    solver.setCycleBudget(1.0, 1);
+
+    // Joints 0 and 1 are independent of joints 2 and 3
+    Eigen::MatrixXd J = Eigen::MatrixXd::Identity(4, 4);
+    J(0, 1) = 1;
+    J(2, 3) = 1;
+    solver.appendStage(0, Eigen::VectorXd::Ones(4), J, std::vector<int>(4, 0));
+    solver.finalizeStages();
+
+    BudgetProbeSolver::budgets_.clear();
+    std::vector<double> solution(4);
+    EXPECT_TRUE(solver.solve(solution));
+    EXPECT_EQ(2u, solver.getNumComponents());
+    ASSERT_EQ(2u, BudgetProbeSolver::budgets_.size());
+
+    // Without a worker pool the second component only gets what the first left
+    EXPECT_LE(BudgetProbeSolver::budgets_[0], 1.0);
+    EXPECT_LE(BudgetProbeSolver::budgets_[1], BudgetProbeSolver::budgets_[0] - 0.005);
+    EXPECT_GT(BudgetProbeSolver::budgets_[1], 0.0);
+  }
+
+  TEST(ActiveSetQPTest, ExcludedInequalitiesHoldInTheSolution) {
+    // With the first inequality active, the second one is numerically
+    // dependent and gets excluded. Adding the third one then drops the first
+    // one and violates the second one again.
+    ActiveSetQP qp;
+    qp.resize(2, 0, 3);
+    qp.hessianDiagonal().setOnes();
+    qp.inNormals() << 1e9, -1.0, 1.0,
+                      0.0, 1e-7, 0.0;
+    qp.inOffsets() << -1e9, 0.999, -1.0001;
+    ASSERT_TRUE(qp.solve());
+
+    Eigen::VectorXd slacks = qp.inNormals().transpose() * qp.solution() + qp.inOffsets();
+    for (unsigned int i = 0; i < 3; ++i)
+      EXPECT_GT(slacks(i), -1e-6);
+    EXPECT_NEAR(1.0001, qp.solution()(0), 1e-9);
+    EXPECT_NEAR(11000.0, qp.solution()(1), 1e-3);
+  }
+
+#ifdef HIQP_GUROBI
+  TEST_F(SolversTest, GurobiAfterNullSpaceFastPath) {
+    GurobiSolver solver;
+    solver.init(n_);
+    solver.setNullSpaceFastPath(true);
+    for (int k = 0; k < 3; ++k) {
+      assembleStages(solver);
+      bool solved = false;
+      EXPECT_NO_THROW(solved = solver.solve(solution_));
+      EXPECT_TRUE(solved);
+      EXPECT_EQ(3u, solver.getNumSolvedStages());
+      EXPECT_LT(topResidual(), 1e-6);
+      EXPECT_LE(solution_[n_ - 1], 0.1 + 1e-6);
+      EXPECT_GE(solution_[n_ - 1], -0.1 - 1e-6);
+    }
+  }
+#endif
+
+} // namespace hiqp
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,200 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <hiqp/solvers/active_set_solver.h>
+#include <hiqp/solvers/reduced_space_solver.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Counts the heap allocations made while counting is enabled. Eigen allocates
+// through malloc and the standard containers through operator new, both end
+// up in the hooks below (glibc). The tests cover the stage assembly and the
+// solvers that build without optional dependencies, the task updates in
+// TaskManager and the Gurobi backend are not covered.
+namespace
+{
+  bool counting = false;
+  unsigned long n_allocations = 0;
+}
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void __libc_free(void* ptr);
+
+extern "C" void* malloc(size_t size) {
+  if (counting) ++n_allocations;
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size) {
+  if (counting) ++n_allocations;
+  return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+  if (counting) ++n_allocations;
+  return __libc_realloc(ptr, size);
+}
+
+// The replaced operator new and delete forms are paired with each other.
+// They release through __libc_free rather than free, which the compiler
+// would flag as a mismatch for memory from operator new.
+void* operator new(size_t size) {
+  if (counting) ++n_allocations;
+  void* ptr = __libc_malloc(size);
+  if (!ptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  __libc_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  operator delete(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  operator delete(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  operator delete(ptr);
+}
+
+namespace hiqp
+{
+
+  /// Exposes how many stages the null space fast path solves
+  class FastPathSolver : public ActiveSetSolver {
+  public:
+    using HiQPSolver::solveEqualityStages;
+  };
+
+  /// A fixed set of tasks as the TaskManager would append them each control cycle
+  class StageAllocationsTest : public ::testing::Test {
+  protected:
+    void SetUp() {
+      n_ = 14;
+      solution_.resize(n_);
+
+      J_task1_ = Eigen::MatrixXd::Random(3, n_);
+      e_task1_ = Eigen::VectorXd::Random(3);
+      J_task2_ = Eigen::MatrixXd::Random(3, n_);
+      e_task2_ = Eigen::VectorXd::Random(3);
+      signs_task_.assign(3, 0);
+
+      J_limits_ = Eigen::MatrixXd::Zero(4, n_);
+      J_limits_.col(0).setOnes();
+      e_limits_.resize(4);
+      e_limits_ << -1, 1, -0.5, 0.5;
+      signs_limits_ = {1, -1, 1, -1};
+
+      J_pose_ = -Eigen::MatrixXd::Identity(n_, n_);
+      e_pose_ = Eigen::VectorXd::Random(n_);
+      signs_pose_.assign(n_, 0);
+    }
+
+    /// With limits_last the limits are the lowest stage, so that the leading stages are equality-only
+    void assembleStages(HiQPSolver& solver, bool limits_last) {
+      const std::size_t limits_priority = (limits_last ? 3 : 0);
+      solver.clearStages();
+      solver.appendStage(limits_priority, e_limits_, J_limits_, signs_limits_);
+      solver.appendStage(1, e_task1_, J_task1_, signs_task_);
+      solver.appendStage(1, e_task2_, J_task2_, signs_task_);
+      solver.appendStage(2, e_pose_, J_pose_, signs_pose_);
+      solver.finalizeStages();
+    }
+
+    /// Runs warm-up cycles, then returns the allocations of the counted cycles
+    unsigned long countAllocations(HiQPSolver& solver, bool solve, bool limits_last = false) {
+      for (int k = 0; k < 3; ++k) {
+        assembleStages(solver, limits_last);
+        if (solve) solver.solve(solution_);
+      }
+
+      n_allocations = 0;
+      counting = true;
+      for (int k = 0; k < 10; ++k) {
+        assembleStages(solver, limits_last);
+        if (solve) solver.solve(solution_);
+      }
+      counting = false;
+      return n_allocations;
+    }
+
+    unsigned int            n_;
+    std::vector<double>     solution_;
+
+    Eigen::MatrixXd         J_task1_, J_task2_, J_limits_, J_pose_;
+    Eigen::VectorXd         e_task1_, e_task2_, e_limits_, e_pose_;
+    std::vector<int>        signs_task_, signs_limits_, signs_pose_;
+  };
+
+  TEST_F(StageAllocationsTest, StageAssemblyDoesNotAllocate) {
+    ActiveSetSolver solver;
+    solver.init(n_);
+    EXPECT_EQ(0u, countAllocations(solver, false));
+  }
+
+  TEST_F(StageAllocationsTest, ActiveSetSolveDoesNotAllocate) {
+    ActiveSetSolver solver;
+    solver.init(n_);
+    EXPECT_EQ(0u, countAllocations(solver, true));
+  }
+
+  TEST_F(StageAllocationsTest, ReducedSpaceSolveDoesNotAllocate) {
+    ReducedSpaceSolver solver;
+    solver.init(n_);
+    EXPECT_EQ(0u, countAllocations(solver, true));
+  }
+
+  TEST_F(StageAllocationsTest, NullSpaceFastPathDoesNotAllocate) {
+    FastPathSolver solver;
+    solver.init(n_);
+    solver.setNullSpaceFastPath(true);
+    EXPECT_EQ(0u, countAllocations(solver, true, true));
+
+    // The task and pose stages lead and were solved in closed form
+    EXPECT_EQ(2u, solver.solveEqualityStages(solution_));
+    EXPECT_EQ(3u, solver.getNumSolvedStages());
+  }
+
+  TEST_F(StageAllocationsTest, HooksCountAllocations) {
+    counting = true;
+    n_allocations = 0;
+    Eigen::VectorXd v = Eigen::VectorXd::Random(100);
+    std::vector<double> w(v.data(), v.data() + v.size());
+    counting = false;
+    EXPECT_EQ(v(99), w[99]);
+    EXPECT_GE(n_allocations, 2u);
+  }
+
+} // namespace hiqp
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
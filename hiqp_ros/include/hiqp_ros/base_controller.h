@@ -21,6 +21,10 @@
 #include <vector>
 #include <mutex>
 #include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
 
 #include <ros/ros.h>
 #include <ros/node_handle.h>
@@ -34,6 +38,7 @@
 
 #include <hiqp/robot_state.h>
 #include <hiqp_ros/utilities.h>
+#include <hiqp_ros/triple_buffer.h>
 
 namespace hiqp_ros {
 
@@ -41,26 +46,29 @@ namespace hiqp_ros {
   using hiqp::RobotState;
   using hiqp::RobotStatePtr;
 
-  /*! \brief A base controller class whose controller type and hardware interface type are set as template parameters. This controller includes an internal KDL tree that is got from the robot_description on the parameter server. Also all claimed joint resources are read from the yaml file. Only joints specified in the yaml file are claimed, the others are not claimed but still read from.
+  /*! \brief A base controller class whose controller type and hardware interface type are set as template parameters. This controller includes an internal KDL tree that is got from the robot_description on the parameter server. Also all claimed joint resources are read from the yaml file. Only joints specified in the yaml file are claimed, the others are not claimed but still read from. If the parameter 'pipelined' is set, the controls are computed in a separate solver thread from the most recent joint sample, and the realtime update only samples the joints and writes the most recent controls. Controls that are older than the parameter 'max_command_age' (in seconds) are replaced by zeros.
    *  \author Marcus A Johansson */
   template <typename HardwareInterfaceT>
   class BaseController : public controller_interface::Controller<HardwareInterfaceT> {
   public:
-    BaseController() = default;
-    ~BaseController() noexcept = default;
+    BaseController()
+    : pipelined_(false), max_command_age_(0.01), solver_running_(false) {}
+    ~BaseController() noexcept;
 
     bool init(HardwareInterfaceT* hw, 
       ros::NodeHandle &controller_nh);
 
-    void starting(const ros::Time& time) {}
+    /// \brief Starts the solver thread in pipelined mode
+    void starting(const ros::Time& time);
 
     void update(const ros::Time& time, const ros::Duration& period);
 
-    void stopping(const ros::Time& time) {}
+    /// \brief Stops and joins the solver thread in pipelined mode
+    void stopping(const ros::Time& time);
 
     virtual void initialize() = 0;
 
-    /*! \brief Implement this to set the output controls of this controller. Do not resize u! */
+    /*! \brief Implement this to set the output controls of this controller. Do not resize u! In pipelined mode this is called from the solver thread. */
     virtual void computeControls(Eigen::VectorXd& u) = 0;
 
   protected:
@@ -70,6 +78,11 @@ namespace hiqp_ros {
     inline RobotStatePtr getRobotState() { return robot_state_ptr_; }
     inline void setDesiredSamplingTime(double desired_sampling_time) { desired_sampling_time_ =  desired_sampling_time;}
 
+    /*! \brief Stops and joins the solver thread if it runs. Derived controllers
+     *         must call this first in their destructors, as the solver thread
+     *         calls computeControls() until it is joined. */
+    void stopSolverThread();
+
   private:
     BaseController(const BaseController& other) = delete;
     BaseController(BaseController&& other) = delete;
@@ -79,9 +92,34 @@ namespace hiqp_ros {
     //void loadDesiredSamplingTime();
     int loadUrdfToKdlTree();
     int loadJointsAndSetJointHandlesMap();
+    void loadPipelineParameters();
     void sampleJointValues();
     void setControls();
 
+    /// \brief Sets up the buffers between the realtime thread and the solver thread, and gives the solver its own robot state
+    void setupPipeline();
+
+    /// \brief Starts the solver thread if the controller is pipelined and the thread does not run
+    void startSolverThread();
+
+    /// \brief Computes controls from the latest joint sample until stopSolverThread() is called
+    void solverLoop();
+
+    /// \brief The part of the robot state that changes at every sample
+    struct JointStateSample {
+      ros::Time           stamp_;
+      HiQPTimePoint       sampling_time_point_;
+      double              sampling_time_;
+      KDL::JntArrayVel    kdl_jnt_array_vel_;
+      KDL::JntArray       kdl_effort_;
+    };
+
+    struct ControlCommand {
+      ros::Time           stamp_; // of the joint sample the controls were computed from
+      Eigen::VectorXd     u_;
+      bool                valid_;
+    };
+
     typedef std::map<unsigned int, hardware_interface::JointHandle> JointHandleMap;
 
     RobotState                            robot_state_data_;
@@ -98,6 +136,16 @@ namespace hiqp_ros {
     
     unsigned int                          n_joints_;
 
+    bool                                  pipelined_;
+    double                                max_command_age_; // seconds
+    RobotState                            solver_state_data_; // the robot state of the solver thread
+    TripleBuffer<JointStateSample>        samples_;
+    TripleBuffer<ControlCommand>          commands_;
+    std::thread                           solver_thread_;
+    std::atomic<bool>                     solver_running_;
+    std::mutex                            solver_mutex_;
+    std::condition_variable               solver_cv_; // notified without locking, the solver waits with a timeout
+
   };
 
   //////////////////////////////////////////////////////////////////////////////
@@ -106,12 +154,46 @@ namespace hiqp_ros {
   //
   //////////////////////////////////////////////////////////////////////////////
 
+  template <typename HardwareInterfaceT>
+  BaseController<HardwareInterfaceT>::~BaseController() noexcept {
+    stopSolverThread();
+  }
+
+  template <typename HardwareInterfaceT>
+  void BaseController<HardwareInterfaceT>::starting(const ros::Time& time) {
+    startSolverThread();
+  }
+
+  template <typename HardwareInterfaceT>
+  void BaseController<HardwareInterfaceT>::stopping(const ros::Time& time) {
+    stopSolverThread();
+  }
+
+  template <typename HardwareInterfaceT>
+  void BaseController<HardwareInterfaceT>::startSolverThread() {
+    if (!pipelined_ || solver_thread_.joinable())
+      return;
+    solver_running_ = true;
+    solver_thread_ = std::thread(&BaseController<HardwareInterfaceT>::solverLoop, this);
+  }
+
+  template <typename HardwareInterfaceT>
+  void BaseController<HardwareInterfaceT>::stopSolverThread() {
+    if (solver_thread_.joinable()) {
+      solver_running_ = false;
+      solver_cv_.notify_one();
+      solver_thread_.join();
+    }
+  }
+
   template <typename HardwareInterfaceT>
   bool BaseController<HardwareInterfaceT>::init(HardwareInterfaceT* hw, ros::NodeHandle &controller_nh) {
     hardware_interface_ = hw;
     controller_nh_ = controller_nh;
     controller_nh_ptr_.reset(&controller_nh_);
-    robot_state_ptr_.reset(&robot_state_data_);
+
+    loadPipelineParameters();
+    robot_state_ptr_.reset(pipelined_ ? &solver_state_data_ : &robot_state_data_);
 
     //loadDesiredSamplingTime();
     ros::Time t = ros::Time::now();
@@ -121,7 +203,13 @@ namespace hiqp_ros {
     loadJointsAndSetJointHandlesMap();
     sampleJointValues();
 
+    if (pipelined_)
+      setupPipeline();
+
     initialize();
+
+    // The solver thread is started in starting(), which the controller
+    // manager calls before the first update()
     return true;
   }
 
@@ -131,7 +219,27 @@ namespace hiqp_ros {
     //double elapsed_time = (now-last_sampling_time_point_).toSec();
     //if (elapsed_time*1000 >= desired_sampling_time_) {
       sampleJointValues();
-      computeControls(u_);
+
+      if (pipelined_) {
+        JointStateSample& sample = samples_.getWriteBuffer();
+        sample.sampling_time_point_ = robot_state_data_.sampling_time_point_;
+        sample.stamp_ = ros::Time(sample.sampling_time_point_.getSec(), sample.sampling_time_point_.getNSec());
+        sample.sampling_time_ = robot_state_data_.sampling_time_;
+        sample.kdl_jnt_array_vel_ = robot_state_data_.kdl_jnt_array_vel_;
+        sample.kdl_effort_ = robot_state_data_.kdl_effort_;
+        samples_.publish();
+        solver_cv_.notify_one();
+
+        commands_.fetch();
+        const ControlCommand& command = commands_.getReadBuffer();
+        if (command.valid_ && (sample.stamp_ - command.stamp_).toSec() <= max_command_age_)
+          u_ = command.u_;
+        else
+          u_.setZero();
+      } else {
+        computeControls(u_);
+      }
+
       setControls();
     //}
   }
@@ -153,6 +261,7 @@ namespace hiqp_ros {
     if (controller_nh_.searchParam("robot_description", full_parameter_path)) {
       controller_nh_.getParam(full_parameter_path, robot_urdf);
       ROS_ASSERT(kdl_parser::treeFromString(robot_urdf, robot_state_data_.kdl_tree_));
+      robot_state_data_.kinematics_cache_ = std::make_shared<hiqp::KinematicsCache>(robot_state_data_.kdl_tree_);
       ROS_INFO("Loaded the robot's urdf model and initialized the KDL tree successfully");
     } else {
       ROS_ERROR("Could not find parameter 'robot_description' on the parameter server.");
@@ -223,6 +332,64 @@ namespace hiqp_ros {
     return 0;
   }
 
+  template <typename HardwareInterfaceT>
+  void BaseController<HardwareInterfaceT>::loadPipelineParameters() {
+    if (!controller_nh_.getParam("pipelined", pipelined_)) {
+      pipelined_ = false;
+      ROS_INFO("Couldn't find parameter 'pipelined' on the parameter server, defaulting to false.");
+    }
+    if (pipelined_ && !controller_nh_.getParam("max_command_age", max_command_age_)) {
+      ROS_INFO_STREAM("Couldn't find parameter 'max_command_age' on the parameter server, defaulting to " 
+        << max_command_age_ << " s.");
+    }
+  }
+
+  template <typename HardwareInterfaceT>
+  void BaseController<HardwareInterfaceT>::setupPipeline() {
+    // The solver gets its own copy of the robot state including the
+    // kinematics cache, which is invalidated by the solver only
+    solver_state_data_ = robot_state_data_;
+    robot_state_data_.kinematics_cache_.reset();
+
+    JointStateSample sample;
+    sample.sampling_time_point_ = robot_state_data_.sampling_time_point_;
+    sample.stamp_ = ros::Time(sample.sampling_time_point_.getSec(), sample.sampling_time_point_.getNSec());
+    sample.sampling_time_ = robot_state_data_.sampling_time_;
+    sample.kdl_jnt_array_vel_ = robot_state_data_.kdl_jnt_array_vel_;
+    sample.kdl_effort_ = robot_state_data_.kdl_effort_;
+    samples_.initialize(sample);
+
+    ControlCommand command;
+    command.u_ = Eigen::VectorXd::Zero(n_joints_);
+    command.valid_ = false;
+    commands_.initialize(command);
+  }
+
+  template <typename HardwareInterfaceT>
+  void BaseController<HardwareInterfaceT>::solverLoop() {
+    while (solver_running_) {
+      if (!samples_.fetch()) {
+        std::unique_lock<std::mutex> lock(solver_mutex_);
+        solver_cv_.wait_for(lock, std::chrono::milliseconds(1));
+        continue;
+      }
+
+      const JointStateSample& sample = samples_.getReadBuffer();
+      solver_state_data_.sampling_time_point_ = sample.sampling_time_point_;
+      solver_state_data_.sampling_time_ = sample.sampling_time_;
+      solver_state_data_.kdl_jnt_array_vel_ = sample.kdl_jnt_array_vel_;
+      solver_state_data_.kdl_effort_ = sample.kdl_effort_;
+      if (solver_state_data_.kinematics_cache_)
+        solver_state_data_.kinematics_cache_->invalidate();
+
+      ControlCommand& command = commands_.getWriteBuffer();
+      computeControls(command.u_);
+      command.stamp_ = sample.stamp_;
+      command.valid_ = true;
+      commands_.publish();
+    }
+  }
+
   template <typename HardwareInterfaceT>
   void BaseController<HardwareInterfaceT>::sampleJointValues() {
     KDL::JntArray& q = robot_state_data_.kdl_jnt_array_vel_.q;
@@ -242,6 +409,9 @@ namespace hiqp_ros {
       robot_state_data_.sampling_time_point_.setTimePoint(t.sec, t.nsec);
       robot_state_data_.sampling_time_ = (robot_state_data_.sampling_time_point_ - last_sampling_time_point_).toSec();
       last_sampling_time_point_.setTimePoint(t.sec, t.nsec);
+
+      if (robot_state_data_.kinematics_cache_)
+        robot_state_data_.kinematics_cache_->invalidate();
     handles_mutex_.unlock();
   }
 
@@ -61,6 +61,7 @@ namespace hiqp_ros {
     void renderPrimitives();
 
     void loadRenderingParameters();
+    void loadSolverParameters();
     int loadAndSetupTaskMonitoring();
     // void addAllTopicSubscriptions();
     void loadJointLimitsFromParamServer();
@@ -29,6 +29,8 @@ using hiqp::geometric_primitives::GeometricBox;
 using hiqp::geometric_primitives::GeometricCylinder;
 using hiqp::geometric_primitives::GeometricSphere;
 using hiqp::geometric_primitives::GeometricFrame;
+using hiqp::geometric_primitives::GeometricCapsule;
+using hiqp::geometric_primitives::GeometricSDF;
 
 namespace hiqp_ros
 {
@@ -50,6 +52,8 @@ namespace hiqp_ros
     int add(std::shared_ptr<GeometricCylinder> cylinder);
     int add(std::shared_ptr<GeometricSphere> sphere);
     int add(std::shared_ptr<GeometricFrame> frame);
+    int add(std::shared_ptr<GeometricCapsule> capsule);
+    int add(std::shared_ptr<GeometricSDF> sdf);
 
     void update(int id, std::shared_ptr<GeometricPoint> point);
     void update(int id, std::shared_ptr<GeometricLine> line);
@@ -58,6 +62,8 @@ namespace hiqp_ros
     void update(int id, std::shared_ptr<GeometricCylinder> cylinder);
     void update(int id, std::shared_ptr<GeometricSphere> sphere);
     void update(int id, std::shared_ptr<GeometricFrame> frame);
+    void update(int id, std::shared_ptr<GeometricCapsule> capsule);
+    void update(int id, std::shared_ptr<GeometricSDF> sdf);
 
     void remove(int id);
 
@@ -76,6 +82,8 @@ namespace hiqp_ros
     int apply(int id, std::shared_ptr<GeometricCylinder> cylinder, int action);
     int apply(int id, std::shared_ptr<GeometricSphere> sphere, int action);
     int apply(int id, std::shared_ptr<GeometricFrame> frame, int action);
+    int apply(int id, std::shared_ptr<GeometricCapsule> capsule, int action);
+    int apply(int id, std::shared_ptr<GeometricSDF> sdf, int action);
 
     enum {ACTION_ADD = 0, ACTION_MODIFY = 1};
 
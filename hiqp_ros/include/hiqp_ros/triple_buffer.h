@@ -0,0 +1,76 @@
+// The HiQP Control Framework, an optimal control framework targeted at robotics
+// Copyright (C) 2016 Marcus A Johansson
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef HIQP_ROS_TRIPLE_BUFFER_H
+#define HIQP_ROS_TRIPLE_BUFFER_H
+
+#include <atomic>
+
+namespace hiqp_ros {
+
+  /*! \brief A lock-free single-slot mailbox between one writer thread and one reader thread. The writer fills the write buffer and publishes it, the reader fetches the most recently published buffer. Neither of them ever waits for the other, and a buffer is never written while it is being read. Unread values are overwritten by newer ones.
+   *  \author Marcus A Johansson */
+  template <typename T>
+  class TripleBuffer {
+  public:
+    TripleBuffer() : write_index_(0), mailbox_(1), read_index_(2) {}
+    ~TripleBuffer() noexcept = default;
+
+    /// \brief Sets all three buffers, must be called before the threads start
+    void initialize(const T& value) {
+      for (int i = 0; i < 3; ++i)
+        buffers_[i] = value;
+    }
+
+    /// \brief The buffer the writer fills before calling publish()
+    inline T& getWriteBuffer() { return buffers_[write_index_]; }
+
+    /// \brief Hands the write buffer over to the reader, the writer continues in another buffer
+    inline void publish() {
+      write_index_ = mailbox_.exchange(write_index_ | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    /*! \brief Makes the most recently published buffer the read buffer
+     *  \return true if a buffer was published since the last call, false if the read buffer is unchanged */
+    inline bool fetch() {
+      if ((mailbox_.load(std::memory_order_relaxed) & FRESH_BIT) == 0)
+        return false;
+      read_index_ = mailbox_.exchange(read_index_, std::memory_order_acq_rel) & INDEX_MASK;
+      return true;
+    }
+
+    /// \brief The buffer the reader got from the last successful fetch()
+    inline T& getReadBuffer() { return buffers_[read_index_]; }
+
+  private:
+    TripleBuffer(const TripleBuffer& other) = delete;
+    TripleBuffer(TripleBuffer&& other) = delete;
+    TripleBuffer& operator=(const TripleBuffer& other) = delete;
+    TripleBuffer& operator=(TripleBuffer&& other) noexcept = delete;
+
+    static const int INDEX_MASK = 3;
+    static const int FRESH_BIT = 4;
+
+    T                 buffers_[3];
+    int               write_index_; // owned by the writer
+    std::atomic<int>  mailbox_; // index of the published buffer and the fresh bit
+    int               read_index_; // owned by the reader
+  };
+
+} // namespace hiqp_ros
+
+#endif // include guard
@@ -52,7 +52,10 @@ HiQPJointEffortController::HiQPJointEffortController()
   task_manager_(visualizer_),
   task_manager_ptr_(&task_manager_) {}
 
-HiQPJointEffortController::~HiQPJointEffortController() noexcept {}
+HiQPJointEffortController::~HiQPJointEffortController() noexcept {
+  // The solver thread calls computeControls(), which uses the members of this class
+  stopSolverThread();
+}
 
 void HiQPJointEffortController::initialize() {
   ros_visualizer_.init( &(this->getControllerNodeHandle()) );
@@ -66,7 +69,11 @@ void HiQPJointEffortController::initialize() {
 
   service_handler_.advertiseAll();
 
-  task_manager_.init(getNJoints());
+  std::string solver;
+  if (!this->getControllerNodeHandle().getParam("solver", solver)) {
+    ROS_INFO("Couldn't find parameter 'solver' on parameter server, using the default solver backend.");
+  }
+  task_manager_.init(getNJoints(), solver);
 
   loadJointLimitsFromParamServer();
 
@@ -131,6 +138,13 @@ void HiQPJointEffortController::monitorTasks() {
         msgs.task_measures.push_back(msg);
       }
       monitoring_pub_.publish(msgs);
+
+      std::shared_ptr<hiqp::KinematicsCache> cache = this->getRobotState()->kinematics_cache_;
+      if (cache) {
+        ROS_DEBUG_STREAM("Kinematics cache hit rate: " << cache->getHitRate()
+          << " (" << cache->getNumHits() << " hits, " << cache->getNumMisses() << " misses)");
+        cache->resetCounters();
+      }
     }
   }
 }
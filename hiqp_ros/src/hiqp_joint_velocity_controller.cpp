@@ -52,7 +52,10 @@ HiQPJointVelocityController::HiQPJointVelocityController()
   task_manager_(visualizer_),
   task_manager_ptr_(&task_manager_) {}
 
-HiQPJointVelocityController::~HiQPJointVelocityController() noexcept {}
+HiQPJointVelocityController::~HiQPJointVelocityController() noexcept {
+  // The solver thread calls computeControls(), which uses the members of this class
+  stopSolverThread();
+}
 
 void HiQPJointVelocityController::initialize() {
   ros_visualizer_.init( &(this->getControllerNodeHandle()) );
@@ -66,7 +69,7 @@ void HiQPJointVelocityController::initialize() {
 
   service_handler_.advertiseAll();
 
-  task_manager_.init(getNJoints());
+  loadSolverParameters();
 
   loadJointLimitsFromParamServer();
 
@@ -79,7 +82,18 @@ void HiQPJointVelocityController::computeControls(Eigen::VectorXd& u) {
   if (!is_active_) return;
 
   std::vector<double> outcon(u.size());
-  task_manager_.getVelocityControls(this->getRobotState(), outcon);
+  if (task_manager_.getVelocityControls(this->getRobotState(), outcon)) {
+    unsigned int n_stages = 0;
+    unsigned int n_solved_stages = task_manager_.getNumSolvedStages(n_stages);
+    if (n_solved_stages < n_stages)
+      ROS_WARN_THROTTLE(1.0, "Only the %u highest of %u priority levels were solved this cycle.", n_solved_stages, n_stages);
+    if (task_manager_.hasShadowSolver()) {
+      const hiqp::TaskManager::SolverComparison& comparison = task_manager_.getSolverComparison();
+      ROS_INFO_THROTTLE(1.0, "Solver: %.3f ms, shadow solver: %.3f ms%s, largest control difference: %g",
+        1e3 * comparison.solve_time_, 1e3 * comparison.shadow_solve_time_,
+        (comparison.shadow_solved_ ? "" : " (failed)"), comparison.max_deviation_);
+    }
+  }
   int i=0;
   for (auto&& oc : outcon) {
     u(i++) = oc;
@@ -131,6 +145,13 @@ void HiQPJointVelocityController::monitorTasks() {
         msgs.task_measures.push_back(msg);
       }
       monitoring_pub_.publish(msgs);
+
+      std::shared_ptr<hiqp::KinematicsCache> cache = this->getRobotState()->kinematics_cache_;
+      if (cache) {
+        ROS_DEBUG_STREAM("Kinematics cache hit rate: " << cache->getHitRate()
+          << " (" << cache->getNumHits() << " hits, " << cache->getNumMisses() << " misses)");
+        cache->resetCounters();
+      }
     }
   }
 }
@@ -159,6 +180,58 @@ void HiQPJointVelocityController::loadRenderingParameters() {
   last_rendering_update_ = ros::Time::now();
 }
 
+void HiQPJointVelocityController::loadSolverParameters() {
+  std::string solver;
+  if (!this->getControllerNodeHandle().getParam("solver", solver)) {
+    ROS_INFO("Couldn't find parameter 'solver' on parameter server, using the default solver backend.");
+  }
+  task_manager_.init(getNJoints(), solver);
+
+  std::string shadow_solver;
+  if (this->getControllerNodeHandle().getParam("shadow_solver", shadow_solver))
+    task_manager_.setShadowSolver(shadow_solver);
+
+  bool null_space_fast_path = false;
+  if (!this->getControllerNodeHandle().getParam("null_space_fast_path", null_space_fast_path)) {
+    ROS_INFO("Couldn't find parameter 'null_space_fast_path' on parameter server, defaulting to false.");
+  }
+  task_manager_.setNullSpaceFastPath(null_space_fast_path);
+
+  bool sparse_stages = false;
+  if (!this->getControllerNodeHandle().getParam("sparse_stages", sparse_stages)) {
+    ROS_INFO("Couldn't find parameter 'sparse_stages' on parameter server, defaulting to false.");
+  }
+  task_manager_.setSparseStages(sparse_stages);
+
+  bool row_compression = false;
+  if (!this->getControllerNodeHandle().getParam("row_compression", row_compression)) {
+    ROS_INFO("Couldn't find parameter 'row_compression' on parameter server, defaulting to false.");
+  }
+  task_manager_.setRowCompression(row_compression);
+
+  int worker_threads = 0;
+  if (!this->getControllerNodeHandle().getParam("worker_threads", worker_threads)) {
+    ROS_INFO("Couldn't find parameter 'worker_threads' on parameter server, defaulting to 0 (serial task updates).");
+  }
+  bool pin_worker_threads = false;
+  this->getControllerNodeHandle().getParam("pin_worker_threads", pin_worker_threads);
+  task_manager_.setNumWorkerThreads(worker_threads > 0 ? worker_threads : 0, pin_worker_threads);
+
+  double cycle_budget = 0;
+  if (!this->getControllerNodeHandle().getParam("cycle_budget", cycle_budget)) {
+    ROS_INFO("Couldn't find parameter 'cycle_budget' on parameter server, solving all priority levels every cycle.");
+  }
+  int guaranteed_stages = 1;
+  this->getControllerNodeHandle().getParam("guaranteed_stages", guaranteed_stages);
+  task_manager_.setCycleBudget(cycle_budget, guaranteed_stages > 0 ? guaranteed_stages : 0);
+
+  double activation_margin = -1;
+  if (!this->getControllerNodeHandle().getParam("activation_margin", activation_margin)) {
+    ROS_INFO("Couldn't find parameter 'activation_margin' on parameter server, evaluating all active tasks every cycle.");
+  }
+  task_manager_.setActivationMargin(activation_margin);
+}
+
   /// \todo Task monitoring should publish an array of all task infos at each publication time step, rather than indeterministacally publishing single infos on the same topic
 int HiQPJointVelocityController::loadAndSetupTaskMonitoring() {
   XmlRpc::XmlRpcValue task_monitoring;
@@ -234,6 +307,10 @@ void HiQPJointVelocityController::loadJointLimitsFromParamServer()
 }
 
 void HiQPJointVelocityController::loadGeometricPrimitivesFromParamServer() {
+  std::string sdf_directory;
+  if (this->getControllerNodeHandle().getParam("sdf_directory", sdf_directory))
+    hiqp::geometric_primitives::SDFGrid::setDirectory(sdf_directory);
+
   XmlRpc::XmlRpcValue hiqp_preload_geometric_primitives;
   if (!this->getControllerNodeHandle().getParam("hiqp_preload_geometric_primitives", hiqp_preload_geometric_primitives)) {
     ROS_WARN_STREAM("No hiqp_preload_geometric_primitives parameter "
@@ -55,7 +55,7 @@ void ROSTopicSubscriber::topicCallback<geometry_msgs::PoseStamped>(const geometr
 	wintracker_frame_params.push_back(msg.pose.orientation.y);
 	wintracker_frame_params.push_back(msg.pose.orientation.z);
 	task_manager_->getGeometricPrimitiveMap()
-	             ->updateGeometricPrimitive<GeometricFrame>("teleop_wintracker_frame", wintracker_frame_params);
+	             ->publishGeometricPrimitive<GeometricFrame>("teleop_wintracker_frame", wintracker_frame_params);
 
 
 
@@ -139,7 +139,8 @@ void ROSTopicSubscriber::topicCallback<hiqp_msgs::StringArray>
 			cyl->getDirectionX(), cyl->getDirectionY(), cyl->getDirectionZ(), 
 			x, y, z, cyl->getRadius(), cyl->getHeight()
 		};
-		cyl->init(cyl_params);
+		task_manager_->getGeometricPrimitiveMap()->publishGeometricPrimitive
+			<GeometricCylinder>("experiment_cylinder", cyl_params);
 
 
 
@@ -151,10 +152,9 @@ void ROSTopicSubscriber::topicCallback<hiqp_msgs::StringArray>
 		double y = std::stod( msg.params.at(2) );
 		double z = std::stod( msg.params.at(3) );
 
-		std::shared_ptr<GeometricPoint> point = task_manager_->getGeometricPrimitiveMap()->getGeometricPrimitive
-			<GeometricPoint>("experiment_starting_point");
 		std::vector<double> point_params = {x, y, z};
-		point->init(point_params);
+		task_manager_->getGeometricPrimitiveMap()->publishGeometricPrimitive
+			<GeometricPoint>("experiment_starting_point", point_params);
 
 		task_manager_->deactivateTask("bring_back_to_start");
 		task_manager_->deactivateTask("bring_gripper_point_to_cylinder");
@@ -434,6 +434,112 @@ namespace hiqp_ros
   }
 }
 
+int ROSVisualizer::apply(int id, std::shared_ptr<GeometricCapsule> capsule, int action) {
+  visualization_msgs::MarkerArray marker_array;
+
+  double height = capsule->getHeight();
+  Eigen::Vector3d v = capsule->getDirectionEigen();
+  Eigen::Vector3d p = capsule->getOffsetEigen();
+
+  // Quaternion that aligns the z-axis with the line segment
+  Eigen::Quaterniond q;
+  q.setFromTwoVectors(Eigen::Vector3d::UnitZ(), v);
+
+  // The cylindrical middle part followed by the spheres at the two ends
+  for (int i = 0; i < 3; ++i) {
+    visualization_msgs::Marker marker;
+    marker.header.frame_id = "/" + capsule->getFrameId();
+    marker.header.stamp = ros::Time::now();
+    marker.ns = kNamespace;
+    if (action == ACTION_ADD)  marker.id = next_id_+i;
+    else                       marker.id = id+i;
+    marker.action = visualization_msgs::Marker::ADD; 
+
+    Eigen::Vector3d c = p + v*height*(i == 0 ? 0.5 : i-1);
+    marker.pose.position.x = c(0);
+    marker.pose.position.y = c(1);
+    marker.pose.position.z = c(2);
+    marker.pose.orientation.x = q.x();
+    marker.pose.orientation.y = q.y();
+    marker.pose.orientation.z = q.z();
+    marker.pose.orientation.w = q.w();
+
+    marker.type = (i == 0 ? visualization_msgs::Marker::CYLINDER : visualization_msgs::Marker::SPHERE);
+    marker.scale.x = 2*capsule->getRadius();
+    marker.scale.y = 2*capsule->getRadius();
+    marker.scale.z = (i == 0 ? height : 2*capsule->getRadius());
+
+    marker.color.r = capsule->getRedComponent();
+    marker.color.g = capsule->getGreenComponent();
+    marker.color.b = capsule->getBlueComponent();
+    marker.color.a = capsule->getAlphaComponent();
+    marker.lifetime = ros::Duration(marker_lifetime);
+    marker_array.markers.push_back(marker);
+  }
+
+  marker_array_pub_.publish(marker_array);
+
+  if (action == ACTION_ADD) {
+    next_id_ += 3;
+    return next_id_-3;
+  } else {
+    return id;
+  }
+}
+
+int ROSVisualizer::apply(int id, std::shared_ptr<GeometricSDF> sdf, int action) {
+  visualization_msgs::Marker marker;
+
+  marker.header.frame_id = "/" + sdf->getFrameId();
+  marker.header.stamp = ros::Time::now();
+  marker.ns = kNamespace;
+  if (action == ACTION_ADD)  marker.id = next_id_;
+  else                       marker.id = id;
+  marker.type = visualization_msgs::Marker::CUBE_LIST;
+  marker.action = visualization_msgs::Marker::ADD; 
+
+  marker.pose.position.x = sdf->getX();
+  marker.pose.position.y = sdf->getY();
+  marker.pose.position.z = sdf->getZ();
+
+  marker.pose.orientation.x = 0.0;
+  marker.pose.orientation.y = 0.0;
+  marker.pose.orientation.z = 0.0;
+  marker.pose.orientation.w = 1.0;
+
+  // One cube per grid sample on the surface of the obstacles
+  double voxel_size = sdf->getGrid().getVoxelSize();
+  marker.scale.x = voxel_size;
+  marker.scale.y = voxel_size;
+  marker.scale.z = voxel_size;
+
+  const std::vector<Eigen::Vector3d>& samples = sdf->getGrid().getSurfaceSamples();
+  marker.points.resize(samples.size());
+  for (unsigned int i = 0; i < samples.size(); ++i) {
+    marker.points[i].x = samples[i](0);
+    marker.points[i].y = samples[i](1);
+    marker.points[i].z = samples[i](2);
+  }
+
+  marker.color.r = sdf->getRedComponent();
+  marker.color.g = sdf->getGreenComponent();
+  marker.color.b = sdf->getBlueComponent();
+  marker.color.a = sdf->getAlphaComponent();
+
+  marker.lifetime = ros::Duration(marker_lifetime);
+
+  visualization_msgs::MarkerArray marker_array;
+  marker_array.markers.push_back(marker);
+  marker_array_pub_.publish(marker_array);
+
+  if (action == ACTION_ADD) {
+    next_id_++;
+    return next_id_-1;
+  } else {
+    return id;
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
 //                                 A D D                                      //
@@ -468,6 +574,14 @@ int ROSVisualizer::add(std::shared_ptr<GeometricFrame> frame) {
   return apply(0, frame, ACTION_ADD);
 }
 
+int ROSVisualizer::add(std::shared_ptr<GeometricCapsule> capsule) {
+  return apply(0, capsule, ACTION_ADD);
+}
+
+int ROSVisualizer::add(std::shared_ptr<GeometricSDF> sdf) {
+  return apply(0, sdf, ACTION_ADD);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
 //                              U P D A T E                                   //
@@ -502,6 +616,14 @@ void ROSVisualizer::update(int id, std::shared_ptr<GeometricFrame> frame) {
   apply(id, frame, ACTION_MODIFY);
 }
 
+void ROSVisualizer::update(int id, std::shared_ptr<GeometricCapsule> capsule) {
+  apply(id, capsule, ACTION_MODIFY);
+}
+
+void ROSVisualizer::update(int id, std::shared_ptr<GeometricSDF> sdf) {
+  apply(id, sdf, ACTION_MODIFY);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
 //                              R E M O V E                                   //